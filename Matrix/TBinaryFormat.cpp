@@ -0,0 +1,102 @@
+#include "TBinaryFormat.h"
+
+#ifdef _WIN32
+// wingdi.h defines its own ERROR.
+#define NOGDI
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+TMappedFile::TMappedFile(const std::string& filename, bool copyOnWrite)
+    : address(nullptr), size(0), writable(copyOnWrite), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+{
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        ERROR("cannot_open_file");
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize))
+    {
+        CloseHandle(fileHandle);
+        ERROR("cannot_open_file");
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+    if (size == 0)
+        return;
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle != nullptr)
+        address = MapViewOfFile(mappingHandle, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, size);
+    if (address == nullptr)
+    {
+        if (mappingHandle != nullptr)
+            CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        ERROR("mapping_error");
+    }
+}
+
+TMappedFile::~TMappedFile()
+{
+    if (address != nullptr)
+        UnmapViewOfFile(address);
+    if (mappingHandle != nullptr)
+        CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+}
+
+#else
+
+TMappedFile::TMappedFile(const std::string& filename, bool copyOnWrite) : address(nullptr), size(0), writable(copyOnWrite)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        ERROR("cannot_open_file");
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        ERROR("cannot_open_file");
+    }
+    size = static_cast<size_t>(info.st_size);
+    if (size == 0)
+    {
+        close(fd);
+        return;
+    }
+    void* mapped = mmap(nullptr, size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (mapped == MAP_FAILED)
+        ERROR("mapping_error");
+    address = mapped;
+}
+
+TMappedFile::~TMappedFile()
+{
+    if (address != nullptr)
+        munmap(address, size);
+}
+
+#endif
+
+void* TMappedFile::Data() const
+{
+    return address;
+}
+
+size_t TMappedFile::Size() const
+{
+    return size;
+}
+
+bool TMappedFile::IsWritable() const
+{
+    return writable;
+}
@@ -0,0 +1,393 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "TError.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+// Building blocks of the on-disk container formats. Every file starts with a fixed-size header that
+// carries a magic string, a format version and a byte-order tag written as binaryByteOrder by the
+// saving machine. Formats meant to be mapped start their sections at offsets aligned to
+// binaryAlignment so that the file can be used in place.
+const uint32_t binaryByteOrder = 0x01020304u;
+const uint64_t binaryAlignment = 64;
+
+inline uint64_t AlignUp(uint64_t offset, uint64_t alignment = binaryAlignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+// 64-bit FNV-1a variant that consumes eight bytes per step. The result does not depend on how the
+// input is split between Update calls.
+class TChecksum {
+protected:
+    static const uint64_t prime = 1099511628211ull;
+
+    uint64_t hash;
+    unsigned char tail[8];
+    size_t tailSize;
+
+    void Mix(uint64_t word);
+public:
+    TChecksum();
+
+    void Update(const void* bytes, size_t size);
+    uint64_t Finish() const;
+};
+
+inline void TChecksum::Mix(uint64_t word)
+{
+    hash = (hash ^ word) * prime;
+    hash ^= hash >> 29;
+}
+
+inline TChecksum::TChecksum() : hash(14695981039346656037ull), tailSize(0)
+{
+}
+
+inline void TChecksum::Update(const void* bytes, size_t size)
+{
+    if (size == 0)
+        return;
+    const unsigned char* p = static_cast<const unsigned char*>(bytes);
+    if (tailSize > 0)
+    {
+        size_t take = size < 8 - tailSize ? size : 8 - tailSize;
+        memcpy(tail + tailSize, p, take);
+        tailSize += take;
+        p += take;
+        size -= take;
+        if (tailSize < 8)
+            return;
+        uint64_t word;
+        memcpy(&word, tail, 8);
+        Mix(word);
+        tailSize = 0;
+    }
+    for (; size >= 8; p += 8, size -= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        Mix(word);
+    }
+    memcpy(tail, p, size);
+    tailSize = size;
+}
+
+inline uint64_t TChecksum::Finish() const
+{
+    uint64_t result = hash;
+    for (size_t i = 0; i < tailSize; ++i)
+        result = (result ^ tail[i]) * prime;
+    return result ^ tailSize;
+}
+
+inline uint64_t Checksum(const void* bytes, size_t size)
+{
+    TChecksum sum;
+    sum.Update(bytes, size);
+    return sum.Finish();
+}
+
+// Gathers small writes into one large buffer so the stream sees few big write calls; writes at least
+// as large as the buffer go straight through. Everything written is also fed to the tracked checksum.
+class TBinaryWriter {
+protected:
+    std::ostream& os;
+    std::unique_ptr<char[]> buffer;
+    size_t bufferSize;
+    size_t used;
+    TChecksum* sum;
+public:
+    TBinaryWriter(std::ostream& os_, size_t bufferSize_ = 1 << 20);
+    TBinaryWriter(const TBinaryWriter& other) = delete;
+    ~TBinaryWriter();
+
+    TBinaryWriter& operator=(const TBinaryWriter& other) = delete;
+
+    void Track(TChecksum* sum_);
+    void Write(const void* bytes, size_t size);
+    void WriteZeros(uint64_t size);
+    void Flush();
+};
+
+inline TBinaryWriter::TBinaryWriter(std::ostream& os_, size_t bufferSize_)
+    : os(os_), buffer(new char[bufferSize_]), bufferSize(bufferSize_), used(0), sum(nullptr)
+{
+}
+
+inline TBinaryWriter::~TBinaryWriter()
+{
+    Flush();
+}
+
+inline void TBinaryWriter::Track(TChecksum* sum_)
+{
+    sum = sum_;
+}
+
+inline void TBinaryWriter::Write(const void* bytes, size_t size)
+{
+    if (sum != nullptr)
+        sum->Update(bytes, size);
+    if (used + size > bufferSize)
+        Flush();
+    if (size >= bufferSize)
+        os.write(static_cast<const char*>(bytes), size);
+    else if (size > 0)
+    {
+        memcpy(buffer.get() + used, bytes, size);
+        used += size;
+    }
+}
+
+inline void TBinaryWriter::WriteZeros(uint64_t size)
+{
+    while (size > 0)
+    {
+        if (used == bufferSize)
+            Flush();
+        size_t chunk = size < bufferSize - used ? static_cast<size_t>(size) : bufferSize - used;
+        memset(buffer.get() + used, 0, chunk);
+        if (sum != nullptr)
+            sum->Update(buffer.get() + used, chunk);
+        used += chunk;
+        size -= chunk;
+    }
+}
+
+inline void TBinaryWriter::Flush()
+{
+    if (used > 0)
+        os.write(buffer.get(), used);
+    used = 0;
+}
+
+// Maps a whole file into memory. A read-only mapping shares the page cache; a copy-on-write one
+// may be written to, and the touched pages become private copies that never reach the file.
+class TMappedFile {
+protected:
+    void* address;
+    size_t size;
+    bool writable;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+public:
+    TMappedFile(const std::string& filename, bool copyOnWrite = false);
+    TMappedFile(const TMappedFile& other) = delete;
+    ~TMappedFile();
+
+    TMappedFile& operator=(const TMappedFile& other) = delete;
+
+    void* Data() const;
+    size_t Size() const;
+    bool IsWritable() const;
+};
+
+// Reads through a stream that must hold at least the requested bytes; a short file is a format_error
+// rather than a partial read. Everything read is also fed to the tracked checksum.
+class TBinaryReader {
+protected:
+    std::istream& is;
+    uint64_t remaining;
+    TChecksum* sum;
+public:
+    TBinaryReader(std::istream& is_);
+
+    void Track(TChecksum* sum_);
+    uint64_t Remaining() const;
+    void Read(void* bytes, size_t size);
+};
+
+inline TBinaryReader::TBinaryReader(std::istream& is_) : is(is_), sum(nullptr)
+{
+    std::streampos position = is.tellg();
+    is.seekg(0, std::ios::end);
+    remaining = static_cast<uint64_t>(is.tellg() - position);
+    is.seekg(position);
+}
+
+inline void TBinaryReader::Track(TChecksum* sum_)
+{
+    sum = sum_;
+}
+
+inline uint64_t TBinaryReader::Remaining() const
+{
+    return remaining;
+}
+
+inline void TBinaryReader::Read(void* bytes, size_t size)
+{
+    if (size > remaining || !is.read(static_cast<char*>(bytes), size))
+        ERROR("format_error");
+    remaining -= size;
+    if (sum != nullptr)
+        sum->Update(bytes, size);
+}
+
+// How containers store elements in binary files: trivially copyable types as raw bytes, TString as a
+// uint64_t length followed by the characters. Other types have no binary form. Read constructs the
+// elements in raw memory and counts them in constructed as it goes.
+template<class T, class = void>
+struct TBinaryCodec
+{
+    static const bool supported = false;
+};
+
+template<class T>
+struct TBinaryCodec<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+{
+    static const bool supported = true;
+    static const uint32_t encoding = 0;
+    static const uint32_t elemSize = sizeof(T);
+
+    static void Write(TBinaryWriter& writer, const T* elems, size_t n)
+    {
+        writer.Write(elems, n * sizeof(T));
+    }
+
+    static void Read(TBinaryReader& reader, T* raw, size_t n, size_t& constructed)
+    {
+        reader.Read(raw, n * sizeof(T));
+        constructed += n;
+    }
+};
+
+template<>
+struct TBinaryCodec<TString>
+{
+    static const bool supported = true;
+    static const uint32_t encoding = 1;
+    static const uint32_t elemSize = 0;
+
+    static void Write(TBinaryWriter& writer, const TString* elems, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint64_t length = static_cast<uint64_t>(elems[i].Length());
+            writer.Write(&length, sizeof(length));
+            writer.Write(elems[i].Data(), static_cast<size_t>(length));
+        }
+    }
+
+    static void Read(TBinaryReader& reader, TString* raw, size_t n, size_t& constructed)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint64_t length = 0;
+            reader.Read(&length, sizeof(length));
+            if (length > reader.Remaining() || length > static_cast<uint64_t>(INT_MAX))
+                ERROR("format_error");
+            TString elem(static_cast<int>(length), '\0');
+            reader.Read(elem.Data(), static_cast<size_t>(length));
+            new (raw + i) TString(std::move(elem));
+            constructed++;
+        }
+    }
+};
+
+// Header of the binary files written by TStack and TQueue; the elements follow it in container order,
+// encoded by TBinaryCodec, and dataChecksum covers them. headerChecksum covers the fields before it.
+struct TSequenceHeader
+{
+    static const uint32_t currentVersion = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t elemSize;
+    uint32_t encoding;
+    uint64_t count;
+    uint64_t capacity;
+    uint64_t dataChecksum;
+    uint64_t headerChecksum;
+
+    uint64_t OwnChecksum() const;
+};
+
+inline uint64_t TSequenceHeader::OwnChecksum() const
+{
+    return Checksum(this, offsetof(TSequenceHeader, headerChecksum));
+}
+
+// Containers with at least this many elements are written in binary by default when T has a binary form.
+const size_t binaryFileThreshold = 1024;
+
+// Most bytes a sequence file may ask a reader to reserve beyond the elements it holds, so that a
+// damaged capacity cannot request an arbitrarily large allocation.
+const uint64_t binaryMaxReserve = 64ull << 20;
+
+// True when the stream starts with magic; the stream is rewound either way.
+inline bool HasMagic(std::istream& is, const char* magic)
+{
+    char head[8] = {};
+    is.read(head, sizeof(head));
+    bool found = is.gcount() == sizeof(head) && strncmp(head, magic, sizeof(head)) == 0;
+    is.clear();
+    is.seekg(0);
+    return found;
+}
+
+// Writes a sequence file holding first[0, firstCount) followed by second[0, secondCount), so a ring
+// buffer can be written without straightening it first.
+template<class T>
+inline void WriteSequence(std::ostream& os, const char* magic, const T* first, size_t firstCount, const T* second, size_t secondCount, size_t capacity)
+{
+    TSequenceHeader header = {};
+    size_t length = strlen(magic);
+    memcpy(header.magic, magic, length < sizeof(header.magic) ? length : sizeof(header.magic));
+    header.version = TSequenceHeader::currentVersion;
+    header.byteOrder = binaryByteOrder;
+    header.elemSize = TBinaryCodec<T>::elemSize;
+    header.encoding = TBinaryCodec<T>::encoding;
+    header.count = firstCount + secondCount;
+    header.capacity = capacity;
+    TChecksum sum;
+    {
+        TBinaryWriter writer(os);
+        writer.Write(&header, sizeof(header));
+        writer.Track(&sum);
+        TBinaryCodec<T>::Write(writer, first, firstCount);
+        TBinaryCodec<T>::Write(writer, second, secondCount);
+    }
+    header.dataChecksum = sum.Finish();
+    header.headerChecksum = header.OwnChecksum();
+    os.seekp(0);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!os)
+        ERROR("file_open_error");
+}
+
+// Reads and checks a sequence header for elements of type T, leaving reader at the first element.
+template<class T>
+inline TSequenceHeader ReadSequenceHeader(TBinaryReader& reader, const char* magic)
+{
+    TSequenceHeader header;
+    reader.Read(&header, sizeof(header));
+    if (strncmp(header.magic, magic, sizeof(header.magic)) != 0 || header.version != TSequenceHeader::currentVersion || header.byteOrder != binaryByteOrder)
+        ERROR("format_error");
+    if (header.headerChecksum != header.OwnChecksum())
+        ERROR("checksum_error");
+    if (header.elemSize != TBinaryCodec<T>::elemSize || header.encoding != TBinaryCodec<T>::encoding || header.count > header.capacity)
+        ERROR("format_error");
+    if (header.capacity > SIZE_MAX / sizeof(T) || (header.elemSize > 0 && header.count * header.elemSize != reader.Remaining()))
+        ERROR("format_error");
+    if (header.capacity - header.count > binaryMaxReserve / sizeof(T))
+        ERROR("format_error");
+    if (header.elemSize == 0 && header.count > reader.Remaining() / sizeof(uint64_t))
+        ERROR("format_error");
+    return header;
+}
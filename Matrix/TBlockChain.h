@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+
+// Storage for the segmented containers: fixed-size blocks of B raw slots linked both ways.
+// Blocks that are no longer in use go to a free list, so a container that stays
+// around a steady depth stops allocating.
+template<class T, size_t B, class Alloc>
+class TBlockChain {
+    static_assert(B > 0, "TBlockChain needs at least one slot per block");
+public:
+    struct TBlock {
+        TBlock* next;
+        TBlock* prev;
+        alignas(T) unsigned char data[B * sizeof(T)];
+
+        T* Items() { return reinterpret_cast<T*>(data); }
+    };
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<TBlock> TBlockAlloc;
+protected:
+    TBlockAlloc allocator;
+    TBlock* freeList;
+    size_t freeCount;
+    size_t blockCount;
+public:
+    TBlockChain(const Alloc& allocator_);
+    TBlockChain(const TBlockChain& other) = delete;
+    TBlockChain(TBlockChain&& other) noexcept;
+    ~TBlockChain();
+
+    TBlockChain& operator=(const TBlockChain& other) = delete;
+
+    TBlock* Acquire();
+    void Recycle(TBlock* block);
+    void Trim();
+    void StealFrom(TBlockChain& other);
+
+    size_t FreeCount() const;
+    size_t BlockCount() const;
+    Alloc GetAllocator() const;
+    bool SameStorage(const TBlockChain& other) const;
+};
+
+template<class T, size_t B, class Alloc>
+inline TBlockChain<T, B, Alloc>::TBlockChain(const Alloc& allocator_) : allocator(allocator_), freeList(nullptr), freeCount(0), blockCount(0)
+{
+}
+
+template<class T, size_t B, class Alloc>
+inline TBlockChain<T, B, Alloc>::TBlockChain(TBlockChain&& other) noexcept : allocator(std::move(other.allocator)), freeList(other.freeList), freeCount(other.freeCount), blockCount(other.blockCount)
+{
+    other.freeList = nullptr;
+    other.freeCount = 0;
+    other.blockCount = 0;
+}
+
+template<class T, size_t B, class Alloc>
+inline TBlockChain<T, B, Alloc>::~TBlockChain()
+{
+    Trim();
+}
+
+template<class T, size_t B, class Alloc>
+inline typename TBlockChain<T, B, Alloc>::TBlock* TBlockChain<T, B, Alloc>::Acquire()
+{
+    TBlock* block = freeList;
+    if (block != nullptr)
+    {
+        freeList = block->next;
+        freeCount--;
+    }
+    else
+    {
+        block = std::allocator_traits<TBlockAlloc>::allocate(allocator, 1);
+        blockCount++;
+    }
+    block->next = nullptr;
+    block->prev = nullptr;
+    return block;
+}
+
+template<class T, size_t B, class Alloc>
+inline void TBlockChain<T, B, Alloc>::Recycle(TBlock* block)
+{
+    block->next = freeList;
+    freeList = block;
+    freeCount++;
+}
+
+template<class T, size_t B, class Alloc>
+inline void TBlockChain<T, B, Alloc>::Trim()
+{
+    while (freeList != nullptr)
+    {
+        TBlock* next = freeList->next;
+        std::allocator_traits<TBlockAlloc>::deallocate(allocator, freeList, 1);
+        freeList = next;
+        blockCount--;
+    }
+    freeCount = 0;
+}
+
+// Takes over the other chain's blocks, both free and in use; the caller moves the in-use pointers.
+template<class T, size_t B, class Alloc>
+inline void TBlockChain<T, B, Alloc>::StealFrom(TBlockChain& other)
+{
+    Trim();
+    if constexpr (std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
+        allocator = std::move(other.allocator);
+    freeList = other.freeList;
+    freeCount = other.freeCount;
+    blockCount = other.blockCount;
+    other.freeList = nullptr;
+    other.freeCount = 0;
+    other.blockCount = 0;
+}
+
+template<class T, size_t B, class Alloc>
+inline size_t TBlockChain<T, B, Alloc>::FreeCount() const
+{
+    return freeCount;
+}
+
+template<class T, size_t B, class Alloc>
+inline size_t TBlockChain<T, B, Alloc>::BlockCount() const
+{
+    return blockCount;
+}
+
+template<class T, size_t B, class Alloc>
+inline Alloc TBlockChain<T, B, Alloc>::GetAllocator() const
+{
+    return Alloc(allocator);
+}
+
+template<class T, size_t B, class Alloc>
+inline bool TBlockChain<T, B, Alloc>::SameStorage(const TBlockChain& other) const
+{
+    return std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value || allocator == other.allocator;
+}
+
+
+template<class V, class Block>
+class TSegmentIterator {
+protected:
+    Block* block;
+    size_t index;
+    size_t blockSize;
+public:
+    TSegmentIterator(Block* block_, size_t index_, size_t blockSize_) : block(block_), index(index_), blockSize(blockSize_) {}
+
+    V& operator*() const { return block->Items()[index]; }
+    V* operator->() const { return block->Items() + index; }
+    TSegmentIterator& operator++()
+    {
+        ++index;
+        if (index == blockSize && block->next != nullptr)
+        {
+            block = block->next;
+            index = 0;
+        }
+        return *this;
+    }
+    TSegmentIterator operator++(int) { TSegmentIterator old(*this); ++*this; return old; }
+    bool operator==(const TSegmentIterator& other) const { return block == other.block && index == other.index; }
+    bool operator!=(const TSegmentIterator& other) const { return !(*this == other); }
+};
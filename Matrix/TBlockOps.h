@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+template<class T>
+inline void BlockCopy(T* dst, const T* src, size_t count)
+{
+    if constexpr (std::is_trivially_copyable<T>::value)
+    {
+        if (count)
+            std::memcpy(dst, src, count * sizeof(T));
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+            dst[i] = src[i];
+    }
+}
+
+template<class T>
+inline bool BlockEqual(T* a, T* b, size_t count)
+{
+    if constexpr (std::has_unique_object_representations<T>::value)
+    {
+        return count == 0 || std::memcmp(a, b, count * sizeof(T)) == 0;
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+            if (a[i] != b[i])
+                return false;
+        return true;
+    }
+}
+
+template<class T>
+inline void BlockMove(T* dst, T* src, size_t count)
+{
+    if constexpr (std::is_trivially_copyable<T>::value)
+    {
+        if (count)
+            std::memcpy(dst, src, count * sizeof(T));
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+            dst[i] = std::move(src[i]);
+    }
+}
+
+template<class Alloc>
+inline typename std::allocator_traits<Alloc>::value_type* AllocateRaw(Alloc& allocator, size_t count)
+{
+    if (count == 0)
+        return nullptr;
+    return std::allocator_traits<Alloc>::allocate(allocator, count);
+}
+
+template<class Alloc>
+inline void DeallocateRaw(Alloc& allocator, typename std::allocator_traits<Alloc>::value_type* memory, size_t count)
+{
+    if (memory != nullptr)
+        std::allocator_traits<Alloc>::deallocate(allocator, memory, count);
+}
+
+template<class T>
+inline void DestroyRange(T* first, size_t count)
+{
+    if constexpr (!std::is_trivially_destructible<T>::value)
+    {
+        for (size_t i = 0; i < count; ++i)
+            first[i].~T();
+    }
+}
+
+template<class T, class It>
+inline It UninitializedCopyFrom(T* dst, It src, size_t count)
+{
+    typedef typename std::iterator_traits<It>::value_type V;
+    if constexpr (std::is_pointer<It>::value && std::is_same<typename std::remove_cv<V>::type, T>::value && std::is_trivially_copyable<T>::value)
+    {
+        if (count)
+            std::memcpy(dst, src, count * sizeof(T));
+        return src + count;
+    }
+    else
+    {
+        size_t i = 0;
+        try
+        {
+            for (; i < count; ++i, ++src)
+                new (dst + i) T(*src);
+        }
+        catch (...)
+        {
+            DestroyRange(dst, i);
+            throw;
+        }
+        return src;
+    }
+}
+
+template<class T>
+inline void UninitializedCopy(T* dst, const T* src, size_t count)
+{
+    UninitializedCopyFrom(dst, src, count);
+}
+
+template<class T>
+inline void UninitializedMove(T* dst, T* src, size_t count)
+{
+    if constexpr (std::is_trivially_copyable<T>::value)
+    {
+        if (count)
+            std::memcpy(dst, src, count * sizeof(T));
+    }
+    else
+    {
+        size_t i = 0;
+        try
+        {
+            for (; i < count; ++i)
+                new (dst + i) T(std::move(src[i]));
+        }
+        catch (...)
+        {
+            DestroyRange(dst, i);
+            throw;
+        }
+    }
+}
+
+template<class T>
+inline void Relocate(T* dst, T* src)
+{
+    new (dst) T(std::move(*src));
+    src->~T();
+}
+
+// Relocates count objects into raw storage that does not overlap the source; the source is left raw.
+template<class T>
+inline void RelocateRange(T* dst, T* src, size_t count)
+{
+    if constexpr (std::is_trivially_copyable<T>::value)
+    {
+        if (count)
+            std::memcpy(dst, src, count * sizeof(T));
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+            Relocate(dst + i, src + i);
+    }
+}
+
+// Reference count for a buffer shared by copy-on-write containers; it starts at one owner. Copies share
+// the buffer until one of them is changed, and a container that has handed out a writable reference or
+// iterator (Emplace's result excepted) no longer shares its buffer with later copies.
+template<class Alloc>
+inline std::atomic<size_t>* AllocateShareCount(const Alloc& allocator)
+{
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<std::atomic<size_t>> TCountAlloc;
+    TCountAlloc countAllocator(allocator);
+    std::atomic<size_t>* shares = std::allocator_traits<TCountAlloc>::allocate(countAllocator, 1);
+    new (shares) std::atomic<size_t>(1);
+    return shares;
+}
+
+template<class Alloc>
+inline void DeallocateShareCount(const Alloc& allocator, std::atomic<size_t>* shares)
+{
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<std::atomic<size_t>> TCountAlloc;
+    TCountAlloc countAllocator(allocator);
+    shares->~atomic();
+    std::allocator_traits<TCountAlloc>::deallocate(countAllocator, shares, 1);
+}
+
+// Returns true when the caller held the last reference and must free the buffer.
+inline bool DropShare(std::atomic<size_t>* shares)
+{
+    return shares == nullptr || shares->fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "TError.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+enum class TWaitStrategy {
+    BusySpin,
+    Yield,
+    Block
+};
+
+template<class T>
+class TBroadcastRing {
+protected:
+    struct alignas(64) TSequence {
+        std::atomic<int64_t> value;
+    };
+
+    size_t capacity;
+    size_t consumerCount;
+    TWaitStrategy strategy;
+    T* slots;
+    std::atomic<int64_t>* published;
+    TSequence claimed;
+    TSequence gatingCache;
+    TSequence* cursors;
+    std::atomic<bool> halted;
+    std::mutex blockMutex;
+    std::condition_variable blockSignal;
+
+    int64_t MinCursor() const;
+    int64_t HighestPublished(int64_t from) const;
+    template<class P>
+    bool WaitUntil(P ready);
+    void Signal();
+public:
+    TBroadcastRing(size_t capacity_, size_t consumerCount_, TWaitStrategy strategy_ = TWaitStrategy::Yield);
+    TBroadcastRing(const TBroadcastRing& other) = delete;
+    ~TBroadcastRing();
+
+    TBroadcastRing& operator=(const TBroadcastRing& other) = delete;
+    T& operator[](int64_t sequence);
+    const T& operator[](int64_t sequence) const;
+
+    size_t Capacity() const;
+    size_t ConsumerCount() const;
+    size_t Available(size_t consumer) const;
+    bool IsHalted() const;
+
+    int64_t Next(size_t n = 1);
+    void Publish(int64_t sequence);
+    void Publish(int64_t first, int64_t last);
+    void Put(const T& elem);
+
+    template<class F>
+    size_t Process(size_t consumer, F handler);
+    template<class F>
+    size_t TryProcess(size_t consumer, F handler);
+    size_t Read(size_t consumer, T* out, size_t maxCount);
+    void Halt();
+};
+
+template<class T>
+inline TBroadcastRing<T>::TBroadcastRing(size_t capacity_, size_t consumerCount_, TWaitStrategy strategy_) : consumerCount(consumerCount_), strategy(strategy_), halted(false)
+{
+    if (capacity_ == 0 || consumerCount == 0)
+        ERROR("size_error");
+    capacity = 1;
+    while (capacity < capacity_)
+        capacity <<= 1;
+    slots = new T[capacity];
+    published = new std::atomic<int64_t>[capacity];
+    for (size_t i = 0; i < capacity; ++i)
+        published[i].store(-1, std::memory_order_relaxed);
+    cursors = new TSequence[consumerCount];
+    for (size_t i = 0; i < consumerCount; ++i)
+        cursors[i].value.store(-1, std::memory_order_relaxed);
+    claimed.value.store(0, std::memory_order_relaxed);
+    gatingCache.value.store(-1, std::memory_order_relaxed);
+}
+
+template<class T>
+inline TBroadcastRing<T>::~TBroadcastRing()
+{
+    delete[] slots;
+    delete[] published;
+    delete[] cursors;
+}
+
+template<class T>
+inline T& TBroadcastRing<T>::operator[](int64_t sequence)
+{
+    return slots[sequence & static_cast<int64_t>(capacity - 1)];
+}
+
+template<class T>
+inline const T& TBroadcastRing<T>::operator[](int64_t sequence) const
+{
+    return slots[sequence & static_cast<int64_t>(capacity - 1)];
+}
+
+template<class T>
+inline size_t TBroadcastRing<T>::Capacity() const
+{
+    return capacity;
+}
+
+template<class T>
+inline size_t TBroadcastRing<T>::ConsumerCount() const
+{
+    return consumerCount;
+}
+
+template<class T>
+inline bool TBroadcastRing<T>::IsHalted() const
+{
+    return halted.load(std::memory_order_acquire);
+}
+
+template<class T>
+inline int64_t TBroadcastRing<T>::MinCursor() const
+{
+    int64_t minimum = cursors[0].value.load(std::memory_order_acquire);
+    for (size_t i = 1; i < consumerCount; ++i)
+    {
+        int64_t cursor = cursors[i].value.load(std::memory_order_acquire);
+        if (cursor < minimum)
+            minimum = cursor;
+    }
+    return minimum;
+}
+
+template<class T>
+inline int64_t TBroadcastRing<T>::HighestPublished(int64_t from) const
+{
+    int64_t mask = static_cast<int64_t>(capacity - 1);
+    int64_t sequence = from;
+    while (published[sequence & mask].load(std::memory_order_acquire) == sequence)
+        sequence++;
+    return sequence - 1;
+}
+
+template<class T>
+template<class P>
+inline bool TBroadcastRing<T>::WaitUntil(P ready)
+{
+    while (!ready())
+    {
+        if (halted.load(std::memory_order_acquire))
+            return false;
+        switch (strategy)
+        {
+        case TWaitStrategy::BusySpin:
+            break;
+        case TWaitStrategy::Yield:
+            std::this_thread::yield();
+            break;
+        case TWaitStrategy::Block:
+        {
+            std::unique_lock<std::mutex> lock(blockMutex);
+            blockSignal.wait_for(lock, std::chrono::milliseconds(1), [&]() { return ready() || halted.load(); });
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+template<class T>
+inline void TBroadcastRing<T>::Signal()
+{
+    if (strategy == TWaitStrategy::Block)
+    {
+        std::lock_guard<std::mutex> lock(blockMutex);
+        blockSignal.notify_all();
+    }
+}
+
+template<class T>
+inline size_t TBroadcastRing<T>::Available(size_t consumer) const
+{
+    if (consumer >= consumerCount)
+        ERROR("consumer_error");
+    int64_t cursor = cursors[consumer].value.load(std::memory_order_relaxed);
+    return static_cast<size_t>(HighestPublished(cursor + 1) - cursor);
+}
+
+template<class T>
+inline int64_t TBroadcastRing<T>::Next(size_t n)
+{
+    if (n == 0 || n > capacity)
+        ERROR("size_error");
+    if (halted.load(std::memory_order_acquire))
+        ERROR("ring_halted");
+    int64_t last = claimed.value.fetch_add(static_cast<int64_t>(n), std::memory_order_acq_rel) + static_cast<int64_t>(n) - 1;
+    int64_t wrapPoint = last - static_cast<int64_t>(capacity);
+    if (wrapPoint > gatingCache.value.load(std::memory_order_relaxed))
+    {
+        bool ready = WaitUntil([&]()
+        {
+            int64_t minimum = MinCursor();
+            gatingCache.value.store(minimum, std::memory_order_relaxed);
+            return wrapPoint <= minimum;
+        });
+        if (!ready)
+            ERROR("ring_halted");
+    }
+    return last;
+}
+
+template<class T>
+inline void TBroadcastRing<T>::Publish(int64_t sequence)
+{
+    published[sequence & static_cast<int64_t>(capacity - 1)].store(sequence, std::memory_order_release);
+    Signal();
+}
+
+template<class T>
+inline void TBroadcastRing<T>::Publish(int64_t first, int64_t last)
+{
+    int64_t mask = static_cast<int64_t>(capacity - 1);
+    for (int64_t sequence = first; sequence <= last; ++sequence)
+        published[sequence & mask].store(sequence, std::memory_order_release);
+    Signal();
+}
+
+template<class T>
+inline void TBroadcastRing<T>::Put(const T& elem)
+{
+    int64_t sequence = Next();
+    (*this)[sequence] = elem;
+    Publish(sequence);
+}
+
+template<class T>
+template<class F>
+inline size_t TBroadcastRing<T>::TryProcess(size_t consumer, F handler)
+{
+    if (consumer >= consumerCount)
+        ERROR("consumer_error");
+    int64_t cursor = cursors[consumer].value.load(std::memory_order_relaxed);
+    int64_t highest = HighestPublished(cursor + 1);
+    if (highest <= cursor)
+        return 0;
+    for (int64_t sequence = cursor + 1; sequence <= highest; ++sequence)
+        handler(static_cast<const T&>((*this)[sequence]), sequence, sequence == highest);
+    cursors[consumer].value.store(highest, std::memory_order_release);
+    Signal();
+    return static_cast<size_t>(highest - cursor);
+}
+
+template<class T>
+template<class F>
+inline size_t TBroadcastRing<T>::Process(size_t consumer, F handler)
+{
+    if (consumer >= consumerCount)
+        ERROR("consumer_error");
+    int64_t next = cursors[consumer].value.load(std::memory_order_relaxed) + 1;
+    int64_t mask = static_cast<int64_t>(capacity - 1);
+    WaitUntil([&]() { return published[next & mask].load(std::memory_order_acquire) == next; });
+    return TryProcess(consumer, handler);
+}
+
+template<class T>
+inline size_t TBroadcastRing<T>::Read(size_t consumer, T* out, size_t maxCount)
+{
+    if (consumer >= consumerCount)
+        ERROR("consumer_error");
+    if (maxCount == 0)
+        return 0;
+    int64_t cursor = cursors[consumer].value.load(std::memory_order_relaxed);
+    int64_t highest = HighestPublished(cursor + 1);
+    if (highest - cursor > static_cast<int64_t>(maxCount))
+        highest = cursor + static_cast<int64_t>(maxCount);
+    for (int64_t sequence = cursor + 1; sequence <= highest; ++sequence)
+        *out++ = (*this)[sequence];
+    if (highest > cursor)
+    {
+        cursors[consumer].value.store(highest, std::memory_order_release);
+        Signal();
+    }
+    return static_cast<size_t>(highest > cursor ? highest - cursor : 0);
+}
+
+template<class T>
+inline void TBroadcastRing<T>::Halt()
+{
+    halted.store(true, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(blockMutex);
+    blockSignal.notify_all();
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include "TError.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+template<class T>
+class TConcurrentMultyStack
+{
+protected:
+	struct alignas(64) TStackInfo
+	{
+		size_t begin;
+		size_t start;
+		std::mutex mutex;
+	};
+
+	size_t capacity;
+	size_t count;
+	T* data;
+	TStackInfo* stacks;
+	mutable std::shared_mutex repackMutex;
+
+	bool IsFullLocked(size_t stackpos) const;
+	void Repack(size_t stackpos);
+public:
+	TConcurrentMultyStack();
+	TConcurrentMultyStack(size_t count_, size_t size);
+	TConcurrentMultyStack(const TConcurrentMultyStack& other) = delete;
+	~TConcurrentMultyStack();
+
+	TConcurrentMultyStack& operator=(const TConcurrentMultyStack& other) = delete;
+	T operator()(size_t stackpos, size_t pos) const;
+
+	size_t Capacity() const;
+	size_t Count() const;
+	size_t Size(size_t stackpos) const;
+	bool IsFull(size_t stackpos) const;
+	bool IsEmpty(size_t stackpos) const;
+	void Push(size_t stackpos, const T& elem);
+	T Pop(size_t stackpos);
+	bool TryPop(size_t stackpos, T& elem);
+	T FindMin() const;
+
+	template<class O>
+	friend std::ostream& operator<<(std::ostream& os, const TConcurrentMultyStack<O>& stack);
+};
+
+template<class T>
+inline bool TConcurrentMultyStack<T>::IsFullLocked(size_t stackpos) const
+{
+	if (stackpos < count - 1)
+		return stacks[stackpos].start == stacks[stackpos + 1].begin;
+	return stacks[stackpos].start == capacity;
+}
+
+template<class T>
+inline void TConcurrentMultyStack<T>::Repack(size_t stackpos)
+{
+	size_t posFirstNoFull(count);
+	for (size_t i = 0; i < count; ++i)
+		if (!IsFullLocked(i))
+		{
+			posFirstNoFull = i;
+			break;
+		}
+	if (posFirstNoFull == count)
+		ERROR("no_empty_stacks");
+	if (posFirstNoFull < stackpos)
+	{
+		for (size_t i = stacks[posFirstNoFull + 1].begin; i < stacks[stackpos].start; ++i)
+			data[i - 1] = std::move(data[i]);
+		for (size_t i = posFirstNoFull + 1; i <= stackpos; ++i)
+		{
+			stacks[i].begin -= 1;
+			stacks[i].start -= 1;
+		}
+	}
+	else
+	{
+		for (size_t i = stacks[posFirstNoFull].start; i > stacks[stackpos + 1].begin; --i)
+			data[i] = std::move(data[i - 1]);
+		for (size_t i = stackpos + 1; i <= posFirstNoFull; ++i)
+		{
+			stacks[i].begin += 1;
+			stacks[i].start += 1;
+		}
+	}
+}
+
+template<class T>
+inline TConcurrentMultyStack<T>::TConcurrentMultyStack() : capacity(0), count(0)
+{
+	data = nullptr;
+	stacks = nullptr;
+}
+
+template<class T>
+inline TConcurrentMultyStack<T>::TConcurrentMultyStack(size_t count_, size_t size) : capacity(count_ * size), count(count_)
+{
+	if (capacity == 0 || count == 0)
+	{
+		capacity = 0;
+		count = 0;
+		data = nullptr;
+		stacks = nullptr;
+		return;
+	}
+	data = new T[capacity];
+	stacks = new TStackInfo[count];
+	for (size_t i = 0; i < count; ++i)
+	{
+		stacks[i].begin = i * size;
+		stacks[i].start = i * size;
+	}
+}
+
+template<class T>
+inline TConcurrentMultyStack<T>::~TConcurrentMultyStack()
+{
+	if (data) delete[] data;
+	if (stacks) delete[] stacks;
+	capacity = 0;
+	count = 0;
+}
+
+template<class T>
+inline T TConcurrentMultyStack<T>::operator()(size_t stackpos, size_t pos) const
+{
+	if (stackpos >= count)
+		ERROR("stacks_error");
+	std::shared_lock<std::shared_mutex> repackLock(repackMutex);
+	std::lock_guard<std::mutex> stackLock(stacks[stackpos].mutex);
+	if (pos >= stacks[stackpos].start - stacks[stackpos].begin)
+		ERROR("size_error");
+	return data[stacks[stackpos].begin + pos];
+}
+
+template<class T>
+inline size_t TConcurrentMultyStack<T>::Capacity() const
+{
+	return capacity;
+}
+
+template<class T>
+inline size_t TConcurrentMultyStack<T>::Count() const
+{
+	return count;
+}
+
+template<class T>
+inline size_t TConcurrentMultyStack<T>::Size(size_t stackpos) const
+{
+	if (stackpos >= count)
+		ERROR("stack_error");
+	std::shared_lock<std::shared_mutex> repackLock(repackMutex);
+	std::lock_guard<std::mutex> stackLock(stacks[stackpos].mutex);
+	return stacks[stackpos].start - stacks[stackpos].begin;
+}
+
+template<class T>
+inline bool TConcurrentMultyStack<T>::IsFull(size_t stackpos) const
+{
+	if (stackpos >= count)
+		ERROR("stack_error");
+	std::shared_lock<std::shared_mutex> repackLock(repackMutex);
+	std::lock_guard<std::mutex> stackLock(stacks[stackpos].mutex);
+	return IsFullLocked(stackpos);
+}
+
+template<class T>
+inline bool TConcurrentMultyStack<T>::IsEmpty(size_t stackpos) const
+{
+	return Size(stackpos) == 0;
+}
+
+template<class T>
+inline void TConcurrentMultyStack<T>::Push(size_t stackpos, const T& elem)
+{
+	if (stackpos >= count)
+		ERROR("stack_error");
+	{
+		std::shared_lock<std::shared_mutex> repackLock(repackMutex);
+		std::lock_guard<std::mutex> stackLock(stacks[stackpos].mutex);
+		if (!IsFullLocked(stackpos))
+		{
+			data[stacks[stackpos].start] = elem;
+			stacks[stackpos].start++;
+			return;
+		}
+	}
+	std::unique_lock<std::shared_mutex> repackLock(repackMutex);
+	if (IsFullLocked(stackpos))
+		Repack(stackpos);
+	data[stacks[stackpos].start] = elem;
+	stacks[stackpos].start++;
+}
+
+template<class T>
+inline T TConcurrentMultyStack<T>::Pop(size_t stackpos)
+{
+	T elem;
+	if (!TryPop(stackpos, elem))
+		ERROR("empty_stack");
+	return elem;
+}
+
+template<class T>
+inline bool TConcurrentMultyStack<T>::TryPop(size_t stackpos, T& elem)
+{
+	if (stackpos >= count)
+		ERROR("stack_error");
+	std::shared_lock<std::shared_mutex> repackLock(repackMutex);
+	std::lock_guard<std::mutex> stackLock(stacks[stackpos].mutex);
+	if (stacks[stackpos].start == stacks[stackpos].begin)
+		return false;
+	stacks[stackpos].start--;
+	elem = std::move(data[stacks[stackpos].start]);
+	return true;
+}
+
+template<class T>
+inline T TConcurrentMultyStack<T>::FindMin() const
+{
+	std::unique_lock<std::shared_mutex> repackLock(repackMutex);
+	bool found = false;
+	T minElem;
+	for (size_t i = 0; i < count; ++i)
+		for (size_t j = stacks[i].begin; j < stacks[i].start; ++j)
+			if (!found || data[j] < minElem)
+			{
+				minElem = data[j];
+				found = true;
+			}
+	if (!found)
+		ERROR("all_stacks_empty");
+	return minElem;
+}
+
+template<class O>
+std::ostream& operator<<(std::ostream& os, const TConcurrentMultyStack<O>& stack)
+{
+	std::unique_lock<std::shared_mutex> repackLock(stack.repackMutex);
+	os << "{";
+	for (size_t i = 0; i < stack.count; ++i) {
+		os << "[";
+		for (size_t j = stack.stacks[i].begin; j < stack.stacks[i].start; ++j) {
+			os << stack.data[j];
+			if (j < stack.stacks[i].start - 1) {
+				os << ",";
+			}
+		}
+		os << "]";
+		if (i < stack.count - 1) {
+			os << ",";
+		}
+	}
+	os << "}\n";
+	return os;
+}
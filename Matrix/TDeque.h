@@ -0,0 +1,576 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include "TError.h"
+#include "TBlockOps.h"
+#include "TRingIterator.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+template<class T, class Alloc = std::allocator<T>>
+class TDeque {
+protected:
+    size_t head;
+    size_t size;
+    size_t capacity;
+    T* memory;
+    Alloc allocator;
+
+    size_t Slot(size_t index) const;
+    void CopyInto(T* raw) const;
+    void MoveInto(T* raw);
+    void Grow(size_t minCapacity);
+    void Release();
+public:
+    typedef TRingIterator<T> iterator;
+    typedef TRingIterator<const T> const_iterator;
+
+    TDeque();
+    TDeque(size_t capacity_, const Alloc& allocator_ = Alloc());
+    TDeque(const TDeque& other);
+    TDeque(TDeque&& other) noexcept;
+    ~TDeque();
+
+    TDeque& operator=(const TDeque& other);
+    TDeque& operator=(TDeque&& other) noexcept;
+    bool operator==(const TDeque& other);
+    bool operator!=(const TDeque& other);
+
+    bool IsEmpty();
+    size_t Capacity() const;
+    void Reserve(size_t count);
+    Alloc GetAllocator() const;
+
+    T& operator[] (size_t index);
+    const T& operator[] (size_t index) const;
+
+    iterator begin();
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end();
+    const_iterator end() const;
+    const_iterator cend() const;
+
+    void PushBack(const T& elem);
+    void PushBack(T&& elem);
+    void PushFront(const T& elem);
+    void PushFront(T&& elem);
+    template<class... Args>
+    T& EmplaceBack(Args&&... args);
+    template<class... Args>
+    T& EmplaceFront(Args&&... args);
+    T PopBack();
+    T PopFront();
+    T& Front();
+    const T& Front() const;
+    T& Back();
+    const T& Back() const;
+    T Min();
+    size_t Size();
+
+    void WriteToFile(const TString& filename) const;
+    void ReadFromFile(const TString& filename);
+
+    template<class U, class A>
+    friend std::ostream& operator<<(std::ostream& os, const TDeque<U, A>& deque);
+    template<class O, class A>
+    friend std::istream& operator>>(std::istream& is, TDeque<O, A>& deque);
+};
+
+template<class T, class Alloc>
+inline size_t TDeque<T, Alloc>::Slot(size_t index) const
+{
+    index += head;
+    return index < capacity ? index : index - capacity;
+}
+
+template<class T, class Alloc>
+inline void TDeque<T, Alloc>::CopyInto(T* raw) const
+{
+    size_t firstPart = capacity - head < size ? capacity - head : size;
+    UninitializedCopy(raw, memory + head, firstPart);
+    try
+    {
+        UninitializedCopy(raw + firstPart, memory, size - firstPart);
+    }
+    catch (...)
+    {
+        DestroyRange(raw, firstPart);
+        throw;
+    }
+}
+
+template<class T, class Alloc>
+inline void TDeque<T, Alloc>::MoveInto(T* raw)
+{
+    size_t firstPart = capacity - head < size ? capacity - head : size;
+    UninitializedMove(raw, memory + head, firstPart);
+    try
+    {
+        UninitializedMove(raw + firstPart, memory, size - firstPart);
+    }
+    catch (...)
+    {
+        DestroyRange(raw, firstPart);
+        throw;
+    }
+}
+
+// Unrolls the ring into a new block of at least twice the size, with the front at slot zero.
+template<class T, class Alloc>
+inline void TDeque<T, Alloc>::Grow(size_t minCapacity)
+{
+    size_t newCapacity = capacity * 2 > minCapacity ? capacity * 2 : minCapacity;
+    T* raw = AllocateRaw(allocator, newCapacity);
+    try
+    {
+        MoveInto(raw);
+    }
+    catch (...)
+    {
+        DeallocateRaw(allocator, raw, newCapacity);
+        throw;
+    }
+    size_t count = size;
+    Release();
+    memory = raw;
+    capacity = newCapacity;
+    size = count;
+}
+
+template<class T, class Alloc>
+inline void TDeque<T, Alloc>::Release()
+{
+    size_t firstPart = capacity - head < size ? capacity - head : size;
+    DestroyRange(memory + head, firstPart);
+    DestroyRange(memory, size - firstPart);
+    DeallocateRaw(allocator, memory, capacity);
+    memory = nullptr;
+    head = 0;
+    size = 0;
+    capacity = 0;
+}
+
+template<class T, class Alloc>
+inline TDeque<T, Alloc>::TDeque() : head(0), size(0), capacity(0)
+{
+    memory = nullptr;
+}
+
+template<class T, class Alloc>
+inline TDeque<T, Alloc>::TDeque(size_t capacity_, const Alloc& allocator_) : head(0), size(0), capacity(capacity_), allocator(allocator_)
+{
+    memory = AllocateRaw(allocator, capacity);
+}
+
+template<class T, class Alloc>
+inline TDeque<T, Alloc>::TDeque(const TDeque& other) : head(0), size(0), capacity(other.capacity), allocator(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.allocator))
+{
+    memory = AllocateRaw(allocator, capacity);
+    try
+    {
+        other.CopyInto(memory);
+    }
+    catch (...)
+    {
+        DeallocateRaw(allocator, memory, capacity);
+        throw;
+    }
+    size = other.size;
+}
+
+template<class T, class Alloc>
+inline TDeque<T, Alloc>::TDeque(TDeque&& other) noexcept : allocator(std::move(other.allocator))
+{
+    head = other.head;
+    size = other.size;
+    capacity = other.capacity;
+    memory = other.memory;
+    other.memory = nullptr;
+    other.head = 0;
+    other.size = 0;
+    other.capacity = 0;
+}
+
+template<class T, class Alloc>
+inline TDeque<T, Alloc>::~TDeque()
+{
+    Release();
+}
+
+template<class T, class Alloc>
+inline TDeque<T, Alloc>& TDeque<T, Alloc>::operator=(const TDeque<T, Alloc>& other)
+{
+    if (this != &other)
+    {
+        TDeque<T, Alloc> copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template<class T, class Alloc>
+inline TDeque<T, Alloc>& TDeque<T, Alloc>::operator=(TDeque<T, Alloc>&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+    Release();
+    if constexpr (!std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
+    {
+        if (!(allocator == other.allocator))
+        {
+            memory = AllocateRaw(allocator, other.capacity);
+            capacity = other.capacity;
+            other.MoveInto(memory);
+            size = other.size;
+            other.Release();
+            return *this;
+        }
+    }
+    else
+        allocator = std::move(other.allocator);
+    head = other.head;
+    size = other.size;
+    capacity = other.capacity;
+    memory = other.memory;
+    other.memory = nullptr;
+    other.head = 0;
+    other.size = 0;
+    other.capacity = 0;
+    return *this;
+}
+
+template<class T, class Alloc>
+inline bool TDeque<T, Alloc>::operator==(const TDeque& other)
+{
+    if (size != other.size)
+        return false;
+    size_t i = 0;
+    while (i < size)
+    {
+        size_t slot = Slot(i);
+        size_t otherSlot = other.Slot(i);
+        size_t run = size - i;
+        if (capacity - slot < run)
+            run = capacity - slot;
+        if (other.capacity - otherSlot < run)
+            run = other.capacity - otherSlot;
+        if (!BlockEqual(memory + slot, other.memory + otherSlot, run))
+            return false;
+        i += run;
+    }
+    return true;
+}
+
+template<class T, class Alloc>
+inline bool TDeque<T, Alloc>::operator!=(const TDeque& other)
+{
+    return !(*this == other);
+}
+
+template<class T, class Alloc>
+inline bool TDeque<T, Alloc>::IsEmpty()
+{
+    return size == 0;
+}
+
+template<class T, class Alloc>
+inline size_t TDeque<T, Alloc>::Capacity() const
+{
+    return capacity;
+}
+
+template<class T, class Alloc>
+inline void TDeque<T, Alloc>::Reserve(size_t count)
+{
+    if (count > capacity)
+        Grow(count);
+}
+
+template<class T, class Alloc>
+inline Alloc TDeque<T, Alloc>::GetAllocator() const
+{
+    return allocator;
+}
+
+template<class T, class Alloc>
+inline T& TDeque<T, Alloc>:: operator[] (size_t index)
+{
+    if (index >= size)
+        ERROR("size_error");
+    return memory[Slot(index)];
+}
+
+template<class T, class Alloc>
+inline const T& TDeque<T, Alloc>:: operator[] (size_t index) const
+{
+    if (index >= size)
+        ERROR("size_error");
+    return memory[Slot(index)];
+}
+
+template<class T, class Alloc>
+inline typename TDeque<T, Alloc>::iterator TDeque<T, Alloc>::begin()
+{
+    return iterator(memory, capacity, head);
+}
+
+template<class T, class Alloc>
+inline typename TDeque<T, Alloc>::const_iterator TDeque<T, Alloc>::begin() const
+{
+    return const_iterator(memory, capacity, head);
+}
+
+template<class T, class Alloc>
+inline typename TDeque<T, Alloc>::const_iterator TDeque<T, Alloc>::cbegin() const
+{
+    return const_iterator(memory, capacity, head);
+}
+
+template<class T, class Alloc>
+inline typename TDeque<T, Alloc>::iterator TDeque<T, Alloc>::end()
+{
+    return iterator(memory, capacity, head + size);
+}
+
+template<class T, class Alloc>
+inline typename TDeque<T, Alloc>::const_iterator TDeque<T, Alloc>::end() const
+{
+    return const_iterator(memory, capacity, head + size);
+}
+
+template<class T, class Alloc>
+inline typename TDeque<T, Alloc>::const_iterator TDeque<T, Alloc>::cend() const
+{
+    return const_iterator(memory, capacity, head + size);
+}
+
+template<class T, class Alloc>
+inline void TDeque<T, Alloc>::PushBack(const T& elem)
+{
+    EmplaceBack(elem);
+}
+
+template<class T, class Alloc>
+inline void TDeque<T, Alloc>::PushBack(T&& elem)
+{
+    EmplaceBack(std::move(elem));
+}
+
+template<class T, class Alloc>
+inline void TDeque<T, Alloc>::PushFront(const T& elem)
+{
+    EmplaceFront(elem);
+}
+
+template<class T, class Alloc>
+inline void TDeque<T, Alloc>::PushFront(T&& elem)
+{
+    EmplaceFront(std::move(elem));
+}
+
+// When the ring is full the new element is built first, since its arguments may refer into the deque.
+template<class T, class Alloc>
+template<class... Args>
+inline T& TDeque<T, Alloc>::EmplaceBack(Args&&... args)
+{
+    T* slot;
+    if (size == capacity)
+    {
+        T elem(std::forward<Args>(args)...);
+        Grow(size + 1);
+        slot = new (memory + Slot(size)) T(std::move(elem));
+    }
+    else
+        slot = new (memory + Slot(size)) T(std::forward<Args>(args)...);
+    size++;
+    return *slot;
+}
+
+template<class T, class Alloc>
+template<class... Args>
+inline T& TDeque<T, Alloc>::EmplaceFront(Args&&... args)
+{
+    T* slot;
+    if (size == capacity)
+    {
+        T elem(std::forward<Args>(args)...);
+        Grow(size + 1);
+        size_t front = head == 0 ? capacity - 1 : head - 1;
+        slot = new (memory + front) T(std::move(elem));
+        head = front;
+    }
+    else
+    {
+        size_t front = head == 0 ? capacity - 1 : head - 1;
+        slot = new (memory + front) T(std::forward<Args>(args)...);
+        head = front;
+    }
+    size++;
+    return *slot;
+}
+
+template<class T, class Alloc>
+inline T TDeque<T, Alloc>::PopBack()
+{
+    if (size != 0)
+    {
+        T* slot = memory + Slot(size - 1);
+        T elem(std::move(*slot));
+        slot->~T();
+        size--;
+        return elem;
+    }
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, class Alloc>
+inline T TDeque<T, Alloc>::PopFront()
+{
+    if (size != 0)
+    {
+        T elem(std::move(memory[head]));
+        memory[head].~T();
+        head = Slot(1);
+        size--;
+        return elem;
+    }
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, class Alloc>
+inline T& TDeque<T, Alloc>::Front()
+{
+    if (size != 0)
+        return memory[head];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, class Alloc>
+inline const T& TDeque<T, Alloc>::Front() const
+{
+    if (size != 0)
+        return memory[head];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, class Alloc>
+inline T& TDeque<T, Alloc>::Back()
+{
+    if (size != 0)
+        return memory[Slot(size - 1)];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, class Alloc>
+inline const T& TDeque<T, Alloc>::Back() const
+{
+    if (size != 0)
+        return memory[Slot(size - 1)];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, class Alloc>
+inline T TDeque<T, Alloc>::Min()
+{
+    if (size != 0)
+    {
+        T min = memory[head];
+        for (size_t i = 1; i < size; ++i)
+            if (memory[Slot(i)] < min)
+                min = memory[Slot(i)];
+        return min;
+    }
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, class Alloc>
+inline size_t TDeque<T, Alloc>::Size()
+{
+    return size;
+}
+
+template<class T, class Alloc>
+void TDeque<T, Alloc>::WriteToFile(const TString& filename) const
+{
+    std::ofstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    file << size << std::endl;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        file << memory[Slot(i)] << std::endl;
+    }
+
+    file.close();
+}
+
+template<class T, class Alloc>
+void TDeque<T, Alloc>::ReadFromFile(const TString& filename)
+{
+    std::ifstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    size_t count;
+    file >> count;
+
+    Release();
+    memory = AllocateRaw(allocator, count);
+    capacity = count;
+
+    T element;
+    for (size_t i = 0; i < count; ++i)
+    {
+        file >> element;
+        new (memory + size) T(element);
+        size++;
+    }
+
+    file.close();
+}
+
+template<class T, class Alloc>
+std::ostream& operator<<(std::ostream& os, const TDeque<T, Alloc>& deque)
+{
+    os << "[";
+    for (size_t i = 0; i < deque.size; ++i) {
+        os << deque.memory[deque.Slot(i)];
+        if (i < deque.size - 1)
+            os << ", ";
+    }
+    os << "]";
+    return os;
+}
+
+template<class T, class Alloc>
+std::istream& operator>>(std::istream& is, TDeque<T, Alloc>& deque)
+{
+    size_t count;
+    is >> count;
+
+    deque.Release();
+    deque.memory = AllocateRaw(deque.allocator, count);
+    deque.capacity = count;
+
+    T element;
+    for (size_t i = 0; i < count; ++i)
+    {
+        is >> element;
+        new (deque.memory + deque.size) T(element);
+        deque.size++;
+    }
+
+    return is;
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include "TError.h"
+#include "TBinaryFormat.h"
+#include "TMultyStack.h"
+#include "TReduce.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+// A TMultyStack file used in place: opening checks the header and the stack bounds and maps the
+// elements without reading them, Verify() checks the data checksum on demand. Elements are read
+// through const references; a copy-on-write view may also Set, Push and Pop within each stack's saved
+// segment, and those changes stay private to the view. Only dense files can be mapped: sparse files
+// and deltas have no room for the free slots.
+template<class T>
+class TMappedMultyStack
+{
+protected:
+	static_assert(std::is_trivially_copyable<T>::value, "mapped elements are used as raw bytes");
+
+	TMappedFile file;
+	size_t capacity;
+	size_t count;
+	const TMultyStackHeader* header;
+	uint64_t* stacksBegin;
+	uint64_t* starts;
+	T* data;
+	void CheckWritable() const;
+public:
+	TMappedMultyStack(const std::string& filename, bool copyOnWrite = false);
+	TMappedMultyStack(const TMappedMultyStack& other) = delete;
+
+	TMappedMultyStack& operator=(const TMappedMultyStack& other) = delete;
+	const T& operator()(size_t stackpos, size_t pos) const;
+
+	size_t Capacity() const;
+	size_t Count() const;
+	size_t Capacity(size_t stackpos) const;
+	size_t Size(size_t stackpos) const;
+	bool IsFull(size_t stackpos) const;
+	bool IsEmpty(size_t stackpos) const;
+	bool IsWritable() const;
+	bool Verify() const;
+	void Set(size_t stackpos, size_t pos, const T& elem);
+	void Push(size_t stackpos, const T& elem);
+	T Pop(size_t stackpos);
+	const T& Top(size_t stackpos) const;
+	T Min(size_t stackpos) const;
+	T FindMin() const;
+
+	template<class O>
+	friend std::ostream& operator<<(std::ostream& os, const TMappedMultyStack<O>& stack);
+};
+
+template<class T>
+inline TMappedMultyStack<T>::TMappedMultyStack(const std::string& filename, bool copyOnWrite) : file(filename, copyOnWrite)
+{
+	if (file.Size() < sizeof(TMultyStackHeader))
+		ERROR("format_error");
+	char* base = static_cast<char*>(file.Data());
+	header = reinterpret_cast<const TMultyStackHeader*>(base);
+	header->Check(sizeof(T), alignof(T), file.Size());
+	if (header->Kind() != TMultyStackHeader::dense)
+		ERROR("format_error");
+	stacksBegin = reinterpret_cast<uint64_t*>(base + header->indexOffset);
+	starts = stacksBegin + header->count;
+	if (Checksum(stacksBegin, 2 * header->count * sizeof(uint64_t)) != header->indexChecksum)
+		ERROR("checksum_error");
+	header->CheckIndex(stacksBegin);
+	data = reinterpret_cast<T*>(base + header->dataOffset);
+	capacity = header->capacity;
+	count = header->count;
+}
+
+template<class T>
+inline void TMappedMultyStack<T>::CheckWritable() const
+{
+	if (!file.IsWritable())
+		ERROR("mapping_error");
+}
+
+template<class T>
+inline const T& TMappedMultyStack<T>::operator()(size_t stackpos, size_t pos) const
+{
+	if (stackpos >= count)
+		ERROR("stacks_error");
+	if (pos >= this->Size(stackpos))
+		ERROR("size_error");
+	return data[stacksBegin[stackpos] + pos];
+}
+
+template<class T>
+inline size_t TMappedMultyStack<T>::Capacity() const
+{
+	return capacity;
+}
+
+template<class T>
+inline size_t TMappedMultyStack<T>::Count() const
+{
+	return count;
+}
+
+template<class T>
+inline size_t TMappedMultyStack<T>::Capacity(size_t stackpos) const
+{
+	if (stackpos >= count)
+		ERROR("stack_error");
+	return (stackpos + 1 < count ? stacksBegin[stackpos + 1] : capacity) - stacksBegin[stackpos];
+}
+
+template<class T>
+inline size_t TMappedMultyStack<T>::Size(size_t stackpos) const
+{
+	if (stackpos >= count)
+		ERROR("stack_error");
+	return starts[stackpos] - stacksBegin[stackpos];
+}
+
+template<class T>
+inline bool TMappedMultyStack<T>::IsFull(size_t stackpos) const
+{
+	return this->Size(stackpos) == this->Capacity(stackpos);
+}
+
+template<class T>
+inline bool TMappedMultyStack<T>::IsEmpty(size_t stackpos) const
+{
+	return this->Size(stackpos) == 0;
+}
+
+template<class T>
+inline bool TMappedMultyStack<T>::IsWritable() const
+{
+	return file.IsWritable();
+}
+
+// Only meaningful before the view is changed: pushes, pops and element writes are not reflected in the checksums.
+template<class T>
+inline bool TMappedMultyStack<T>::Verify() const
+{
+	return Checksum(data, capacity * sizeof(T)) == header->dataChecksum;
+}
+
+template<class T>
+inline void TMappedMultyStack<T>::Set(size_t stackpos, size_t pos, const T& elem)
+{
+	CheckWritable();
+	if (stackpos >= count)
+		ERROR("stacks_error");
+	if (pos >= this->Size(stackpos))
+		ERROR("size_error");
+	data[stacksBegin[stackpos] + pos] = elem;
+}
+
+// Segments are fixed in a mapped file, so a full stack cannot borrow space from its neighbours.
+template<class T>
+inline void TMappedMultyStack<T>::Push(size_t stackpos, const T& elem)
+{
+	CheckWritable();
+	if (this->IsFull(stackpos))
+		ERROR("full_stack");
+	data[starts[stackpos]] = elem;
+	starts[stackpos]++;
+}
+
+template<class T>
+inline T TMappedMultyStack<T>::Pop(size_t stackpos)
+{
+	CheckWritable();
+	if (this->IsEmpty(stackpos))
+		ERROR("empty_stack");
+	starts[stackpos]--;
+	return data[starts[stackpos]];
+}
+
+template<class T>
+inline const T& TMappedMultyStack<T>::Top(size_t stackpos) const
+{
+	if (this->IsEmpty(stackpos))
+		ERROR("empty_stack");
+	return data[starts[stackpos] - 1];
+}
+
+// Unlike TMultyStack the view keeps no minimum index, so both queries scan the stacks.
+template<class T>
+inline T TMappedMultyStack<T>::Min(size_t stackpos) const
+{
+	if (this->IsEmpty(stackpos))
+		ERROR("empty_stack");
+	return ReduceMin(data + stacksBegin[stackpos], this->Size(stackpos));
+}
+
+template<class T>
+inline T TMappedMultyStack<T>::FindMin() const
+{
+	if (capacity == 0 || count == 0)
+		ERROR("empty_stack");
+	size_t best = count;
+	T result = T();
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (this->IsEmpty(i))
+			continue;
+		T min = this->Min(i);
+		if (best == count || min < result)
+		{
+			result = min;
+			best = i;
+		}
+	}
+	if (best == count)
+		ERROR("all_stacks_empty");
+	return result;
+}
+
+template<class O>
+std::ostream& operator<<(std::ostream& os, const TMappedMultyStack<O>& stack)
+{
+	os << "{";
+	for (size_t i = 0; i < stack.Count(); ++i) {
+		os << "[";
+		for (size_t j = 0; j < stack.Size(i); ++j) {
+			os << stack(i, j);
+			if (j < stack.Size(i) - 1) {
+				os << ",";
+			}
+		}
+		os << "]";
+		if (i < stack.Count() - 1) {
+			os << ",";
+		}
+	}
+	os << "}\n";
+	return os;
+}
@@ -0,0 +1,658 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include "TError.h"
+#include "TBlockOps.h"
+#include "TBinaryFormat.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+// FIFO counterpart of TMultyStack: every queue is a ring over its own segment of one shared buffer.
+// When a queue fills, all rings are unrolled and the free slots are dealt out again in proportion to each queue's size.
+template<class T, class Alloc = std::allocator<T>>
+class TMultyQueue
+{
+protected:
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<size_t> TIndexAlloc;
+
+	size_t capacity;
+	size_t count;
+	T* data;
+	size_t* queuesBegin;
+	size_t* heads;
+	size_t* sizes;
+	Alloc allocator;
+	TIndexAlloc indexAllocator;
+	size_t Length(size_t queuepos) const;
+	T* Slot(size_t queuepos, size_t pos) const;
+	void Unroll(size_t queuepos);
+	void Repack(size_t queuepos);
+	void AllocateIndices(size_t count_);
+	void AllocateLike(const TMultyQueue& other);
+	void CopyFrom(const TMultyQueue& other);
+	void MoveFrom(TMultyQueue& other);
+	void Release();
+public:
+	TMultyQueue();
+	TMultyQueue(size_t count_, size_t size, const Alloc& allocator_ = Alloc());
+	TMultyQueue(const TMultyQueue& other);
+	TMultyQueue(TMultyQueue&& other) noexcept;
+	~TMultyQueue();
+
+	bool operator==(const TMultyQueue& other) const;
+	bool operator!=(const TMultyQueue& other) const;
+	T& operator()(size_t queuepos, size_t pos);
+	const T& operator()(size_t queuepos, size_t pos) const;
+	TMultyQueue& operator=(const TMultyQueue& other);
+	TMultyQueue& operator=(TMultyQueue&& other) noexcept;
+
+	size_t Capacity() const;
+	size_t Count() const;
+	Alloc GetAllocator() const;
+	size_t Size(size_t queuepos) const;
+	bool IsFull(size_t queuepos) const;
+	bool IsEmpty(size_t queuepos) const;
+	void Put(size_t queuepos, const T& elem);
+	void Put(size_t queuepos, T&& elem);
+	template<class... Args>
+	T& Emplace(size_t queuepos, Args&&... args);
+	T Get(size_t queuepos);
+	T& Head(size_t queuepos);
+	const T& Head(size_t queuepos) const;
+	T& Tail(size_t queuepos);
+	const T& Tail(size_t queuepos) const;
+	T FindMin() const;
+	void SaveToFile(const std::string& filename) const;
+	void LoadFromFile(const std::string& filename);
+
+	template<class O, class A>
+	friend std::ostream& operator<<(std::ostream& os, const TMultyQueue<O, A>& queue);
+	template<class I, class A>
+	friend std::istream& operator>>(std::istream& is, TMultyQueue<I, A>& queue);
+};
+
+template<class T, class Alloc>
+inline size_t TMultyQueue<T, Alloc>::Length(size_t queuepos) const
+{
+	return (queuepos + 1 < count ? queuesBegin[queuepos + 1] : capacity) - queuesBegin[queuepos];
+}
+
+template<class T, class Alloc>
+inline T* TMultyQueue<T, Alloc>::Slot(size_t queuepos, size_t pos) const
+{
+	return data + queuesBegin[queuepos] + (heads[queuepos] + pos) % Length(queuepos);
+}
+
+// Moves the ring so that its head sits at the start of the segment; live elements only ever move down.
+template<class T, class Alloc>
+inline void TMultyQueue<T, Alloc>::Unroll(size_t queuepos)
+{
+	size_t head = heads[queuepos];
+	if (head == 0)
+		return;
+	T* base = data + queuesBegin[queuepos];
+	size_t length = Length(queuepos);
+	size_t size = sizes[queuepos];
+	if (head + size <= length)
+	{
+		for (size_t i = 0; i < size; ++i)
+			Relocate(base + i, base + head + i);
+	}
+	else
+	{
+		size_t wrapped = size - (length - head);
+		if (head != wrapped)
+			for (size_t i = 0; i < length - head; ++i)
+				Relocate(base + wrapped + i, base + head + i);
+		std::rotate(base, base + wrapped, base + size);
+	}
+	heads[queuepos] = 0;
+}
+
+template<class T, class Alloc>
+inline void TMultyQueue<T, Alloc>::Repack(size_t queuepos)
+{
+	if (queuepos >= count)
+		ERROR("stack_error");
+	size_t total = 0;
+	for (size_t i = 0; i < count; ++i)
+		total += sizes[i];
+	if (total == capacity)
+		ERROR("no_empty_stacks");
+	for (size_t i = 0; i < count; ++i)
+		Unroll(i);
+
+	// heads are all zero now, so they hold the new segment starts until the moves are done
+	size_t spare = capacity - total - 1;
+	size_t given = 0;
+	for (size_t i = 0; i < count; ++i)
+		given += spare * (sizes[i] + 1) / (total + count);
+	for (size_t i = 0, begin = 0; i < count; ++i)
+	{
+		heads[i] = begin;
+		begin += sizes[i] + spare * (sizes[i] + 1) / (total + count);
+		if (i == queuepos)
+			begin += 1 + spare - given;
+	}
+	for (size_t i = 0; i < count; ++i)
+		if (heads[i] < queuesBegin[i])
+		{
+			for (size_t j = 0; j < sizes[i]; ++j)
+				Relocate(data + heads[i] + j, data + queuesBegin[i] + j);
+			queuesBegin[i] = heads[i];
+		}
+	for (size_t i = count; i > 0; --i)
+		if (heads[i - 1] > queuesBegin[i - 1])
+		{
+			for (size_t j = sizes[i - 1]; j > 0; --j)
+				Relocate(data + heads[i - 1] + j - 1, data + queuesBegin[i - 1] + j - 1);
+			queuesBegin[i - 1] = heads[i - 1];
+		}
+	for (size_t i = 0; i < count; ++i)
+		heads[i] = 0;
+}
+
+template<class T, class Alloc>
+inline void TMultyQueue<T, Alloc>::AllocateIndices(size_t count_)
+{
+	if (count_ == 0)
+		return;
+	queuesBegin = AllocateRaw(indexAllocator, 3 * count_);
+	heads = queuesBegin + count_;
+	sizes = heads + count_;
+	count = count_;
+	for (size_t i = 0; i < count; ++i)
+	{
+		queuesBegin[i] = 0;
+		heads[i] = 0;
+		sizes[i] = 0;
+	}
+}
+
+template<class T, class Alloc>
+inline void TMultyQueue<T, Alloc>::AllocateLike(const TMultyQueue& other)
+{
+	data = AllocateRaw(allocator, other.capacity);
+	capacity = other.capacity;
+	AllocateIndices(other.count);
+	for (size_t i = 0; i < count; ++i)
+		queuesBegin[i] = other.queuesBegin[i];
+}
+
+template<class T, class Alloc>
+inline void TMultyQueue<T, Alloc>::CopyFrom(const TMultyQueue& other)
+{
+	AllocateLike(other);
+	for (size_t i = 0; i < count; ++i)
+		for (size_t j = 0; j < other.sizes[i]; ++j)
+		{
+			new (data + queuesBegin[i] + j) T(*other.Slot(i, j));
+			sizes[i]++;
+		}
+}
+
+template<class T, class Alloc>
+inline void TMultyQueue<T, Alloc>::MoveFrom(TMultyQueue& other)
+{
+	AllocateLike(other);
+	for (size_t i = 0; i < count; ++i)
+		for (size_t j = 0; j < other.sizes[i]; ++j)
+		{
+			new (data + queuesBegin[i] + j) T(std::move(*other.Slot(i, j)));
+			sizes[i]++;
+		}
+	other.Release();
+}
+
+template<class T, class Alloc>
+inline void TMultyQueue<T, Alloc>::Release()
+{
+	if constexpr (!std::is_trivially_destructible<T>::value)
+		for (size_t i = 0; i < count; ++i)
+			for (size_t j = 0; j < sizes[i]; ++j)
+				Slot(i, j)->~T();
+	DeallocateRaw(allocator, data, capacity);
+	DeallocateRaw(indexAllocator, queuesBegin, 3 * count);
+	data = nullptr;
+	queuesBegin = nullptr;
+	heads = nullptr;
+	sizes = nullptr;
+	capacity = 0;
+	count = 0;
+}
+
+template<class T, class Alloc>
+inline TMultyQueue<T, Alloc>::TMultyQueue():capacity(0),count(0)
+{
+	data = nullptr;
+	queuesBegin = nullptr;
+	heads = nullptr;
+	sizes = nullptr;
+}
+
+template<class T, class Alloc>
+inline TMultyQueue<T, Alloc>::TMultyQueue(size_t count_, size_t size, const Alloc& allocator_):capacity(0),count(0),allocator(allocator_),indexAllocator(allocator_)
+{
+	data = nullptr;
+	queuesBegin = nullptr;
+	heads = nullptr;
+	sizes = nullptr;
+	if (count_ * size == 0)
+		return;
+	data = AllocateRaw(allocator, count_ * size);
+	capacity = count_ * size;
+	try
+	{
+		AllocateIndices(count_);
+	}
+	catch (...)
+	{
+		Release();
+		throw;
+	}
+	for (size_t i = 0; i < count; ++i)
+		queuesBegin[i] = i * size;
+}
+
+template<class T, class Alloc>
+inline TMultyQueue<T, Alloc>::TMultyQueue(const TMultyQueue& other):capacity(0),count(0),
+	allocator(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.allocator)),
+	indexAllocator(std::allocator_traits<TIndexAlloc>::select_on_container_copy_construction(other.indexAllocator))
+{
+	data = nullptr;
+	queuesBegin = nullptr;
+	heads = nullptr;
+	sizes = nullptr;
+	try
+	{
+		CopyFrom(other);
+	}
+	catch (...)
+	{
+		Release();
+		throw;
+	}
+}
+
+template<class T, class Alloc>
+inline TMultyQueue<T, Alloc>::TMultyQueue(TMultyQueue&& other) noexcept:allocator(std::move(other.allocator)),indexAllocator(std::move(other.indexAllocator))
+{
+	data = other.data;
+	queuesBegin = other.queuesBegin;
+	heads = other.heads;
+	sizes = other.sizes;
+	capacity = other.capacity;
+	count = other.count;
+	other.data = nullptr;
+	other.queuesBegin = nullptr;
+	other.heads = nullptr;
+	other.sizes = nullptr;
+	other.capacity = 0;
+	other.count = 0;
+}
+
+template<class T, class Alloc>
+inline TMultyQueue<T, Alloc>::~TMultyQueue()
+{
+	Release();
+}
+
+template<class T, class Alloc>
+inline bool TMultyQueue<T, Alloc>::operator==(const TMultyQueue& other) const
+{
+	if (count != other.count || capacity != other.capacity)
+		return false;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (sizes[i] != other.sizes[i] || queuesBegin[i] != other.queuesBegin[i])
+			return false;
+		for (size_t j = 0; j < sizes[i]; ++j)
+			if (*Slot(i, j) != *other.Slot(i, j))
+				return false;
+	}
+	return true;
+}
+
+template<class T, class Alloc>
+inline bool TMultyQueue<T, Alloc>::operator!=(const TMultyQueue& other) const
+{
+	return !(*this == other);
+}
+
+template<class T, class Alloc>
+inline T& TMultyQueue<T, Alloc>::operator()(size_t queuepos, size_t pos)
+{
+	if (queuepos >= count)
+		ERROR("stacks_error");
+	if (pos >= sizes[queuepos])
+		ERROR("size_error");
+	return *Slot(queuepos, pos);
+}
+
+template<class T, class Alloc>
+inline const T& TMultyQueue<T, Alloc>::operator()(size_t queuepos, size_t pos) const
+{
+	if (queuepos >= count)
+		ERROR("stacks_error");
+	if (pos >= sizes[queuepos])
+		ERROR("size_error");
+	return *Slot(queuepos, pos);
+}
+
+template<class T, class Alloc>
+inline TMultyQueue<T, Alloc>& TMultyQueue<T, Alloc>::operator=(const TMultyQueue<T, Alloc>& other)
+{
+	if (this != &other)
+	{
+		TMultyQueue<T, Alloc> copy(other);
+		*this = std::move(copy);
+	}
+	return *this;
+}
+
+template<class T, class Alloc>
+inline TMultyQueue<T, Alloc>& TMultyQueue<T, Alloc>::operator=(TMultyQueue<T, Alloc>&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+	Release();
+	if constexpr (!std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
+	{
+		if (!(allocator == other.allocator))
+		{
+			MoveFrom(other);
+			return *this;
+		}
+	}
+	else
+	{
+		allocator = std::move(other.allocator);
+		indexAllocator = std::move(other.indexAllocator);
+	}
+	data = other.data;
+	queuesBegin = other.queuesBegin;
+	heads = other.heads;
+	sizes = other.sizes;
+	count = other.count;
+	capacity = other.capacity;
+	other.data = nullptr;
+	other.queuesBegin = nullptr;
+	other.heads = nullptr;
+	other.sizes = nullptr;
+	other.capacity = 0;
+	other.count = 0;
+	return *this;
+}
+
+template<class T, class Alloc>
+inline size_t TMultyQueue<T, Alloc>::Capacity() const
+{
+	return capacity;
+}
+
+template<class T, class Alloc>
+inline size_t TMultyQueue<T, Alloc>::Count() const
+{
+	return count;
+}
+
+template<class T, class Alloc>
+inline Alloc TMultyQueue<T, Alloc>::GetAllocator() const
+{
+	return allocator;
+}
+
+template<class T, class Alloc>
+inline size_t TMultyQueue<T, Alloc>::Size(size_t queuepos) const
+{
+	if (queuepos >= count)
+		ERROR("stack_error");
+	return sizes[queuepos];
+}
+
+template<class T, class Alloc>
+inline bool TMultyQueue<T, Alloc>::IsFull(size_t queuepos) const
+{
+	if (queuepos >= count)
+		ERROR("stack_error");
+	return sizes[queuepos] == Length(queuepos);
+}
+
+template<class T, class Alloc>
+inline bool TMultyQueue<T, Alloc>::IsEmpty(size_t queuepos) const
+{
+	if (queuepos >= count)
+		ERROR("stack_error");
+	return sizes[queuepos] == 0;
+}
+
+template<class T, class Alloc>
+inline void TMultyQueue<T, Alloc>::Put(size_t queuepos, const T& elem)
+{
+	Emplace(queuepos, elem);
+}
+
+template<class T, class Alloc>
+inline void TMultyQueue<T, Alloc>::Put(size_t queuepos, T&& elem)
+{
+	Emplace(queuepos, std::move(elem));
+}
+
+// A full queue builds the element before repacking, since the arguments may refer into the buffer.
+template<class T, class Alloc>
+template<class... Args>
+inline T& TMultyQueue<T, Alloc>::Emplace(size_t queuepos, Args&&... args)
+{
+	if (this->IsFull(queuepos))
+	{
+		T elem(std::forward<Args>(args)...);
+		this->Repack(queuepos);
+		T* slot = new (Slot(queuepos, sizes[queuepos])) T(std::move(elem));
+		sizes[queuepos]++;
+		return *slot;
+	}
+	T* slot = new (Slot(queuepos, sizes[queuepos])) T(std::forward<Args>(args)...);
+	sizes[queuepos]++;
+	return *slot;
+}
+
+template<class T, class Alloc>
+inline T TMultyQueue<T, Alloc>::Get(size_t queuepos)
+{
+	if (this->IsEmpty(queuepos))
+		ERROR("empty_stack");
+	T* slot = Slot(queuepos, 0);
+	T elem(std::move(*slot));
+	slot->~T();
+	sizes[queuepos]--;
+	heads[queuepos] = sizes[queuepos] == 0 ? 0 : (heads[queuepos] + 1) % Length(queuepos);
+	return elem;
+}
+
+template<class T, class Alloc>
+inline T& TMultyQueue<T, Alloc>::Head(size_t queuepos)
+{
+	if (this->IsEmpty(queuepos))
+		ERROR("empty_stack");
+	return *Slot(queuepos, 0);
+}
+
+template<class T, class Alloc>
+inline const T& TMultyQueue<T, Alloc>::Head(size_t queuepos) const
+{
+	if (this->IsEmpty(queuepos))
+		ERROR("empty_stack");
+	return *Slot(queuepos, 0);
+}
+
+template<class T, class Alloc>
+inline T& TMultyQueue<T, Alloc>::Tail(size_t queuepos)
+{
+	if (this->IsEmpty(queuepos))
+		ERROR("empty_stack");
+	return *Slot(queuepos, sizes[queuepos] - 1);
+}
+
+template<class T, class Alloc>
+inline const T& TMultyQueue<T, Alloc>::Tail(size_t queuepos) const
+{
+	if (this->IsEmpty(queuepos))
+		ERROR("empty_stack");
+	return *Slot(queuepos, sizes[queuepos] - 1);
+}
+
+template<class O, class A>
+std::ostream& operator<<(std::ostream& os, const TMultyQueue<O, A>& queue)
+{
+	os << "{";
+	for (size_t i = 0; i < queue.Count(); ++i) {
+		os << "[";
+		for (size_t j = 0; j < queue.Size(i); ++j) {
+			os << queue(i, j);
+			if (j < queue.Size(i) - 1) {
+				os << ",";
+			}
+		}
+		os << "]";
+		if (i < queue.Count() - 1) {
+			os << ",";
+		}
+	}
+	os << "}\n";
+	return os;
+}
+
+template<class I, class A>
+std::istream& operator>>(std::istream& is, TMultyQueue<I, A>& queue)
+{
+	size_t queue_count, queue_size;
+	is >> queue_count >> queue_size;
+	TMultyQueue<I, A> temp(queue_count, queue_size, queue.GetAllocator());
+	for (size_t i = 0; i < queue_count; ++i) {
+		size_t element_count;
+		is >> element_count;
+
+		for (size_t j = 0; j < element_count; ++j) {
+			I element;
+			is >> element;
+			temp.Put(i, element);
+		}
+	}
+	queue = std::move(temp);
+	return is;
+}
+
+template<class T, class Alloc>
+inline T TMultyQueue<T, Alloc>::FindMin() const
+{
+	if (capacity == 0 || count == 0)
+		ERROR("empty_stack");
+
+	bool found = false;
+	T minElem;
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (size_t j = 0; j < sizes[i]; ++j)
+		{
+			const T& elem = *Slot(i, j);
+			if (!found || elem < minElem)
+			{
+				minElem = elem;
+				found = true;
+			}
+		}
+	}
+
+	if (!found)
+		ERROR("all_stacks_empty");
+	return minElem;
+}
+
+// Every queue is written head first, so a loaded queue starts unrolled at the beginning of its segment.
+template<class T, class Alloc>
+inline void TMultyQueue<T, Alloc>::SaveToFile(const std::string& filename) const
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SaveToFile stores elements as raw bytes");
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open())
+		ERROR("cannot_open_file");
+	file.write(reinterpret_cast<const char*>(&capacity), sizeof(capacity));
+	file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+	if (count > 0)
+	{
+		file.write(reinterpret_cast<const char*>(queuesBegin), count * sizeof(size_t));
+		file.write(reinterpret_cast<const char*>(sizes), count * sizeof(size_t));
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		size_t first = Length(i) - heads[i] < sizes[i] ? Length(i) - heads[i] : sizes[i];
+		file.write(reinterpret_cast<const char*>(Slot(i, 0)), first * sizeof(T));
+		if (first < sizes[i])
+			file.write(reinterpret_cast<const char*>(Slot(i, first)), (sizes[i] - first) * sizeof(T));
+	}
+
+	file.close();
+}
+
+// The segments must follow each other and hold their queues, and the file must end right after the
+// last element; the free slots may not exceed binaryMaxReserve. Nothing changes unless it all checks out.
+template<class T, class Alloc>
+inline void TMultyQueue<T, Alloc>::LoadFromFile(const std::string& filename)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "LoadFromFile reads elements as raw bytes");
+	std::ifstream file(filename, std::ios::binary);
+	if (!file.is_open())
+		ERROR("cannot_open_file");
+	file.seekg(0, std::ios::end);
+	uint64_t left = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	size_t fileCapacity = 0, fileCount = 0;
+	if (left < 2 * sizeof(size_t) || !file.read(reinterpret_cast<char*>(&fileCapacity), sizeof(fileCapacity)) || !file.read(reinterpret_cast<char*>(&fileCount), sizeof(fileCount)))
+		ERROR("format_error");
+	left -= 2 * sizeof(size_t);
+	if (fileCount > left / (2 * sizeof(size_t)) || (fileCount == 0) != (fileCapacity == 0))
+		ERROR("format_error");
+	left -= fileCount * 2 * sizeof(size_t);
+
+	TMultyQueue loaded(0, 0, allocator);
+	if (fileCount == 0)
+	{
+		*this = std::move(loaded);
+		return;
+	}
+	std::vector<size_t> index(2 * fileCount);
+	if (!file.read(reinterpret_cast<char*>(index.data()), index.size() * sizeof(size_t)))
+		ERROR("format_error");
+	const size_t* begins = index.data();
+	const size_t* lengths = begins + fileCount;
+	uint64_t total = 0;
+	for (size_t i = 0; i < fileCount; ++i)
+	{
+		size_t end = i + 1 < fileCount ? begins[i + 1] : fileCapacity;
+		if (begins[i] > end || lengths[i] > end - begins[i])
+			ERROR("format_error");
+		total += lengths[i];
+	}
+	if (left != total * sizeof(T) || fileCapacity - total > binaryMaxReserve / sizeof(T))
+		ERROR("format_error");
+
+	loaded.data = AllocateRaw(loaded.allocator, fileCapacity);
+	loaded.capacity = fileCapacity;
+	loaded.AllocateIndices(fileCount);
+	for (size_t i = 0; i < fileCount; ++i)
+		loaded.queuesBegin[i] = begins[i];
+	for (size_t i = 0; i < fileCount; ++i)
+	{
+		if (!file.read(reinterpret_cast<char*>(loaded.data + begins[i]), lengths[i] * sizeof(T)))
+			ERROR("format_error");
+		loaded.sizes[i] = lengths[i];
+	}
+	*this = std::move(loaded);
+
+	file.close();
+}
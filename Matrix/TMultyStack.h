@@ -1,53 +1,277 @@
 #pragma once
 
 #include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <vector>
 #include "TError.h"
+#include "TBlockOps.h"
+#include "TBinaryFormat.h"
 #define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
 
 
+template<class T, class = void>
+struct THasLess : std::false_type {};
+
 template<class T>
+struct THasLess<T, std::void_t<decltype(std::declval<T&>() < std::declval<T&>())>> : std::true_type {};
+
+
+// File layout written by TMultyStack (version 2): this header, then the index section and then the data
+// section starting at dataOffset, a multiple of binaryAlignment. The index holds stacksBegin and starts of
+// every stack as uint64_t, followed in a delta by rangeCount (stack, first, last) triples. headerChecksum
+// covers the fields before it.
+//  - dense ("TMSTACK"): all capacity slots, zeros outside the stacks;
+//  - sparse ("TMSPARS"): only the stack contents, back to back;
+//  - delta ("TMSDELT"): slots [first, last) of the listed stacks, counted from each stack's start, that
+//    changed since snapshot sequence - 1 of the same chain.
+struct TMultyStackHeader
+{
+	enum TKind { dense, sparse, delta };
+	static const uint32_t currentVersion = 2;
+
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t elemSize;
+	uint32_t elemAlign;
+	uint64_t capacity;
+	uint64_t count;
+	uint64_t chain;
+	uint64_t sequence;
+	uint64_t rangeCount;
+	uint64_t indexOffset;
+	uint64_t dataOffset;
+	uint64_t fileSize;
+	uint64_t indexChecksum;
+	uint64_t dataChecksum;
+	uint64_t headerChecksum;
+
+	void Init(TKind kind, size_t elemSize_, size_t elemAlign_, size_t capacity_, size_t count_, size_t slots, size_t rangeCount_ = 0);
+	TKind Kind() const;
+	uint64_t IndexWords() const;
+	uint64_t Slots() const;
+	uint64_t OwnChecksum() const;
+	void Check(size_t elemSize_, size_t elemAlign_, uint64_t size) const;
+	void CheckIndex(const uint64_t* index) const;
+	void Read(std::istream& is, size_t elemSize_, size_t elemAlign_, std::vector<uint64_t>& index);
+};
+
+inline void TMultyStackHeader::Init(TKind kind, size_t elemSize_, size_t elemAlign_, size_t capacity_, size_t count_, size_t slots, size_t rangeCount_)
+{
+	memcpy(magic, kind == dense ? "TMSTACK" : kind == sparse ? "TMSPARS" : "TMSDELT", 8);
+	version = currentVersion;
+	byteOrder = binaryByteOrder;
+	elemSize = static_cast<uint32_t>(elemSize_);
+	elemAlign = static_cast<uint32_t>(elemAlign_);
+	capacity = capacity_;
+	count = count_;
+	chain = 0;
+	sequence = 0;
+	rangeCount = rangeCount_;
+	indexOffset = sizeof(TMultyStackHeader);
+	dataOffset = AlignUp(indexOffset + IndexWords() * sizeof(uint64_t));
+	fileSize = dataOffset + slots * elemSize;
+	indexChecksum = 0;
+	dataChecksum = 0;
+	headerChecksum = 0;
+}
+
+inline TMultyStackHeader::TKind TMultyStackHeader::Kind() const
+{
+	if (memcmp(magic, "TMSTACK", 8) == 0)
+		return dense;
+	if (memcmp(magic, "TMSPARS", 8) == 0)
+		return sparse;
+	if (memcmp(magic, "TMSDELT", 8) == 0)
+		return delta;
+	ERROR("format_error");
+}
+
+inline uint64_t TMultyStackHeader::IndexWords() const
+{
+	return 2 * count + 3 * rangeCount;
+}
+
+inline uint64_t TMultyStackHeader::Slots() const
+{
+	return (fileSize - dataOffset) / elemSize;
+}
+
+inline uint64_t TMultyStackHeader::OwnChecksum() const
+{
+	return Checksum(this, offsetof(TMultyStackHeader, headerChecksum));
+}
+
+inline void TMultyStackHeader::Check(size_t elemSize_, size_t elemAlign_, uint64_t size) const
+{
+	TKind kind = Kind();
+	if (version != currentVersion || byteOrder != binaryByteOrder)
+		ERROR("format_error");
+	if (headerChecksum != OwnChecksum())
+		ERROR("checksum_error");
+	if (elemSize != elemSize_ || elemAlign != elemAlign_ || fileSize != size || indexOffset != sizeof(TMultyStackHeader))
+		ERROR("format_error");
+	if (count > (size - indexOffset) / (2 * sizeof(uint64_t)) || rangeCount > (size - indexOffset) / (3 * sizeof(uint64_t)) || (kind != delta && rangeCount != 0))
+		ERROR("format_error");
+	if (dataOffset != AlignUp(indexOffset + IndexWords() * sizeof(uint64_t)) || dataOffset > size || (size - dataOffset) % elemSize != 0)
+		ERROR("format_error");
+	if ((kind == dense && capacity != Slots()) || capacity > SIZE_MAX / elemSize || count > SIZE_MAX / (8 * sizeof(size_t)))
+		ERROR("format_error");
+}
+
+// Bounds must describe valid stacks, and a sparse file or a delta must hold exactly the slots they list.
+inline void TMultyStackHeader::CheckIndex(const uint64_t* index) const
+{
+	const uint64_t* begins = index;
+	const uint64_t* tops = index + count;
+	const uint64_t* ranges = index + 2 * count;
+	uint64_t slots = 0;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		if (begins[i] > tops[i] || tops[i] > (i + 1 < count ? begins[i + 1] : capacity))
+			ERROR("format_error");
+		slots += tops[i] - begins[i];
+	}
+	if (Kind() == delta)
+	{
+		slots = 0;
+		for (uint64_t r = 0; r < rangeCount; ++r)
+		{
+			uint64_t stack = ranges[3 * r], first = ranges[3 * r + 1], last = ranges[3 * r + 2];
+			if (stack >= count || (r > 0 && stack <= ranges[3 * r - 3]) || first >= last || last > tops[stack] - begins[stack])
+				ERROR("format_error");
+			slots += last - first;
+		}
+	}
+	if (Kind() != dense && slots != Slots())
+		ERROR("format_error");
+}
+
+// Reads and checks the header and the index section, leaving is at the start of the data section.
+inline void TMultyStackHeader::Read(std::istream& is, size_t elemSize_, size_t elemAlign_, std::vector<uint64_t>& index)
+{
+	is.seekg(0, std::ios::end);
+	uint64_t size = static_cast<uint64_t>(is.tellg());
+	is.seekg(0);
+	if (size < sizeof(TMultyStackHeader) || !is.read(reinterpret_cast<char*>(this), sizeof(TMultyStackHeader)))
+		ERROR("format_error");
+	Check(elemSize_, elemAlign_, size);
+	index.resize(IndexWords());
+	is.read(reinterpret_cast<char*>(index.data()), index.size() * sizeof(uint64_t));
+	if (!is || Checksum(index.data(), index.size() * sizeof(uint64_t)) != indexChecksum)
+		ERROR("checksum_error");
+	CheckIndex(index.data());
+	is.seekg(dataOffset);
+}
+
+// When T has operator<, every slot also records where the minimum of its stack up to that slot is,
+// and a tournament tree over the stacks keeps the global minimum. A stack whose elements were reached
+// through a non-const Top or operator() is rescanned on the next minimum query.
+// Each stack also keeps the range of offsets written since the last checkpoint or delta, so that
+// SaveDelta can store just those slots.
+template<class T, class Alloc = std::allocator<T>>
 class TMultyStack
 {
 protected:
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<size_t> TIndexAlloc;
+	static const bool tracksMin = THasLess<T>::value;
+
 	size_t capacity;
 	size_t count;
 	T* data;
 	size_t* stacksBegin;
 	size_t* starts;
+	size_t* pushes;
+	size_t* stale;
+	size_t* tree;
+	size_t* dirty;
+	size_t* minPos;
+	mutable bool hasStale;
+	bool adaptive;
+	uint64_t snapshotChain;
+	uint64_t snapshotSequence;
+	Alloc allocator;
+	TIndexAlloc indexAllocator;
 	void Repack(size_t stackpos);
+	void Rebalance(size_t stackpos, size_t need);
+	void Shift(size_t dst, size_t src);
+	size_t FreeSlots() const;
+	size_t MinSlot(size_t stackpos) const;
+	size_t Better(size_t a, size_t b) const;
+	void TrackPush(size_t stackpos, size_t n);
+	template<class... Args>
+	T& Construct(size_t stackpos, Args&&... args);
+	void UpdateTree(size_t stackpos) const;
+	void MarkStale(size_t stackpos);
+	void RefreshMins() const;
+	void MarkDirty(size_t stackpos, size_t first, size_t last);
+	void MarkClean();
+	void WriteSnapshot(const std::string& filename, TMultyStackHeader& header, const std::vector<uint64_t>& index, const std::vector<uint64_t>& spans) const;
+	void AllocateData(size_t capacity_);
+	void AllocateIndices(size_t count_);
+	void AllocateLike(const TMultyStack& other);
+	void CopyFrom(const TMultyStack& other);
+	void MoveFrom(TMultyStack& other);
+	void Release();
 public:
 	TMultyStack();
-	TMultyStack(size_t count_, size_t size);
+	TMultyStack(size_t count_, size_t size, const Alloc& allocator_ = Alloc());
+	TMultyStack(const std::vector<size_t>& capacities, const Alloc& allocator_ = Alloc());
+	TMultyStack(size_t capacity_, const std::vector<double>& weights, const Alloc& allocator_ = Alloc());
 	TMultyStack(const TMultyStack& other);
 	TMultyStack(TMultyStack&& other) noexcept;
 	~TMultyStack();
 
 	bool operator==(const TMultyStack& other);
 	bool operator!=(const TMultyStack& other);
-	T operator()(size_t stackpos, size_t pos)  const;
+	T& operator()(size_t stackpos, size_t pos);
+	const T& operator()(size_t stackpos, size_t pos) const;
 	TMultyStack& operator=(const TMultyStack& other);
 	TMultyStack& operator=(TMultyStack&& other) noexcept;
 
 	size_t Capacity() const;
 	size_t Count() const;
+	size_t Capacity(size_t stackpos) const;
+	Alloc GetAllocator() const;
+	bool IsAdaptive() const;
+	void SetAdaptive(bool adaptive_);
 	size_t Size(size_t stackpos) const;
 	bool IsFull(size_t stackpos) const;
 	bool IsEmpty(size_t stackpos) const;
 	void Push(size_t stackpos, const T& elem);
+	void Push(size_t stackpos, T&& elem);
+	template<class... Args>
+	T& Emplace(size_t stackpos, Args&&... args);
+	template<class It>
+	void PushRange(size_t stackpos, It first, It last);
+	void Transfer(size_t from, size_t to, size_t k);
+	void Reserve(size_t stackpos, size_t n);
 	T Pop(size_t stackpos);
+	T& Top(size_t stackpos);
+	const T& Top(size_t stackpos) const;
+	T Min(size_t stackpos) const;
 	T FindMin() const;
-	void SaveToFile(const std::string& filename) const;
+	void SaveToFile(const std::string& filename, bool sparse = false) const;
 	void LoadFromFile(const std::string& filename);
+	void SaveCheckpoint(const std::string& filename, bool sparse = false);
+	void SaveDelta(const std::string& filename);
+	bool ApplyDelta(const std::string& filename);
 
-	template<class O>
-	friend std::ostream& operator<<(std::ostream& os, const TMultyStack<O>& stack);
-	template<class I>
-	friend std::istream& operator>>(std::istream& is, TMultyStack<I>& stack);
+	template<class O, class A>
+	friend std::ostream& operator<<(std::ostream& os, const TMultyStack<O, A>& stack);
+	template<class I, class A>
+	friend std::istream& operator>>(std::istream& is, TMultyStack<I, A>& stack);
 };
 
-template<class T>
-inline void TMultyStack<T>::Repack(size_t stackpos)
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::Repack(size_t stackpos)
 {
 	if (stackpos >= count)
 		ERROR("stack_error");
@@ -60,50 +284,340 @@ inline void TMultyStack<T>::Repack(size_t stackpos)
 		}
 	if (posFirstNoFull == count)
 		ERROR("no_empty_stacks");
+	if (adaptive)
+	{
+		Rebalance(stackpos, 1);
+		return;
+	}
 	if (posFirstNoFull < stackpos)
 	{
-		for (size_t i = stacksBegin[posFirstNoFull + 1]; i < starts[stackpos]; ++i)
-			data[i - 1] = std::move(data[i]);
 		for (size_t i = posFirstNoFull + 1; i <= stackpos; ++i)
 		{
+			for (size_t j = stacksBegin[i]; j < starts[i]; ++j)
+				Shift(j - 1, j);
 			stacksBegin[i]-=1;
 			starts[i]-=1;
 		}
 	}
 	else
 	{
-		for (size_t i = starts[posFirstNoFull]-1; i >= stacksBegin[stackpos + 1]; --i)
-			data[i+1] = std::move(data[i]);
-		for (size_t i = stackpos + 1; i <= posFirstNoFull; ++i)
+		for (size_t i = posFirstNoFull; i > stackpos; --i)
 		{
+			for (size_t j = starts[i]; j > stacksBegin[i]; --j)
+				Shift(j, j - 1);
 			stacksBegin[i]+=1;
 			starts[i]+=1;
 		}
 	}
 }
 
-template<class T>
-inline TMultyStack<T>::TMultyStack():capacity(0),count(0)
+// Lays all segments out again with at least need free slots in stackpos. In adaptive mode a tenth of the
+// remaining free slots is shared evenly and the rest follows the pushes seen since the last repack.
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::Rebalance(size_t stackpos, size_t need)
+{
+	size_t total = 0, demand = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		total += starts[i] - stacksBegin[i];
+		demand += pushes[i];
+	}
+	if (demand == 0)
+		demand = 1;
+	size_t spare = capacity - total - need;
+	size_t even = adaptive ? spare / 10 / count : spare / count;
+	size_t growth = spare - even * count;
+	size_t given = 0;
+	for (size_t i = 0; i < count; ++i)
+		given += even + growth * pushes[i] / demand;
+
+	size_t* begins = AllocateRaw(indexAllocator, count);
+	for (size_t i = 0, begin = 0; i < count; ++i)
+	{
+		begins[i] = begin;
+		begin += starts[i] - stacksBegin[i] + even + growth * pushes[i] / demand;
+		if (i == stackpos)
+			begin += need + spare - given;
+	}
+	for (size_t i = 0; i < count; ++i)
+		if (begins[i] < stacksBegin[i])
+		{
+			for (size_t j = stacksBegin[i]; j < starts[i]; ++j)
+				Shift(j - (stacksBegin[i] - begins[i]), j);
+			starts[i] -= stacksBegin[i] - begins[i];
+			stacksBegin[i] = begins[i];
+		}
+	for (size_t i = count; i > 0; --i)
+		if (begins[i - 1] > stacksBegin[i - 1])
+		{
+			for (size_t j = starts[i - 1]; j > stacksBegin[i - 1]; --j)
+				Shift(j - 1 + (begins[i - 1] - stacksBegin[i - 1]), j - 1);
+			starts[i - 1] += begins[i - 1] - stacksBegin[i - 1];
+			stacksBegin[i - 1] = begins[i - 1];
+		}
+	DeallocateRaw(indexAllocator, begins, count);
+	for (size_t i = 0; i < count; ++i)
+		pushes[i] = 0;
+}
+
+template<class T, class Alloc>
+inline size_t TMultyStack<T, Alloc>::FreeSlots() const
+{
+	size_t total = 0;
+	for (size_t i = 0; i < count; ++i)
+		total += starts[i] - stacksBegin[i];
+	return capacity - total;
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::Shift(size_t dst, size_t src)
+{
+	Relocate(data + dst, data + src);
+	if constexpr (tracksMin)
+		minPos[dst] = minPos[src];
+}
+
+// Slot of the smallest element of a non-empty stack; minPos holds positions relative to the stack's start, so it survives repacks.
+template<class T, class Alloc>
+inline size_t TMultyStack<T, Alloc>::MinSlot(size_t stackpos) const
+{
+	return stacksBegin[stackpos] + minPos[starts[stackpos] - 1];
+}
+
+template<class T, class Alloc>
+inline size_t TMultyStack<T, Alloc>::Better(size_t a, size_t b) const
 {
+	if (starts[a] == stacksBegin[a])
+		return b;
+	if (starts[b] == stacksBegin[b])
+		return a;
+	return data[MinSlot(b)] < data[MinSlot(a)] ? b : a;
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::TrackPush(size_t stackpos, size_t n)
+{
+	MarkDirty(stackpos, Size(stackpos) - n, Size(stackpos));
+	if constexpr (tracksMin)
+	{
+		if (stale[stackpos])
+			return;
+		size_t begin = stacksBegin[stackpos];
+		for (size_t j = starts[stackpos] - n; j < starts[stackpos]; ++j)
+			minPos[j] = j == begin || data[j] < data[begin + minPos[j - 1]] ? j - begin : minPos[j - 1];
+		UpdateTree(stackpos);
+	}
+}
+
+// Stacks are the leaves of an implicit tree of 2 * count nodes; every inner node keeps the better of its children.
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::UpdateTree(size_t stackpos) const
+{
+	if constexpr (tracksMin)
+	{
+		if (hasStale)
+			return;
+		for (size_t node = (count + stackpos) / 2; node > 0; node /= 2)
+			tree[node] = Better(tree[2 * node], tree[2 * node + 1]);
+	}
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::MarkStale(size_t stackpos)
+{
+	stale[stackpos] = 1;
+	hasStale = true;
+}
+
+// Dirty offsets count from the stack's start, so repacks, which move whole stacks, leave them valid.
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::MarkDirty(size_t stackpos, size_t first, size_t last)
+{
+	if (first < dirty[stackpos])
+		dirty[stackpos] = first;
+	if (last > dirty[count + stackpos])
+		dirty[count + stackpos] = last;
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::MarkClean()
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		dirty[i] = SIZE_MAX;
+		dirty[count + i] = 0;
+	}
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::RefreshMins() const
+{
+	if (!hasStale)
+		return;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (stale[i])
+		{
+			size_t begin = stacksBegin[i];
+			for (size_t j = begin; j < starts[i]; ++j)
+				minPos[j] = j == begin || data[j] < data[begin + minPos[j - 1]] ? j - begin : minPos[j - 1];
+			stale[i] = 0;
+		}
+		tree[count + i] = i;
+	}
+	for (size_t node = count; node > 1; --node)
+		tree[node - 1] = Better(tree[2 * node - 2], tree[2 * node - 1]);
+	hasStale = false;
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::AllocateData(size_t capacity_)
+{
+	data = AllocateRaw(allocator, capacity_);
+	if constexpr (tracksMin)
+	{
+		try
+		{
+			minPos = AllocateRaw(indexAllocator, capacity_);
+		}
+		catch (...)
+		{
+			DeallocateRaw(allocator, data, capacity_);
+			data = nullptr;
+			throw;
+		}
+	}
+	capacity = capacity_;
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::AllocateIndices(size_t count_)
+{
+	if (count_ == 0)
+		return;
+	stacksBegin = AllocateRaw(indexAllocator, 8 * count_);
+	starts = stacksBegin + count_;
+	pushes = starts + count_;
+	stale = pushes + count_;
+	tree = stale + count_;
+	dirty = tree + 2 * count_;
+	count = count_;
+	for (size_t i = 0; i < count; ++i)
+	{
+		pushes[i] = 0;
+		stale[i] = 1;
+		dirty[i] = 0;
+		dirty[count + i] = SIZE_MAX;
+	}
+	hasStale = true;
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::AllocateLike(const TMultyStack& other)
+{
+	AllocateData(other.capacity);
+	AllocateIndices(other.count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		stacksBegin[i] = other.stacksBegin[i];
+		starts[i] = other.stacksBegin[i];
+		pushes[i] = other.pushes[i];
+	}
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::CopyFrom(const TMultyStack& other)
+{
+	AllocateLike(other);
+	for (size_t i = 0; i < count; ++i)
+	{
+		UninitializedCopy(data + stacksBegin[i], other.data + other.stacksBegin[i], other.Size(i));
+		starts[i] = other.starts[i];
+	}
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::MoveFrom(TMultyStack& other)
+{
+	AllocateLike(other);
+	for (size_t i = 0; i < count; ++i)
+	{
+		UninitializedMove(data + stacksBegin[i], other.data + other.stacksBegin[i], other.Size(i));
+		starts[i] = other.starts[i];
+		dirty[i] = other.dirty[i];
+		dirty[count + i] = other.dirty[count + i];
+	}
+	snapshotChain = other.snapshotChain;
+	snapshotSequence = other.snapshotSequence;
+	other.Release();
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::Release()
+{
+	for (size_t i = 0; i < count; ++i)
+		DestroyRange(data + stacksBegin[i], starts[i] - stacksBegin[i]);
+	DeallocateRaw(allocator, data, capacity);
+	if constexpr (tracksMin)
+		DeallocateRaw(indexAllocator, minPos, capacity);
+	DeallocateRaw(indexAllocator, stacksBegin, 8 * count);
 	data = nullptr;
 	stacksBegin = nullptr;
 	starts = nullptr;
+	pushes = nullptr;
+	stale = nullptr;
+	tree = nullptr;
+	dirty = nullptr;
+	minPos = nullptr;
+	hasStale = false;
+	snapshotChain = 0;
+	snapshotSequence = 0;
+	capacity = 0;
+	count = 0;
 }
 
-template<class T>
-inline TMultyStack<T>::TMultyStack(size_t count_, size_t size):capacity(count_*size),count(count_)
+template<class T, class Alloc>
+inline TMultyStack<T, Alloc>::TMultyStack():capacity(0),count(0),adaptive(false)
 {
-	if (capacity == 0 || count == 0)
+	data = nullptr;
+	stacksBegin = nullptr;
+	starts = nullptr;
+	pushes = nullptr;
+	stale = nullptr;
+	tree = nullptr;
+	dirty = nullptr;
+	minPos = nullptr;
+	hasStale = false;
+	snapshotChain = 0;
+	snapshotSequence = 0;
+}
+
+template<class T, class Alloc>
+inline TMultyStack<T, Alloc>::TMultyStack(size_t count_, size_t size, const Alloc& allocator_):capacity(0),count(0),adaptive(false),allocator(allocator_),indexAllocator(allocator_)
+{
+	data = nullptr;
+	stacksBegin = nullptr;
+	starts = nullptr;
+	pushes = nullptr;
+	stale = nullptr;
+	tree = nullptr;
+	dirty = nullptr;
+	minPos = nullptr;
+	hasStale = false;
+	snapshotChain = 0;
+	snapshotSequence = 0;
+	if (count_ * size == 0)
+		return;
+	AllocateData(count_ * size);
+	try
+	{
+		AllocateIndices(count_);
+	}
+	catch (...)
 	{
-		capacity = 0;
-		count = 0;
-		data = nullptr;
-		stacksBegin = nullptr;
-		starts = nullptr;
+		Release();
+		throw;
 	}
-	data = new T[capacity];
-	stacksBegin = new size_t[count];
-	starts = new size_t[count];
 	for (size_t i = 0; i < count; ++i)
 	{
 		stacksBegin[i] = i * size;
@@ -111,51 +625,152 @@ inline TMultyStack<T>::TMultyStack(size_t count_, size_t size):capacity(count_*s
 	}
 }
 
-template<class T>
-inline TMultyStack<T>::TMultyStack(const TMultyStack& other):capacity(other.capacity),count(other.count)
+template<class T, class Alloc>
+inline TMultyStack<T, Alloc>::TMultyStack(const std::vector<size_t>& capacities, const Alloc& allocator_):capacity(0),count(0),adaptive(false),allocator(allocator_),indexAllocator(allocator_)
+{
+	data = nullptr;
+	stacksBegin = nullptr;
+	starts = nullptr;
+	pushes = nullptr;
+	stale = nullptr;
+	tree = nullptr;
+	dirty = nullptr;
+	minPos = nullptr;
+	hasStale = false;
+	snapshotChain = 0;
+	snapshotSequence = 0;
+	size_t total = 0;
+	for (size_t i = 0; i < capacities.size(); ++i)
+		total += capacities[i];
+	if (total == 0)
+		return;
+	AllocateData(total);
+	try
+	{
+		AllocateIndices(capacities.size());
+	}
+	catch (...)
+	{
+		Release();
+		throw;
+	}
+	for (size_t i = 0, begin = 0; i < count; ++i)
+	{
+		stacksBegin[i] = begin;
+		starts[i] = begin;
+		begin += capacities[i];
+	}
+}
+
+// Splits capacity_ between the stacks in proportion to their weights.
+template<class T, class Alloc>
+inline TMultyStack<T, Alloc>::TMultyStack(size_t capacity_, const std::vector<double>& weights, const Alloc& allocator_):capacity(0),count(0),adaptive(false),allocator(allocator_),indexAllocator(allocator_)
 {
-	data = new T[capacity];
-	stacksBegin = new size_t[count];
-	starts = new size_t[count];
-	for (size_t i = 0; i < capacity; ++i)
-		data[i] = other.data[i];
+	data = nullptr;
+	stacksBegin = nullptr;
+	starts = nullptr;
+	pushes = nullptr;
+	stale = nullptr;
+	tree = nullptr;
+	dirty = nullptr;
+	minPos = nullptr;
+	hasStale = false;
+	snapshotChain = 0;
+	snapshotSequence = 0;
+	double total = 0;
+	for (size_t i = 0; i < weights.size(); ++i)
+	{
+		if (!std::isfinite(weights[i]) || weights[i] < 0)
+			ERROR("size_error");
+		total += weights[i];
+	}
+	if (capacity_ == 0 || weights.empty())
+		return;
+	if (!std::isfinite(total) || total <= 0)
+		ERROR("size_error");
+	AllocateData(capacity_);
+	try
+	{
+		AllocateIndices(weights.size());
+	}
+	catch (...)
+	{
+		Release();
+		throw;
+	}
+	double prefix = 0;
 	for (size_t i = 0; i < count; ++i)
 	{
-		stacksBegin[i] = other.stacksBegin[i];
-		starts[i] = other.starts[i];
+		stacksBegin[i] = static_cast<size_t>(capacity * (prefix / total));
+		starts[i] = stacksBegin[i];
+		prefix += weights[i];
 	}
 }
 
-template<class T>
-inline TMultyStack<T>::TMultyStack(TMultyStack&& other) noexcept
+template<class T, class Alloc>
+inline TMultyStack<T, Alloc>::TMultyStack(const TMultyStack& other):capacity(0),count(0),adaptive(other.adaptive),
+	allocator(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.allocator)),
+	indexAllocator(std::allocator_traits<TIndexAlloc>::select_on_container_copy_construction(other.indexAllocator))
+{
+	data = nullptr;
+	stacksBegin = nullptr;
+	starts = nullptr;
+	pushes = nullptr;
+	stale = nullptr;
+	tree = nullptr;
+	dirty = nullptr;
+	minPos = nullptr;
+	hasStale = false;
+	snapshotChain = 0;
+	snapshotSequence = 0;
+	try
+	{
+		CopyFrom(other);
+	}
+	catch (...)
+	{
+		Release();
+		throw;
+	}
+}
+
+template<class T, class Alloc>
+inline TMultyStack<T, Alloc>::TMultyStack(TMultyStack&& other) noexcept:adaptive(other.adaptive),allocator(std::move(other.allocator)),indexAllocator(std::move(other.indexAllocator))
 {
 	data = other.data;
 	stacksBegin = other.stacksBegin;
 	starts = other.starts;
+	pushes = other.pushes;
+	stale = other.stale;
+	tree = other.tree;
+	dirty = other.dirty;
+	minPos = other.minPos;
+	hasStale = other.hasStale;
+	snapshotChain = other.snapshotChain;
+	snapshotSequence = other.snapshotSequence;
 	capacity = other.capacity;
 	count = other.count;
 	other.data = nullptr;
 	other.stacksBegin = nullptr;
 	other.starts = nullptr;
+	other.pushes = nullptr;
+	other.stale = nullptr;
+	other.tree = nullptr;
+	other.dirty = nullptr;
+	other.minPos = nullptr;
+	other.hasStale = false;
 	other.capacity = 0;
 	other.count = 0;
 }
 
-template<class T>
-inline TMultyStack<T>::~TMultyStack()
+template<class T, class Alloc>
+inline TMultyStack<T, Alloc>::~TMultyStack()
 {
-	if (capacity)
-	{
-		delete[] data;
-		delete[] starts;
-		delete[] stacksBegin;
-	}
-	capacity = 0;
-	count = 0;
+	Release();
 }
 
-template<class T>
-inline bool TMultyStack<T>::operator==(const TMultyStack& other)
+template<class T, class Alloc>
+inline bool TMultyStack<T, Alloc>::operator==(const TMultyStack& other)
 {
 	if (count != other.count || capacity != other.capacity)
 		return false;
@@ -163,144 +778,306 @@ inline bool TMultyStack<T>::operator==(const TMultyStack& other)
 	{
 		if (starts[i] != other.starts[i] || stacksBegin[i] != other.stacksBegin[i])
 			return false;
-		for (size_t j = stacksBegin[i]; j < starts[i]; ++j)
-			if (data[j] != other.data[j])
-				return false;
+		if (!BlockEqual(data + stacksBegin[i], other.data + stacksBegin[i], starts[i] - stacksBegin[i]))
+			return false;
 	}
 	return true;
 }
 
-template<class T>
-inline bool TMultyStack<T>::operator!=(const TMultyStack& other)
+template<class T, class Alloc>
+inline bool TMultyStack<T, Alloc>::operator!=(const TMultyStack& other)
 {
-	if (count != other.count || capacity != other.capacity)
-		return true;
-	for (size_t i = 0; i < count; ++i)
-	{
-		if (starts[i] != other.starts[i] || stacksBegin[i] != other.stacksBegin[i])
-			return true;
-		for (size_t j = stacksBegin[i]; j < starts[i]; ++j)
-			if (data[j] != other.data[j])
-				return true;
-	}
-	return false;
+	return !(*this == other);
 }
 
-template<class T>
-inline T TMultyStack<T>::operator()(size_t stackpos, size_t pos) const
+template<class T, class Alloc>
+inline T& TMultyStack<T, Alloc>::operator()(size_t stackpos, size_t pos)
 {
 	if (stackpos >= count)
 		ERROR("stacks_error");
 	if (pos >= this->Size(stackpos))
 		ERROR("size_error");
+	MarkStale(stackpos);
+	MarkDirty(stackpos, pos, pos + 1);
 	return data[stacksBegin[stackpos] + pos];
 }
 
-template<class T>
-inline TMultyStack<T>& TMultyStack<T>::operator=(const TMultyStack<T>& other)
+template<class T, class Alloc>
+inline const T& TMultyStack<T, Alloc>::operator()(size_t stackpos, size_t pos) const
+{
+	if (stackpos >= count)
+		ERROR("stacks_error");
+	if (pos >= this->Size(stackpos))
+		ERROR("size_error");
+	return data[stacksBegin[stackpos] + pos];
+}
+
+template<class T, class Alloc>
+inline TMultyStack<T, Alloc>& TMultyStack<T, Alloc>::operator=(const TMultyStack<T, Alloc>& other)
 {
 	if (this != &other)
 	{
-		if (data) delete[] data;
-		if (stacksBegin) delete[] stacksBegin;
-		if (starts) delete[] starts;
-		capacity = other.capacity;
-		count = other.count;
-		data = new T[capacity];
-		stacksBegin = new size_t[count];
-		starts = new size_t[count];
-		for (size_t i = 0; i < count; ++i)
-		{
-			stacksBegin[i] = other.stacksBegin[i];
-			starts[i] = other.starts[i];
-		}
-		for (size_t i = 0; i < capacity; ++i)
-		{
-			data[i] = other.data[i];
-		}
+		TMultyStack<T, Alloc> copy(other);
+		*this = std::move(copy);
 	}
 	return *this;
 }
 
-template<class T>
-inline TMultyStack<T>& TMultyStack<T>::operator=(TMultyStack<T>&& other) noexcept
+template<class T, class Alloc>
+inline TMultyStack<T, Alloc>& TMultyStack<T, Alloc>::operator=(TMultyStack<T, Alloc>&& other) noexcept
 {
-	if (*this != other)
+	if (this == &other)
+		return *this;
+	Release();
+	adaptive = other.adaptive;
+	if constexpr (!std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
 	{
-		data = other.data;
-		stacksBegin = other.stacksBegin;
-		starts = other.starts;
-		count = other.count;
-		capacity = other.capacity;
-		other.starts = nullptr;
-		other.data = nullptr;
-		other.stacksBegin = nullptr;
-		other.capacity = 0;
-		other.count = 0;
+		if (!(allocator == other.allocator))
+		{
+			MoveFrom(other);
+			return *this;
+		}
 	}
+	else
+	{
+		allocator = std::move(other.allocator);
+		indexAllocator = std::move(other.indexAllocator);
+	}
+	data = other.data;
+	stacksBegin = other.stacksBegin;
+	starts = other.starts;
+	pushes = other.pushes;
+	stale = other.stale;
+	tree = other.tree;
+	dirty = other.dirty;
+	minPos = other.minPos;
+	hasStale = other.hasStale;
+	snapshotChain = other.snapshotChain;
+	snapshotSequence = other.snapshotSequence;
+	count = other.count;
+	capacity = other.capacity;
+	other.starts = nullptr;
+	other.pushes = nullptr;
+	other.stale = nullptr;
+	other.tree = nullptr;
+	other.dirty = nullptr;
+	other.minPos = nullptr;
+	other.hasStale = false;
+	other.data = nullptr;
+	other.stacksBegin = nullptr;
+	other.capacity = 0;
+	other.count = 0;
 	return *this;
 }
 
-template<class T>
-inline size_t TMultyStack<T>::Capacity() const
+template<class T, class Alloc>
+inline size_t TMultyStack<T, Alloc>::Capacity() const
 {
 	return capacity;
 }
 
-template<class T>
-inline size_t TMultyStack<T>::Count() const
+template<class T, class Alloc>
+inline size_t TMultyStack<T, Alloc>::Count() const
 {
 	return count;
 }
 
-template<class T>
-inline size_t TMultyStack<T>::Size(size_t stackpos) const
+template<class T, class Alloc>
+inline size_t TMultyStack<T, Alloc>::Capacity(size_t stackpos) const
+{
+	if (stackpos >= count)
+		ERROR("stack_error");
+	return (stackpos + 1 < count ? stacksBegin[stackpos + 1] : capacity) - stacksBegin[stackpos];
+}
+
+template<class T, class Alloc>
+inline Alloc TMultyStack<T, Alloc>::GetAllocator() const
+{
+	return allocator;
+}
+
+template<class T, class Alloc>
+inline bool TMultyStack<T, Alloc>::IsAdaptive() const
+{
+	return adaptive;
+}
+
+// Push counts are kept either way, so switching adaptive mode on uses the demand already observed.
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::SetAdaptive(bool adaptive_)
+{
+	adaptive = adaptive_;
+}
+
+template<class T, class Alloc>
+inline size_t TMultyStack<T, Alloc>::Size(size_t stackpos) const
 {
 	if (stackpos >= count)
 		ERROR("stack_error");
 	return starts[stackpos] - stacksBegin[stackpos];
 }
 
-template<class T>
-inline bool TMultyStack<T>::IsFull(size_t stackpos) const
+template<class T, class Alloc>
+inline bool TMultyStack<T, Alloc>::IsFull(size_t stackpos) const
 {
 	if (stackpos >= count)
 		ERROR("stack_error");
 	return stackpos<count-1 && starts[stackpos]==stacksBegin[stackpos+1] || stackpos == count - 1 && capacity==starts[count-1];
 }
 
-template<class T>
-inline bool TMultyStack<T>::IsEmpty(size_t stackpos) const
+template<class T, class Alloc>
+inline bool TMultyStack<T, Alloc>::IsEmpty(size_t stackpos) const
 {
 	if (stackpos >= count)
 		ERROR("stack_error");
 	return starts[stackpos]==stacksBegin[stackpos];
 }
 
-template<class T>
-inline void TMultyStack<T>::Push(size_t stackpos, const T& elem)
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::Push(size_t stackpos, const T& elem)
+{
+	Construct(stackpos, elem);
+}
+
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::Push(size_t stackpos, T&& elem)
+{
+	Construct(stackpos, std::move(elem));
+}
+
+// When the stack is full the new element is built before the repack, since its arguments may refer into the container.
+template<class T, class Alloc>
+template<class... Args>
+inline T& TMultyStack<T, Alloc>::Construct(size_t stackpos, Args&&... args)
 {
 	if (stackpos >= count)
 		ERROR("stack_error");
+	pushes[stackpos]++;
+	T* slot;
 	if (this->IsFull(stackpos))
+	{
+		T elem(std::forward<Args>(args)...);
 		this->Repack(stackpos);
-	data[starts[stackpos]] = elem;
+		slot = new (data + starts[stackpos]) T(std::move(elem));
+	}
+	else
+		slot = new (data + starts[stackpos]) T(std::forward<Args>(args)...);
 	starts[stackpos]++;
+	TrackPush(stackpos, 1);
+	return *slot;
 }
 
-template<class T>
-inline T TMultyStack<T>::Pop(size_t stackpos)
+// The caller may write through the returned reference, so the stack's minimum is recomputed on demand, as after Top.
+template<class T, class Alloc>
+template<class... Args>
+inline T& TMultyStack<T, Alloc>::Emplace(size_t stackpos, Args&&... args)
+{
+	T& slot = Construct(stackpos, std::forward<Args>(args)...);
+	MarkStale(stackpos);
+	MarkDirty(stackpos, Size(stackpos) - 1, Size(stackpos));
+	return slot;
+}
+
+// The range must not point into this container, since making room may move its elements.
+template<class T, class Alloc>
+template<class It>
+inline void TMultyStack<T, Alloc>::PushRange(size_t stackpos, It first, It last)
+{
+	size_t n = static_cast<size_t>(std::distance(first, last));
+	Reserve(stackpos, n);
+	UninitializedCopyFrom(data + starts[stackpos], first, n);
+	starts[stackpos] += n;
+	TrackPush(stackpos, n);
+	pushes[stackpos] += n;
+}
+
+// Moves the top k elements of from onto to as one block, keeping their order, so the top of from becomes the top of to.
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::Transfer(size_t from, size_t to, size_t k)
+{
+	if (from >= count || to >= count)
+		ERROR("stack_error");
+	if (k > this->Size(from))
+		ERROR("size_error");
+	if (from == to || k == 0)
+		return;
+	if (Capacity(to) - this->Size(to) < k && FreeSlots() < k)
+	{
+		T* block = AllocateRaw(allocator, k);
+		RelocateRange(block, data + starts[from] - k, k);
+		starts[from] -= k;
+		try
+		{
+			Reserve(to, k);
+		}
+		catch (...)
+		{
+			// The failed repack moved nothing, so the parked elements still fit where they came from.
+			RelocateRange(data + starts[from], block, k);
+			starts[from] += k;
+			DeallocateRaw(allocator, block, k);
+			throw;
+		}
+		RelocateRange(data + starts[to], block, k);
+		DeallocateRaw(allocator, block, k);
+	}
+	else
+	{
+		Reserve(to, k);
+		RelocateRange(data + starts[to], data + starts[from] - k, k);
+		starts[from] -= k;
+	}
+	starts[to] += k;
+	pushes[to] += k;
+	TrackPush(to, k);
+	UpdateTree(from);
+}
+
+// Makes room for n more elements in stackpos with at most one repack.
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::Reserve(size_t stackpos, size_t n)
+{
+	if (Capacity(stackpos) - this->Size(stackpos) >= n)
+		return;
+	if (FreeSlots() < n)
+		ERROR("no_empty_stacks");
+	Rebalance(stackpos, n);
+}
+
+template<class T, class Alloc>
+inline T TMultyStack<T, Alloc>::Pop(size_t stackpos)
 {
 	if (stackpos >= count)
 		ERROR("stack_error");
 	if (this->IsEmpty(stackpos))
 		ERROR("empty_stack");
+	T elem(std::move(data[starts[stackpos] - 1]));
 	starts[stackpos]--;
-	return data[starts[stackpos]];
+	data[starts[stackpos]].~T();
+	UpdateTree(stackpos);
+	return elem;
+}
+
+template<class T, class Alloc>
+inline T& TMultyStack<T, Alloc>::Top(size_t stackpos)
+{
+	if (this->IsEmpty(stackpos))
+		ERROR("empty_stack");
+	MarkStale(stackpos);
+	MarkDirty(stackpos, Size(stackpos) - 1, Size(stackpos));
+	return data[starts[stackpos] - 1];
+}
+
+template<class T, class Alloc>
+inline const T& TMultyStack<T, Alloc>::Top(size_t stackpos) const
+{
+	if (this->IsEmpty(stackpos))
+		ERROR("empty_stack");
+	return data[starts[stackpos] - 1];
 }
 
-template<class O>
-std::ostream& operator<<(std::ostream& os, const TMultyStack<O>& stack)
+template<class O, class A>
+std::ostream& operator<<(std::ostream& os, const TMultyStack<O, A>& stack)
 {
 	os << "{";
 	for (size_t i = 0; i < stack.Count(); ++i) {
@@ -320,12 +1097,12 @@ std::ostream& operator<<(std::ostream& os, const TMultyStack<O>& stack)
 	return os;
 }
 
-template<class I>
-std::istream& operator>>(std::istream& is, TMultyStack<I>& stack)
+template<class I, class A>
+std::istream& operator>>(std::istream& is, TMultyStack<I, A>& stack)
 {
 	size_t stack_count, stack_size;
 	is >> stack_count >> stack_size;
-	TMultyStack<I> temp(stack_count, stack_size);
+	TMultyStack<I, A> temp(stack_count, stack_size, stack.GetAllocator());
 	for (size_t i = 0; i < stack_count; ++i) {
 		size_t element_count;
 		is >> element_count;
@@ -340,117 +1117,296 @@ std::istream& operator>>(std::istream& is, TMultyStack<I>& stack)
 	return is;
 }
 
-template<class T>
-inline T TMultyStack<T>::FindMin() const
+template<class T, class Alloc>
+inline T TMultyStack<T, Alloc>::Min(size_t stackpos) const
+{
+	if (this->IsEmpty(stackpos))
+		ERROR("empty_stack");
+	if (stale[stackpos])
+		RefreshMins();
+	return data[MinSlot(stackpos)];
+}
+
+template<class T, class Alloc>
+inline T TMultyStack<T, Alloc>::FindMin() const
 {
 	if (capacity == 0 || count == 0)
 		ERROR("empty_stack");
+	RefreshMins();
+	if (this->IsEmpty(tree[1]))
+		ERROR("all_stacks_empty");
+	return data[MinSlot(tree[1])];
+}
 
-	bool found = false;
-	T minElem;
-	for (size_t i = 0; i < count; ++i)
+// Writes the header, the index and the slots listed in spans as [first, last) pairs; a dense file also
+// gets zeros for every slot between them. The header goes first as a placeholder and is rewritten once
+// the data checksum is known.
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::WriteSnapshot(const std::string& filename, TMultyStackHeader& header, const std::vector<uint64_t>& index, const std::vector<uint64_t>& spans) const
+{
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open())
+		ERROR("cannot_open_file");
+	bool dense = header.Kind() == TMultyStackHeader::dense;
+	header.indexChecksum = Checksum(index.data(), index.size() * sizeof(uint64_t));
 	{
-		if (!this->IsEmpty(i))
+		TBinaryWriter writer(file);
+		writer.Write(&header, sizeof(header));
+		writer.Write(index.data(), index.size() * sizeof(uint64_t));
+		writer.WriteZeros(header.dataOffset - header.indexOffset - index.size() * sizeof(uint64_t));
+		TChecksum dataSum;
+		writer.Track(&dataSum);
+		uint64_t written = 0;
+		for (size_t i = 0; i < spans.size(); i += 2)
 		{
-			minElem = data[stacksBegin[i]];
-			found = true;
-			break;
+			if (dense)
+				writer.WriteZeros((spans[i] - written) * sizeof(T));
+			writer.Write(data + spans[i], (spans[i + 1] - spans[i]) * sizeof(T));
+			written = spans[i + 1];
 		}
+		if (dense)
+			writer.WriteZeros((capacity - written) * sizeof(T));
+		writer.Flush();
+		header.dataChecksum = dataSum.Finish();
 	}
+	header.headerChecksum = header.OwnChecksum();
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if (!file)
+		ERROR("cannot_open_file");
 
-	if (!found)
-		ERROR("all_stacks_empty");
+	file.close();
+}
+
+// A sparse file leaves out the free slots between stacks, so its size follows the stored elements
+// rather than the capacity; loading it restores the same stack bounds.
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::SaveToFile(const std::string& filename, bool sparse) const
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SaveToFile stores elements as raw bytes");
+	size_t live = 0;
+	std::vector<uint64_t> index(2 * count);
+	std::vector<uint64_t> spans(2 * count);
 	for (size_t i = 0; i < count; ++i)
 	{
-		if (!this->IsEmpty(i))
-		{
-			for (size_t j = stacksBegin[i]; j < starts[i]; ++j)
-			{
-				if (data[j] < minElem)
-					minElem = data[j];
-			}
-		}
+		index[i] = spans[2 * i] = stacksBegin[i];
+		index[count + i] = spans[2 * i + 1] = starts[i];
+		live += starts[i] - stacksBegin[i];
 	}
-
-	return minElem;
+	TMultyStackHeader header;
+	if (sparse)
+		header.Init(TMultyStackHeader::sparse, sizeof(T), alignof(T), capacity, count, live);
+	else
+		header.Init(TMultyStackHeader::dense, sizeof(T), alignof(T), capacity, count, capacity);
+	header.chain = snapshotChain;
+	header.sequence = snapshotSequence;
+	WriteSnapshot(filename, header, index, spans);
 }
 
-template<class T>
-inline void TMultyStack<T>::SaveToFile(const std::string& filename) const
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::LoadFromFile(const std::string& filename)
 {
-	std::ofstream file(filename, std::ios::binary);
+	static_assert(std::is_trivially_copyable<T>::value, "LoadFromFile reads elements as raw bytes");
+	std::ifstream file(filename, std::ios::binary);
 	if (!file.is_open())
 		ERROR("cannot_open_file");
-	file.write(reinterpret_cast<const char*>(&capacity), sizeof(capacity));
-	file.write(reinterpret_cast<const char*>(&count), sizeof(count));
-	if (capacity > 0)
+	TMultyStackHeader header;
+	std::vector<uint64_t> index;
+	header.Read(file, sizeof(T), alignof(T), index);
+	if (header.Kind() == TMultyStackHeader::delta)
+		ERROR("format_error");
+
+	// The stack is built aside and moved in last, so a damaged file leaves this one as it was.
+	TMultyStack loaded(0, 0, allocator);
+	loaded.adaptive = adaptive;
+	if (header.capacity > 0)
+		loaded.AllocateData(header.capacity);
+	if (header.count > 0)
 	{
-		for (size_t i = 0; i < capacity; ++i)
+		loaded.AllocateIndices(header.count);
+		for (size_t i = 0; i < loaded.count; ++i)
 		{
-			file.write(reinterpret_cast<const char*>(&data[i]), sizeof(T));
+			loaded.stacksBegin[i] = index[i];
+			loaded.starts[i] = index[loaded.count + i];
 		}
 	}
-	if (count > 0)
-	{
-		for (size_t i = 0; i < count; ++i)
+	// A dense data section is read in one call, slots outside the stacks included; a sparse one
+	// is read stack by stack into place.
+	TChecksum dataSum;
+	if (header.Kind() == TMultyStackHeader::sparse)
+		for (size_t i = 0; i < loaded.count && file; ++i)
 		{
-			file.write(reinterpret_cast<const char*>(&stacksBegin[i]), sizeof(size_t));
+			file.read(reinterpret_cast<char*>(loaded.data + loaded.stacksBegin[i]), loaded.Size(i) * sizeof(T));
+			dataSum.Update(loaded.data + loaded.stacksBegin[i], loaded.Size(i) * sizeof(T));
 		}
-	}
-	if (count > 0)
+	else
 	{
-		for (size_t i = 0; i < count; ++i)
-		{
-			file.write(reinterpret_cast<const char*>(&starts[i]), sizeof(size_t));
-		}
+		file.read(reinterpret_cast<char*>(loaded.data), loaded.capacity * sizeof(T));
+		dataSum.Update(loaded.data, loaded.capacity * sizeof(T));
 	}
+	if (!file || dataSum.Finish() != header.dataChecksum)
+		ERROR("checksum_error");
+	loaded.snapshotChain = header.chain;
+	loaded.snapshotSequence = header.sequence;
+	loaded.MarkClean();
+	*this = std::move(loaded);
 
 	file.close();
 }
 
-template<class T>
-inline void TMultyStack<T>::LoadFromFile(const std::string& filename)
+// Saves a full snapshot and starts tracking changes from it. The first checkpoint opens a new chain;
+// later ones keep it. Every checkpoint takes the next sequence number, like a delta, so the deltas
+// written after it apply only to this checkpoint or to a stack rebuilt up to it.
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::SaveCheckpoint(const std::string& filename, bool sparse)
+{
+	uint64_t chain = snapshotChain;
+	if (snapshotChain == 0)
+	{
+		std::random_device random;
+		snapshotChain = (static_cast<uint64_t>(random()) << 32 | random()) | 1;
+	}
+	snapshotSequence++;
+	try
+	{
+		SaveToFile(filename, sparse);
+	}
+	catch (...)
+	{
+		snapshotSequence--;
+		snapshotChain = chain;
+		throw;
+	}
+	MarkClean();
+}
+
+// Writes the bounds of every stack and the slots changed since the last checkpoint or delta.
+template<class T, class Alloc>
+inline void TMultyStack<T, Alloc>::SaveDelta(const std::string& filename)
+{
+	static_assert(std::is_trivially_copyable<T>::value, "SaveDelta stores elements as raw bytes");
+	if (snapshotChain == 0)
+		ERROR("snapshot_error");
+	size_t changed = 0;
+	std::vector<uint64_t> index(2 * count);
+	std::vector<uint64_t> spans;
+	for (size_t i = 0; i < count; ++i)
+	{
+		index[i] = stacksBegin[i];
+		index[count + i] = starts[i];
+	}
+	for (size_t i = 0; i < count; ++i)
+	{
+		size_t last = dirty[count + i] < Size(i) ? dirty[count + i] : Size(i);
+		if (dirty[i] >= last)
+			continue;
+		index.push_back(i);
+		index.push_back(dirty[i]);
+		index.push_back(last);
+		spans.push_back(stacksBegin[i] + dirty[i]);
+		spans.push_back(stacksBegin[i] + last);
+		changed += last - dirty[i];
+	}
+	TMultyStackHeader header;
+	header.Init(TMultyStackHeader::delta, sizeof(T), alignof(T), capacity, count, changed, spans.size() / 2);
+	header.chain = snapshotChain;
+	header.sequence = snapshotSequence + 1;
+	WriteSnapshot(filename, header, index, spans);
+	snapshotSequence++;
+	MarkClean();
+}
+
+// Brings a stack holding snapshot sequence - 1 of the delta's chain up to the delta. Returns false
+// without changes for a delta the stack already contains.
+template<class T, class Alloc>
+inline bool TMultyStack<T, Alloc>::ApplyDelta(const std::string& filename)
 {
+	static_assert(std::is_trivially_copyable<T>::value, "ApplyDelta reads elements as raw bytes");
 	std::ifstream file(filename, std::ios::binary);
 	if (!file.is_open())
 		ERROR("cannot_open_file");
-	if (data) delete[] data;
-	if (stacksBegin) delete[] stacksBegin;
-	if (starts) delete[] starts;
-	file.read(reinterpret_cast<char*>(&capacity), sizeof(capacity));
-	file.read(reinterpret_cast<char*>(&count), sizeof(count));
-	if (capacity > 0)
-	{
-		data = new T[capacity];
-		for (size_t i = 0; i < capacity; ++i)
+	TMultyStackHeader header;
+	std::vector<uint64_t> index;
+	header.Read(file, sizeof(T), alignof(T), index);
+	if (header.Kind() != TMultyStackHeader::delta)
+		ERROR("format_error");
+	if (header.chain != snapshotChain || header.capacity != capacity || header.count != count)
+		ERROR("snapshot_error");
+	if (header.sequence <= snapshotSequence)
+		return false;
+	if (header.sequence != snapshotSequence + 1)
+		ERROR("snapshot_error");
+	std::unique_ptr<char[]> changed(new char[header.Slots() * sizeof(T)]);
+	file.read(changed.get(), header.Slots() * sizeof(T));
+	if (!file || Checksum(changed.get(), header.Slots() * sizeof(T)) != header.dataChecksum)
+		ERROR("checksum_error");
+
+	// Slots outside the changed range must already be in the stack.
+	const uint64_t* ranges = index.data() + 2 * count;
+	std::vector<uint64_t> kept(count);
+	bool moved = false;
+	for (size_t i = 0, r = 0; i < count; ++i)
+	{
+		uint64_t size = index[count + i] - index[i];
+		kept[i] = size;
+		if (r < header.rangeCount && ranges[3 * r] == i)
 		{
-			file.read(reinterpret_cast<char*>(&data[i]), sizeof(T));
+			if (ranges[3 * r + 2] == size)
+				kept[i] = ranges[3 * r + 1];
+			++r;
 		}
+		if (kept[i] > Size(i))
+			ERROR("snapshot_error");
+		moved = moved || index[i] != stacksBegin[i];
 	}
-	else
+
+	T* target = data;
+	if (moved)
+		target = AllocateRaw(allocator, capacity);
+	for (size_t i = 0; i < count; ++i)
+		if (moved)
+			memcpy(static_cast<void*>(target + index[i]), data + stacksBegin[i], kept[i] * sizeof(T));
+	const char* source = changed.get();
+	for (size_t r = 0; r < header.rangeCount; ++r)
 	{
-		data = nullptr;
+		size_t bytes = (ranges[3 * r + 2] - ranges[3 * r + 1]) * sizeof(T);
+		memcpy(static_cast<void*>(target + index[ranges[3 * r]] + ranges[3 * r + 1]), source, bytes);
+		source += bytes;
 	}
-
-	if (count > 0)
+	if (moved)
 	{
-		stacksBegin = new size_t[count];
-		starts = new size_t[count];
-		for (size_t i = 0; i < count; ++i)
-		{
-			file.read(reinterpret_cast<char*>(&stacksBegin[i]), sizeof(size_t));
-		}
-
-		for (size_t i = 0; i < count; ++i)
-		{
-			file.read(reinterpret_cast<char*>(&starts[i]), sizeof(size_t));
-		}
+		DeallocateRaw(allocator, data, capacity);
+		data = target;
 	}
-	else
+	for (size_t i = 0; i < count; ++i)
 	{
-		stacksBegin = nullptr;
-		starts = nullptr;
+		stacksBegin[i] = index[i];
+		starts[i] = index[count + i];
+		MarkStale(i);
 	}
+	snapshotSequence = header.sequence;
+	MarkClean();
 
 	file.close();
+	return true;
+}
+
+// Folds deltas, in order, into the snapshot at base and replaces it. The result keeps the chain and
+// the last sequence number, so deltas written later still apply to it; deltas it already contains
+// are skipped.
+template<class T, class Alloc = std::allocator<T>>
+inline void CompactSnapshots(const std::string& base, const std::vector<std::string>& deltas, bool sparse = false)
+{
+	TMultyStack<T, Alloc> stack;
+	stack.LoadFromFile(base);
+	for (size_t i = 0; i < deltas.size(); ++i)
+		stack.ApplyDelta(deltas[i]);
+	std::string temp = base + ".tmp";
+	stack.SaveToFile(temp, sparse);
+	if (std::rename(temp.c_str(), base.c_str()) != 0)
+	{
+		std::remove(base.c_str());
+		if (std::rename(temp.c_str(), base.c_str()) != 0)
+			ERROR("cannot_open_file");
+	}
 }
\ No newline at end of file
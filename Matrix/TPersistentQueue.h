@@ -0,0 +1,465 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "TError.h"
+#include "TPersistentStack.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+// Immutable queue after Okasaki's real-time queue. The front is a lazy stream whose cells are
+// memoized rotations of the rear list, and every Put or Get forces one pending cell. That keeps both
+// O(1) in the worst case, including on old versions.
+template<class T, class Alloc = TPoolAllocator<T>>
+class TPersistentQueue {
+protected:
+    typedef TPersistentStack<T, Alloc> TRear;
+    typedef typename TRear::TNode TNode;
+    typedef typename TRear::TNodeAlloc TNodeAlloc;
+
+    // An evaluated cell holds value and next. A suspended one holds rotate(front, rear, accumulator)
+    // until Force replaces it with its first element and a suspension for the rest.
+    struct TCell {
+        std::atomic<size_t> refs;
+        std::once_flag once;
+        bool evaluated;
+        alignas(T) unsigned char storage[sizeof(T)];
+        TCell* next;
+        TCell* front;
+        TNode* rear;
+        TCell* accumulator;
+        TCell* pending;
+
+        TCell() : refs(1), evaluated(false), next(nullptr), front(nullptr), rear(nullptr), accumulator(nullptr), pending(nullptr) {}
+        T& Value() { return *reinterpret_cast<T*>(storage); }
+    };
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<TCell> TCellAlloc;
+
+    TCell* front;
+    size_t frontSize;
+    TRear rear;
+    TCell* schedule;
+    TCellAlloc allocator;
+
+    TPersistentQueue(TCell* front_, size_t frontSize_, TRear rear_, TCell* schedule_, const TCellAlloc& allocator_);
+
+    TCell* NewCell() const;
+    TCell* Cons(const T& value, TCell* next) const;
+    TCell* Suspend(TCell* front_, TNode* rear_, TCell* accumulator_) const;
+    void Force(TCell* cell) const;
+    void Evaluate(TCell* cell) const;
+    void Retain(TCell* cell) const;
+    void Release(TCell* cell) const;
+    TPersistentQueue Exec(TCell* front_, size_t frontSize_, TRear rear_, TCell* schedule_) const;
+    template<class F>
+    void ForEach(F visit) const;
+public:
+    TPersistentQueue(const Alloc& allocator_ = Alloc());
+    TPersistentQueue(const TPersistentQueue& other);
+    TPersistentQueue(TPersistentQueue&& other) noexcept;
+    ~TPersistentQueue();
+
+    TPersistentQueue& operator=(const TPersistentQueue& other);
+    TPersistentQueue& operator=(TPersistentQueue&& other) noexcept;
+    bool operator==(const TPersistentQueue& other) const;
+    bool operator!=(const TPersistentQueue& other) const;
+
+    bool IsEmpty() const;
+    Alloc GetAllocator() const;
+
+    TPersistentQueue Put(const T& elem) const;
+    TPersistentQueue Get() const;
+    const T& Head() const;
+    T Min() const;
+    size_t Size() const;
+
+    void WriteToFile(const TString& filename) const;
+    void ReadFromFile(const TString& filename);
+
+    template<class U, class A>
+    friend std::ostream& operator<<(std::ostream& os, const TPersistentQueue<U, A>& queue);
+};
+
+template<class T, class Alloc>
+inline TPersistentQueue<T, Alloc>::TPersistentQueue(TCell* front_, size_t frontSize_, TRear rear_, TCell* schedule_, const TCellAlloc& allocator_) : front(front_), frontSize(frontSize_), rear(std::move(rear_)), schedule(schedule_), allocator(allocator_)
+{
+}
+
+template<class T, class Alloc>
+inline typename TPersistentQueue<T, Alloc>::TCell* TPersistentQueue<T, Alloc>::NewCell() const
+{
+    TCellAlloc cellAllocator(allocator);
+    TCell* cell = std::allocator_traits<TCellAlloc>::allocate(cellAllocator, 1);
+    new (cell) TCell();
+    return cell;
+}
+
+// Takes over the caller's reference to next.
+template<class T, class Alloc>
+inline typename TPersistentQueue<T, Alloc>::TCell* TPersistentQueue<T, Alloc>::Cons(const T& value, TCell* next) const
+{
+    TCell* cell;
+    try
+    {
+        cell = NewCell();
+        try
+        {
+            new (cell->storage) T(value);
+        }
+        catch (...)
+        {
+            TCellAlloc cellAllocator(allocator);
+            cell->~TCell();
+            std::allocator_traits<TCellAlloc>::deallocate(cellAllocator, cell, 1);
+            throw;
+        }
+    }
+    catch (...)
+    {
+        Release(next);
+        throw;
+    }
+    cell->evaluated = true;
+    cell->next = next;
+    return cell;
+}
+
+// Takes over the caller's references to all three arguments.
+template<class T, class Alloc>
+inline typename TPersistentQueue<T, Alloc>::TCell* TPersistentQueue<T, Alloc>::Suspend(TCell* front_, TNode* rear_, TCell* accumulator_) const
+{
+    TCell* cell;
+    try
+    {
+        cell = NewCell();
+    }
+    catch (...)
+    {
+        Release(front_);
+        TNodeAlloc nodeAllocator(allocator);
+        TRear::Release(nodeAllocator, rear_);
+        Release(accumulator_);
+        throw;
+    }
+    cell->front = front_;
+    cell->rear = rear_;
+    cell->accumulator = accumulator_;
+    return cell;
+}
+
+template<class T, class Alloc>
+inline void TPersistentQueue<T, Alloc>::Force(TCell* cell) const
+{
+    std::call_once(cell->once, [this, cell]() { Evaluate(cell); });
+}
+
+// rotate(f, r, a) is f ++ reverse(r) ++ a, where r is one element longer than f.
+template<class T, class Alloc>
+inline void TPersistentQueue<T, Alloc>::Evaluate(TCell* cell) const
+{
+    if (cell->evaluated)
+        return;
+    TNode* rearNode = cell->rear;
+    if (cell->front == nullptr)
+    {
+        new (cell->storage) T(rearNode->value);
+        cell->next = cell->accumulator;
+    }
+    else
+    {
+        TCell* frontCell = cell->front;
+        Force(frontCell);
+        new (cell->storage) T(frontCell->Value());
+        try
+        {
+            Retain(cell->accumulator);
+            TCell* accumulated = Cons(rearNode->value, cell->accumulator);
+            Retain(frontCell->next);
+            TRear::Retain(rearNode->next);
+            cell->next = Suspend(frontCell->next, rearNode->next, accumulated);
+        }
+        catch (...)
+        {
+            cell->Value().~T();
+            throw;
+        }
+        Release(cell->accumulator);
+        Release(frontCell);
+    }
+    TNodeAlloc nodeAllocator(allocator);
+    TRear::Release(nodeAllocator, rearNode);
+    cell->front = nullptr;
+    cell->rear = nullptr;
+    cell->accumulator = nullptr;
+    cell->evaluated = true;
+}
+
+template<class T, class Alloc>
+inline void TPersistentQueue<T, Alloc>::Retain(TCell* cell) const
+{
+    if (cell != nullptr)
+        cell->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Dead cells are collected on an intrusive worklist, so long streams are freed without recursion.
+template<class T, class Alloc>
+inline void TPersistentQueue<T, Alloc>::Release(TCell* cell) const
+{
+    if (cell == nullptr || cell->refs.fetch_sub(1, std::memory_order_acq_rel) > 1)
+        return;
+    TCellAlloc cellAllocator(allocator);
+    TNodeAlloc nodeAllocator(allocator);
+    TCell* dead = cell;
+    cell->pending = nullptr;
+    while (dead != nullptr)
+    {
+        TCell* current = dead;
+        dead = current->pending;
+        TCell* children[3] = {current->next, current->front, current->accumulator};
+        if (current->evaluated)
+            current->Value().~T();
+        TRear::Release(nodeAllocator, current->rear);
+        current->~TCell();
+        std::allocator_traits<TCellAlloc>::deallocate(cellAllocator, current, 1);
+        for (TCell* child : children)
+            if (child != nullptr && child->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                child->pending = dead;
+                dead = child;
+            }
+    }
+}
+
+// Builds the next version from the given parts, taking over their references, and advances the schedule by one cell.
+template<class T, class Alloc>
+inline TPersistentQueue<T, Alloc> TPersistentQueue<T, Alloc>::Exec(TCell* front_, size_t frontSize_, TRear rear_, TCell* schedule_) const
+{
+    if (schedule_ != nullptr)
+    {
+        Force(schedule_);
+        TCell* rest = schedule_->next;
+        Retain(rest);
+        Release(schedule_);
+        return TPersistentQueue(front_, frontSize_, std::move(rear_), rest, allocator);
+    }
+    TNode* rearNodes = rear_.top;
+    size_t rearSize = rear_.size;
+    rear_.top = nullptr;
+    rear_.size = 0;
+    TCell* rotated = Suspend(front_, rearNodes, nullptr);
+    Retain(rotated);
+    return TPersistentQueue(rotated, frontSize_ + rearSize, std::move(rear_), rotated, allocator);
+}
+
+template<class T, class Alloc>
+template<class F>
+inline void TPersistentQueue<T, Alloc>::ForEach(F visit) const
+{
+    for (TCell* cell = front; cell != nullptr; cell = cell->next)
+    {
+        Force(cell);
+        visit(cell->Value());
+    }
+    std::vector<TNode*> nodes;
+    nodes.reserve(rear.size);
+    for (TNode* node = rear.top; node != nullptr; node = node->next)
+        nodes.push_back(node);
+    for (size_t i = nodes.size(); i > 0; --i)
+        visit(nodes[i - 1]->value);
+}
+
+template<class T, class Alloc>
+inline TPersistentQueue<T, Alloc>::TPersistentQueue(const Alloc& allocator_) : front(nullptr), frontSize(0), rear(allocator_), schedule(nullptr), allocator(allocator_)
+{
+}
+
+template<class T, class Alloc>
+inline TPersistentQueue<T, Alloc>::TPersistentQueue(const TPersistentQueue& other) : front(other.front), frontSize(other.frontSize), rear(other.rear), schedule(other.schedule), allocator(other.allocator)
+{
+    Retain(front);
+    Retain(schedule);
+}
+
+template<class T, class Alloc>
+inline TPersistentQueue<T, Alloc>::TPersistentQueue(TPersistentQueue&& other) noexcept : front(other.front), frontSize(other.frontSize), rear(std::move(other.rear)), schedule(other.schedule), allocator(other.allocator)
+{
+    other.front = nullptr;
+    other.frontSize = 0;
+    other.schedule = nullptr;
+}
+
+template<class T, class Alloc>
+inline TPersistentQueue<T, Alloc>::~TPersistentQueue()
+{
+    Release(front);
+    Release(schedule);
+}
+
+template<class T, class Alloc>
+inline TPersistentQueue<T, Alloc>& TPersistentQueue<T, Alloc>::operator=(const TPersistentQueue& other)
+{
+    if (this != &other)
+    {
+        TPersistentQueue copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template<class T, class Alloc>
+inline TPersistentQueue<T, Alloc>& TPersistentQueue<T, Alloc>::operator=(TPersistentQueue&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release(front);
+        Release(schedule);
+        front = other.front;
+        frontSize = other.frontSize;
+        rear = std::move(other.rear);
+        schedule = other.schedule;
+        allocator = other.allocator;
+        other.front = nullptr;
+        other.frontSize = 0;
+        other.schedule = nullptr;
+    }
+    return *this;
+}
+
+template<class T, class Alloc>
+inline bool TPersistentQueue<T, Alloc>::operator==(const TPersistentQueue& other) const
+{
+    if (Size() != other.Size())
+        return false;
+    std::vector<T*> mine;
+    mine.reserve(Size());
+    ForEach([&mine](T& value) { mine.push_back(&value); });
+    size_t i = 0;
+    bool equal = true;
+    other.ForEach([&](T& value) {
+        if (equal && *mine[i] != value)
+            equal = false;
+        i++;
+    });
+    return equal;
+}
+
+template<class T, class Alloc>
+inline bool TPersistentQueue<T, Alloc>::operator!=(const TPersistentQueue& other) const
+{
+    return !(*this == other);
+}
+
+template<class T, class Alloc>
+inline bool TPersistentQueue<T, Alloc>::IsEmpty() const
+{
+    return Size() == 0;
+}
+
+template<class T, class Alloc>
+inline Alloc TPersistentQueue<T, Alloc>::GetAllocator() const
+{
+    return Alloc(allocator);
+}
+
+template<class T, class Alloc>
+inline TPersistentQueue<T, Alloc> TPersistentQueue<T, Alloc>::Put(const T& elem) const
+{
+    TRear grown = rear.Put(elem);
+    Retain(front);
+    Retain(schedule);
+    return Exec(front, frontSize, std::move(grown), schedule);
+}
+
+template<class T, class Alloc>
+inline TPersistentQueue<T, Alloc> TPersistentQueue<T, Alloc>::Get() const
+{
+    if (Size() == 0)
+        ERROR("empty_stack");
+    Force(front);
+    Retain(front->next);
+    Retain(schedule);
+    return Exec(front->next, frontSize - 1, rear, schedule);
+}
+
+template<class T, class Alloc>
+inline const T& TPersistentQueue<T, Alloc>::Head() const
+{
+    if (Size() == 0)
+        ERROR("empty_stack");
+    Force(front);
+    return front->Value();
+}
+
+template<class T, class Alloc>
+inline T TPersistentQueue<T, Alloc>::Min() const
+{
+    if (Size() == 0)
+        ERROR("empty_stack");
+    T* min = nullptr;
+    ForEach([&min](T& value) {
+        if (min == nullptr || value < *min)
+            min = &value;
+    });
+    return *min;
+}
+
+template<class T, class Alloc>
+inline size_t TPersistentQueue<T, Alloc>::Size() const
+{
+    return frontSize + rear.size;
+}
+
+template<class T, class Alloc>
+void TPersistentQueue<T, Alloc>::WriteToFile(const TString& filename) const
+{
+    std::ofstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    file << Size() << std::endl;
+
+    ForEach([&file](T& value) { file << value << std::endl; });
+
+    file.close();
+}
+
+template<class T, class Alloc>
+void TPersistentQueue<T, Alloc>::ReadFromFile(const TString& filename)
+{
+    std::ifstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    size_t count;
+    file >> count;
+
+    TPersistentQueue<T, Alloc> loaded(GetAllocator());
+    T element;
+    for (size_t i = 0; i < count; ++i)
+    {
+        file >> element;
+        loaded = loaded.Put(element);
+    }
+    *this = std::move(loaded);
+
+    file.close();
+}
+
+template<class T, class Alloc>
+std::ostream& operator<<(std::ostream& os, const TPersistentQueue<T, Alloc>& queue)
+{
+    os << "[";
+    size_t i = 0;
+    queue.ForEach([&](T& value) {
+        os << value;
+        if (++i < queue.Size())
+            os << ", ";
+    });
+    os << "]";
+    return os;
+}
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include "TError.h"
+#include "TPoolAllocator.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+// Immutable stack: Put and Get return a new version that shares every node below the top with the old one.
+// Nodes are reference counted, so versions may be handed to other threads, and come from the pool by default.
+template<class T, class Alloc = TPoolAllocator<T>>
+class TPersistentStack {
+protected:
+    struct TNode {
+        T value;
+        TNode* next;
+        std::atomic<size_t> refs;
+
+        template<class... Args>
+        TNode(TNode* next_, Args&&... args) : value(std::forward<Args>(args)...), next(next_), refs(1) {}
+    };
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<TNode> TNodeAlloc;
+
+    TNode* top;
+    size_t size;
+    TNodeAlloc allocator;
+
+    TPersistentStack(TNode* top_, size_t size_, const TNodeAlloc& allocator_);
+
+    static void Retain(TNode* node);
+    static void Release(TNodeAlloc& allocator, TNode* node);
+
+    template<class U, class A>
+    friend class TPersistentQueue;
+public:
+    class iterator {
+    protected:
+        TNode* node;
+    public:
+        iterator(TNode* node_) : node(node_) {}
+
+        const T& operator*() const { return node->value; }
+        const T* operator->() const { return &node->value; }
+        iterator& operator++() { node = node->next; return *this; }
+        iterator operator++(int) { iterator old(*this); node = node->next; return old; }
+        bool operator==(const iterator& other) const { return node == other.node; }
+        bool operator!=(const iterator& other) const { return node != other.node; }
+    };
+
+    TPersistentStack(const Alloc& allocator_ = Alloc());
+    TPersistentStack(const TPersistentStack& other);
+    TPersistentStack(TPersistentStack&& other) noexcept;
+    ~TPersistentStack();
+
+    TPersistentStack& operator=(const TPersistentStack& other);
+    TPersistentStack& operator=(TPersistentStack&& other) noexcept;
+    bool operator==(const TPersistentStack& other) const;
+    bool operator!=(const TPersistentStack& other) const;
+
+    bool IsEmpty() const;
+    Alloc GetAllocator() const;
+
+    iterator begin() const;
+    iterator end() const;
+
+    TPersistentStack Put(const T& elem) const;
+    TPersistentStack Put(T&& elem) const;
+    template<class... Args>
+    TPersistentStack Emplace(Args&&... args) const;
+    TPersistentStack Get() const;
+    const T& Top() const;
+    T Min() const;
+    size_t Size() const;
+
+    void WriteToFile(const TString& filename) const;
+    void ReadFromFile(const TString& filename);
+
+    template<class U, class A>
+    friend std::ostream& operator<<(std::ostream& os, const TPersistentStack<U, A>& stack);
+};
+
+template<class T, class Alloc>
+inline TPersistentStack<T, Alloc>::TPersistentStack(TNode* top_, size_t size_, const TNodeAlloc& allocator_) : top(top_), size(size_), allocator(allocator_)
+{
+}
+
+template<class T, class Alloc>
+inline void TPersistentStack<T, Alloc>::Retain(TNode* node)
+{
+    if (node != nullptr)
+        node->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Walks down the chain iteratively so dropping a deep version does not recurse once per node.
+template<class T, class Alloc>
+inline void TPersistentStack<T, Alloc>::Release(TNodeAlloc& allocator, TNode* node)
+{
+    while (node != nullptr && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        TNode* next = node->next;
+        std::allocator_traits<TNodeAlloc>::destroy(allocator, node);
+        std::allocator_traits<TNodeAlloc>::deallocate(allocator, node, 1);
+        node = next;
+    }
+}
+
+template<class T, class Alloc>
+inline TPersistentStack<T, Alloc>::TPersistentStack(const Alloc& allocator_) : top(nullptr), size(0), allocator(allocator_)
+{
+}
+
+template<class T, class Alloc>
+inline TPersistentStack<T, Alloc>::TPersistentStack(const TPersistentStack& other) : top(other.top), size(other.size), allocator(other.allocator)
+{
+    Retain(top);
+}
+
+template<class T, class Alloc>
+inline TPersistentStack<T, Alloc>::TPersistentStack(TPersistentStack&& other) noexcept : top(other.top), size(other.size), allocator(other.allocator)
+{
+    other.top = nullptr;
+    other.size = 0;
+}
+
+template<class T, class Alloc>
+inline TPersistentStack<T, Alloc>::~TPersistentStack()
+{
+    Release(allocator, top);
+}
+
+template<class T, class Alloc>
+inline TPersistentStack<T, Alloc>& TPersistentStack<T, Alloc>::operator=(const TPersistentStack& other)
+{
+    if (this != &other)
+    {
+        Retain(other.top);
+        Release(allocator, top);
+        top = other.top;
+        size = other.size;
+        allocator = other.allocator;
+    }
+    return *this;
+}
+
+template<class T, class Alloc>
+inline TPersistentStack<T, Alloc>& TPersistentStack<T, Alloc>::operator=(TPersistentStack&& other) noexcept
+{
+    if (this != &other)
+    {
+        Release(allocator, top);
+        top = other.top;
+        size = other.size;
+        allocator = other.allocator;
+        other.top = nullptr;
+        other.size = 0;
+    }
+    return *this;
+}
+
+template<class T, class Alloc>
+inline bool TPersistentStack<T, Alloc>::operator==(const TPersistentStack& other) const
+{
+    if (size != other.size)
+        return false;
+    for (TNode* a = top, *b = other.top; a != b; a = a->next, b = b->next)
+        if (a->value != b->value)
+            return false;
+    return true;
+}
+
+template<class T, class Alloc>
+inline bool TPersistentStack<T, Alloc>::operator!=(const TPersistentStack& other) const
+{
+    return !(*this == other);
+}
+
+template<class T, class Alloc>
+inline bool TPersistentStack<T, Alloc>::IsEmpty() const
+{
+    return size == 0;
+}
+
+template<class T, class Alloc>
+inline Alloc TPersistentStack<T, Alloc>::GetAllocator() const
+{
+    return Alloc(allocator);
+}
+
+template<class T, class Alloc>
+inline typename TPersistentStack<T, Alloc>::iterator TPersistentStack<T, Alloc>::begin() const
+{
+    return iterator(top);
+}
+
+template<class T, class Alloc>
+inline typename TPersistentStack<T, Alloc>::iterator TPersistentStack<T, Alloc>::end() const
+{
+    return iterator(nullptr);
+}
+
+template<class T, class Alloc>
+inline TPersistentStack<T, Alloc> TPersistentStack<T, Alloc>::Put(const T& elem) const
+{
+    return Emplace(elem);
+}
+
+template<class T, class Alloc>
+inline TPersistentStack<T, Alloc> TPersistentStack<T, Alloc>::Put(T&& elem) const
+{
+    return Emplace(std::move(elem));
+}
+
+template<class T, class Alloc>
+template<class... Args>
+inline TPersistentStack<T, Alloc> TPersistentStack<T, Alloc>::Emplace(Args&&... args) const
+{
+    TNodeAlloc nodeAllocator(allocator);
+    TNode* node = std::allocator_traits<TNodeAlloc>::allocate(nodeAllocator, 1);
+    try
+    {
+        std::allocator_traits<TNodeAlloc>::construct(nodeAllocator, node, top, std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        std::allocator_traits<TNodeAlloc>::deallocate(nodeAllocator, node, 1);
+        throw;
+    }
+    Retain(top);
+    return TPersistentStack(node, size + 1, allocator);
+}
+
+template<class T, class Alloc>
+inline TPersistentStack<T, Alloc> TPersistentStack<T, Alloc>::Get() const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    Retain(top->next);
+    return TPersistentStack(top->next, size - 1, allocator);
+}
+
+template<class T, class Alloc>
+inline const T& TPersistentStack<T, Alloc>::Top() const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    return top->value;
+}
+
+template<class T, class Alloc>
+inline T TPersistentStack<T, Alloc>::Min() const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    T min = top->value;
+    for (TNode* node = top->next; node != nullptr; node = node->next)
+        if (node->value < min)
+            min = node->value;
+    return min;
+}
+
+template<class T, class Alloc>
+inline size_t TPersistentStack<T, Alloc>::Size() const
+{
+    return size;
+}
+
+template<class T, class Alloc>
+void TPersistentStack<T, Alloc>::WriteToFile(const TString& filename) const
+{
+    std::ofstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    file << size << std::endl;
+
+    std::vector<TNode*> nodes;
+    nodes.reserve(size);
+    for (TNode* node = top; node != nullptr; node = node->next)
+        nodes.push_back(node);
+    for (size_t i = nodes.size(); i > 0; --i)
+    {
+        file << nodes[i - 1]->value << std::endl;
+    }
+
+    file.close();
+}
+
+template<class T, class Alloc>
+void TPersistentStack<T, Alloc>::ReadFromFile(const TString& filename)
+{
+    std::ifstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    size_t count;
+    file >> count;
+
+    TPersistentStack<T, Alloc> loaded(GetAllocator());
+    T element;
+    for (size_t i = 0; i < count; ++i)
+    {
+        file >> element;
+        loaded = loaded.Put(element);
+    }
+    *this = std::move(loaded);
+
+    file.close();
+}
+
+template<class T, class Alloc>
+std::ostream& operator<<(std::ostream& os, const TPersistentStack<T, Alloc>& stack)
+{
+    std::vector<const T*> values;
+    for (auto it = stack.begin(); it != stack.end(); ++it)
+        values.push_back(&*it);
+    os << "[";
+    for (size_t i = values.size(); i > 0; --i) {
+        os << *values[i - 1];
+        if (i > 1)
+            os << ", ";
+    }
+    os << "]";
+    return os;
+}
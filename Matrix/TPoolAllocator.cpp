@@ -0,0 +1,118 @@
+#include "TPoolAllocator.h"
+
+TMemoryPool::TMemoryPool(size_t chunkSize_) : chunkSize(chunkSize_), chunks(nullptr), chunkCount(0)
+{
+    for (size_t i = 0; i < classCount; ++i)
+    {
+        freeLists[i] = nullptr;
+        freeCounts[i] = 0;
+    }
+}
+
+TMemoryPool::~TMemoryPool()
+{
+    while (chunks != nullptr)
+    {
+        TChunk* next = chunks->next;
+        ::operator delete(chunks, std::align_val_t(chunkAlignment));
+        chunks = next;
+    }
+}
+
+size_t TMemoryPool::ClassOf(size_t bytes, size_t alignment)
+{
+    if (bytes < alignment)
+        bytes = alignment;
+    size_t sizeClass = 0;
+    while (ClassBytes(sizeClass) < bytes)
+        sizeClass++;
+    return sizeClass;
+}
+
+size_t TMemoryPool::ClassBytes(size_t sizeClass)
+{
+    return static_cast<size_t>(1) << (sizeClass + minClassShift);
+}
+
+size_t TMemoryPool::MaxPooledBytes()
+{
+    return ClassBytes(classCount - 1);
+}
+
+void TMemoryPool::Refill(size_t sizeClass)
+{
+    size_t blockBytes = ClassBytes(sizeClass);
+    size_t payload = chunkSize > blockBytes ? chunkSize : blockBytes;
+    char* raw = static_cast<char*>(::operator new(chunkAlignment + payload, std::align_val_t(chunkAlignment)));
+    TChunk* chunk = reinterpret_cast<TChunk*>(raw);
+    chunk->next = chunks;
+    chunk->bytes = payload;
+    chunks = chunk;
+    chunkCount++;
+
+    char* block = raw + chunkAlignment;
+    for (size_t i = 0; i < payload / blockBytes; ++i, block += blockBytes)
+    {
+        TFreeNode* node = reinterpret_cast<TFreeNode*>(block);
+        node->next = freeLists[sizeClass];
+        freeLists[sizeClass] = node;
+        freeCounts[sizeClass]++;
+    }
+}
+
+void* TMemoryPool::Allocate(size_t bytes, size_t alignment)
+{
+    if (bytes == 0)
+        bytes = 1;
+    if (bytes > MaxPooledBytes() || alignment > chunkAlignment)
+        return ::operator new(bytes, std::align_val_t(alignment));
+
+    size_t sizeClass = ClassOf(bytes, alignment);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (freeLists[sizeClass] == nullptr)
+        Refill(sizeClass);
+    TFreeNode* node = freeLists[sizeClass];
+    freeLists[sizeClass] = node->next;
+    freeCounts[sizeClass]--;
+    return node;
+}
+
+void TMemoryPool::Deallocate(void* memory, size_t bytes, size_t alignment)
+{
+    if (memory == nullptr)
+        return;
+    if (bytes == 0)
+        bytes = 1;
+    if (bytes > MaxPooledBytes() || alignment > chunkAlignment)
+    {
+        ::operator delete(memory, std::align_val_t(alignment));
+        return;
+    }
+
+    size_t sizeClass = ClassOf(bytes, alignment);
+    std::lock_guard<std::mutex> lock(mutex);
+    TFreeNode* node = static_cast<TFreeNode*>(memory);
+    node->next = freeLists[sizeClass];
+    freeLists[sizeClass] = node;
+    freeCounts[sizeClass]++;
+}
+
+size_t TMemoryPool::ChunkCount()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return chunkCount;
+}
+
+size_t TMemoryPool::FreeBlocks(size_t bytes, size_t alignment)
+{
+    if (bytes > MaxPooledBytes() || alignment > chunkAlignment)
+        return 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    return freeCounts[ClassOf(bytes == 0 ? 1 : bytes, alignment)];
+}
+
+TMemoryPool& TMemoryPool::Default()
+{
+    static TMemoryPool pool;
+    return pool;
+}
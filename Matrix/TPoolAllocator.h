@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include "TError.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+class TMemoryPool {
+protected:
+    struct TFreeNode {
+        TFreeNode* next;
+    };
+    struct TChunk {
+        TChunk* next;
+        size_t bytes;
+    };
+
+    static const size_t minClassShift = 4;
+    static const size_t classCount = 17;
+    static const size_t chunkAlignment = 64;
+
+    size_t chunkSize;
+    TFreeNode* freeLists[classCount];
+    size_t freeCounts[classCount];
+    TChunk* chunks;
+    size_t chunkCount;
+    std::mutex mutex;
+
+    static size_t ClassOf(size_t bytes, size_t alignment);
+    static size_t ClassBytes(size_t sizeClass);
+    void Refill(size_t sizeClass);
+public:
+    TMemoryPool(size_t chunkSize_ = 64 * 1024);
+    TMemoryPool(const TMemoryPool& other) = delete;
+    ~TMemoryPool();
+
+    TMemoryPool& operator=(const TMemoryPool& other) = delete;
+
+    void* Allocate(size_t bytes, size_t alignment);
+    void Deallocate(void* memory, size_t bytes, size_t alignment);
+
+    size_t ChunkCount();
+    size_t FreeBlocks(size_t bytes, size_t alignment = alignof(std::max_align_t));
+    static size_t MaxPooledBytes();
+    static TMemoryPool& Default();
+};
+
+template<class T>
+class TPoolAllocator {
+protected:
+    TMemoryPool* pool;
+
+    template<class U>
+    friend class TPoolAllocator;
+public:
+    typedef T value_type;
+
+    TPoolAllocator() noexcept;
+    TPoolAllocator(TMemoryPool& pool_) noexcept;
+    template<class U>
+    TPoolAllocator(const TPoolAllocator<U>& other) noexcept;
+
+    T* allocate(size_t n);
+    void deallocate(T* memory, size_t n) noexcept;
+
+    TMemoryPool& Pool() const;
+
+    template<class U>
+    bool operator==(const TPoolAllocator<U>& other) const;
+    template<class U>
+    bool operator!=(const TPoolAllocator<U>& other) const;
+};
+
+template<class T>
+inline TPoolAllocator<T>::TPoolAllocator() noexcept : pool(&TMemoryPool::Default())
+{
+}
+
+template<class T>
+inline TPoolAllocator<T>::TPoolAllocator(TMemoryPool& pool_) noexcept : pool(&pool_)
+{
+}
+
+template<class T>
+template<class U>
+inline TPoolAllocator<T>::TPoolAllocator(const TPoolAllocator<U>& other) noexcept : pool(other.pool)
+{
+}
+
+template<class T>
+inline T* TPoolAllocator<T>::allocate(size_t n)
+{
+    if (n > static_cast<size_t>(-1) / sizeof(T))
+        throw std::bad_array_new_length();
+    return static_cast<T*>(pool->Allocate(n * sizeof(T), alignof(T)));
+}
+
+template<class T>
+inline void TPoolAllocator<T>::deallocate(T* memory, size_t n) noexcept
+{
+    pool->Deallocate(memory, n * sizeof(T), alignof(T));
+}
+
+template<class T>
+inline TMemoryPool& TPoolAllocator<T>::Pool() const
+{
+    return *pool;
+}
+
+template<class T>
+template<class U>
+inline bool TPoolAllocator<T>::operator==(const TPoolAllocator<U>& other) const
+{
+    return pool == other.pool;
+}
+
+template<class T>
+template<class U>
+inline bool TPoolAllocator<T>::operator!=(const TPoolAllocator<U>& other) const
+{
+    return pool != other.pool;
+}
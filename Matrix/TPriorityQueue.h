@@ -0,0 +1,500 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "TError.h"
+#include "TBlockOps.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+// Fixed-capacity D-ary heap with the TQueue interface: Head is the element that Compare orders first.
+// Every Put hands out a handle that stays valid until that element leaves the queue, for DecreaseKey.
+// Handle ids are reused, so each one carries the generation of its id and goes stale once Get removes it.
+template<class T, class Compare = std::less<T>, size_t D = 4, class Alloc = std::allocator<T>>
+class TPriorityQueue {
+    static_assert(D >= 2, "TPriorityQueue needs an arity of at least two");
+public:
+    struct THandle
+    {
+        size_t id;
+        size_t generation;
+    };
+protected:
+    typedef typename std::allocator_traits<Alloc>::template rebind_alloc<size_t> TIndexAlloc;
+    static const size_t npos = static_cast<size_t>(-1);
+
+    size_t size;
+    size_t capacity;
+    T* memory;
+    size_t* handles;
+    size_t* positions;
+    size_t* freeHandles;
+    size_t* generations;
+    size_t freeCount;
+    Compare compare;
+    Alloc allocator;
+    TIndexAlloc indexAllocator;
+
+    void Allocate(size_t count);
+    void ResetHandles();
+    void Place(size_t index, T&& elem, size_t handle);
+    void SiftUp(size_t index);
+    void SiftDown(size_t index);
+    void Heapify();
+    void Release();
+    void Load(std::istream& is);
+public:
+    TPriorityQueue(size_t capacity_ = 0, const Compare& compare_ = Compare(), const Alloc& allocator_ = Alloc());
+    template<class It, class = typename std::iterator_traits<It>::iterator_category>
+    TPriorityQueue(It first, It last, size_t capacity_ = 0, const Compare& compare_ = Compare(), const Alloc& allocator_ = Alloc());
+    TPriorityQueue(const TPriorityQueue& other);
+    TPriorityQueue(TPriorityQueue&& other) noexcept;
+    ~TPriorityQueue();
+
+    TPriorityQueue& operator=(const TPriorityQueue& other);
+    TPriorityQueue& operator=(TPriorityQueue&& other) noexcept;
+
+    bool IsEmpty() const;
+    bool IsFull() const;
+    Alloc GetAllocator() const;
+
+    THandle Put(const T& elem);
+    THandle Put(T&& elem);
+    template<class... Args>
+    THandle Emplace(Args&&... args);
+    T Get();
+    const T& Head() const;
+    size_t Size() const;
+
+    bool Contains(THandle handle) const;
+    const T& Value(THandle handle) const;
+    void DecreaseKey(THandle handle, const T& elem);
+
+    void WriteToFile(const TString& filename) const;
+    void ReadFromFile(const TString& filename);
+
+    template<class U, class C, size_t E, class A>
+    friend std::ostream& operator<<(std::ostream& os, const TPriorityQueue<U, C, E, A>& queue);
+    template<class O, class C, size_t E, class A>
+    friend std::istream& operator>>(std::istream& is, TPriorityQueue<O, C, E, A>& queue);
+};
+
+template<class T, class Compare, size_t D, class Alloc>
+inline void TPriorityQueue<T, Compare, D, Alloc>::Allocate(size_t count)
+{
+    memory = AllocateRaw(allocator, count);
+    try
+    {
+        handles = AllocateRaw(indexAllocator, 4 * count);
+    }
+    catch (...)
+    {
+        DeallocateRaw(allocator, memory, count);
+        memory = nullptr;
+        throw;
+    }
+    positions = handles + count;
+    freeHandles = positions + count;
+    generations = freeHandles + count;
+    capacity = count;
+    size = 0;
+    ResetHandles();
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline void TPriorityQueue<T, Compare, D, Alloc>::ResetHandles()
+{
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        positions[i] = npos;
+        freeHandles[i] = capacity - 1 - i;
+        generations[i] = 0;
+    }
+    freeCount = capacity;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline void TPriorityQueue<T, Compare, D, Alloc>::Place(size_t index, T&& elem, size_t handle)
+{
+    memory[index] = std::move(elem);
+    handles[index] = handle;
+    positions[handle] = index;
+}
+
+// Both sifts move a hole instead of swapping, so each level costs one move and one handle update.
+template<class T, class Compare, size_t D, class Alloc>
+inline void TPriorityQueue<T, Compare, D, Alloc>::SiftUp(size_t index)
+{
+    T elem(std::move(memory[index]));
+    size_t handle = handles[index];
+    while (index > 0)
+    {
+        size_t parent = (index - 1) / D;
+        if (!compare(elem, memory[parent]))
+            break;
+        Place(index, std::move(memory[parent]), handles[parent]);
+        index = parent;
+    }
+    Place(index, std::move(elem), handle);
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline void TPriorityQueue<T, Compare, D, Alloc>::SiftDown(size_t index)
+{
+    T elem(std::move(memory[index]));
+    size_t handle = handles[index];
+    while (true)
+    {
+        size_t first = index * D + 1;
+        if (first >= size)
+            break;
+        size_t last = first + D < size ? first + D : size;
+        size_t best = first;
+        for (size_t child = first + 1; child < last; ++child)
+            if (compare(memory[child], memory[best]))
+                best = child;
+        if (!compare(memory[best], elem))
+            break;
+        Place(index, std::move(memory[best]), handles[best]);
+        index = best;
+    }
+    Place(index, std::move(elem), handle);
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline void TPriorityQueue<T, Compare, D, Alloc>::Heapify()
+{
+    if (size < 2)
+        return;
+    for (size_t i = (size - 2) / D + 1; i > 0; --i)
+        SiftDown(i - 1);
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline void TPriorityQueue<T, Compare, D, Alloc>::Release()
+{
+    DestroyRange(memory, size);
+    DeallocateRaw(allocator, memory, capacity);
+    DeallocateRaw(indexAllocator, handles, 4 * capacity);
+    memory = nullptr;
+    handles = nullptr;
+    positions = nullptr;
+    freeHandles = nullptr;
+    generations = nullptr;
+    freeCount = 0;
+    size = 0;
+    capacity = 0;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline TPriorityQueue<T, Compare, D, Alloc>::TPriorityQueue(size_t capacity_, const Compare& compare_, const Alloc& allocator_) : compare(compare_), allocator(allocator_), indexAllocator(allocator_)
+{
+    Allocate(capacity_);
+}
+
+// Builds the heap bottom-up in O(n) instead of n separate Puts.
+template<class T, class Compare, size_t D, class Alloc>
+template<class It, class>
+inline TPriorityQueue<T, Compare, D, Alloc>::TPriorityQueue(It first, It last, size_t capacity_, const Compare& compare_, const Alloc& allocator_) : compare(compare_), allocator(allocator_), indexAllocator(allocator_)
+{
+    size_t count = static_cast<size_t>(std::distance(first, last));
+    Allocate(count > capacity_ ? count : capacity_);
+    try
+    {
+        UninitializedCopyFrom(memory, first, count);
+    }
+    catch (...)
+    {
+        Release();
+        throw;
+    }
+    size = count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t handle = freeHandles[--freeCount];
+        handles[i] = handle;
+        positions[handle] = i;
+    }
+    Heapify();
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline TPriorityQueue<T, Compare, D, Alloc>::TPriorityQueue(const TPriorityQueue& other) : compare(other.compare), allocator(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.allocator)), indexAllocator(allocator)
+{
+    Allocate(other.capacity);
+    try
+    {
+        UninitializedCopy(memory, other.memory, other.size);
+    }
+    catch (...)
+    {
+        Release();
+        throw;
+    }
+    size = other.size;
+    BlockCopy(handles, other.handles, 4 * capacity);
+    freeCount = other.freeCount;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline TPriorityQueue<T, Compare, D, Alloc>::TPriorityQueue(TPriorityQueue&& other) noexcept : size(other.size), capacity(other.capacity), memory(other.memory), handles(other.handles), positions(other.positions), freeHandles(other.freeHandles), generations(other.generations), freeCount(other.freeCount), compare(std::move(other.compare)), allocator(std::move(other.allocator)), indexAllocator(std::move(other.indexAllocator))
+{
+    other.memory = nullptr;
+    other.handles = nullptr;
+    other.positions = nullptr;
+    other.freeHandles = nullptr;
+    other.generations = nullptr;
+    other.freeCount = 0;
+    other.size = 0;
+    other.capacity = 0;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline TPriorityQueue<T, Compare, D, Alloc>::~TPriorityQueue()
+{
+    Release();
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline TPriorityQueue<T, Compare, D, Alloc>& TPriorityQueue<T, Compare, D, Alloc>::operator=(const TPriorityQueue& other)
+{
+    if (this != &other)
+    {
+        TPriorityQueue copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline TPriorityQueue<T, Compare, D, Alloc>& TPriorityQueue<T, Compare, D, Alloc>::operator=(TPriorityQueue&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+    Release();
+    compare = std::move(other.compare);
+    if constexpr (!std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
+    {
+        if (!(allocator == other.allocator))
+        {
+            Allocate(other.capacity);
+            UninitializedMove(memory, other.memory, other.size);
+            size = other.size;
+            BlockCopy(handles, other.handles, 4 * capacity);
+            freeCount = other.freeCount;
+            other.Release();
+            return *this;
+        }
+    }
+    else
+    {
+        allocator = std::move(other.allocator);
+        indexAllocator = std::move(other.indexAllocator);
+    }
+    size = other.size;
+    capacity = other.capacity;
+    memory = other.memory;
+    handles = other.handles;
+    positions = other.positions;
+    freeHandles = other.freeHandles;
+    generations = other.generations;
+    freeCount = other.freeCount;
+    other.memory = nullptr;
+    other.handles = nullptr;
+    other.positions = nullptr;
+    other.freeHandles = nullptr;
+    other.generations = nullptr;
+    other.freeCount = 0;
+    other.size = 0;
+    other.capacity = 0;
+    return *this;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline bool TPriorityQueue<T, Compare, D, Alloc>::IsEmpty() const
+{
+    return size == 0;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline bool TPriorityQueue<T, Compare, D, Alloc>::IsFull() const
+{
+    return size == capacity;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline Alloc TPriorityQueue<T, Compare, D, Alloc>::GetAllocator() const
+{
+    return allocator;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline typename TPriorityQueue<T, Compare, D, Alloc>::THandle TPriorityQueue<T, Compare, D, Alloc>::Put(const T& elem)
+{
+    return Emplace(elem);
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline typename TPriorityQueue<T, Compare, D, Alloc>::THandle TPriorityQueue<T, Compare, D, Alloc>::Put(T&& elem)
+{
+    return Emplace(std::move(elem));
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+template<class... Args>
+inline typename TPriorityQueue<T, Compare, D, Alloc>::THandle TPriorityQueue<T, Compare, D, Alloc>::Emplace(Args&&... args)
+{
+    if (size == capacity)
+        ERROR("full_queue");
+    new (memory + size) T(std::forward<Args>(args)...);
+    size_t handle = freeHandles[--freeCount];
+    handles[size] = handle;
+    positions[handle] = size;
+    size++;
+    SiftUp(size - 1);
+    return THandle{handle, generations[handle]};
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline T TPriorityQueue<T, Compare, D, Alloc>::Get()
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    T elem(std::move(memory[0]));
+    positions[handles[0]] = npos;
+    generations[handles[0]]++;
+    freeHandles[freeCount++] = handles[0];
+    size--;
+    if (size != 0)
+    {
+        memory[0] = std::move(memory[size]);
+        handles[0] = handles[size];
+        positions[handles[0]] = 0;
+    }
+    memory[size].~T();
+    if (size > 1)
+        SiftDown(0);
+    return elem;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline const T& TPriorityQueue<T, Compare, D, Alloc>::Head() const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    return memory[0];
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline size_t TPriorityQueue<T, Compare, D, Alloc>::Size() const
+{
+    return size;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline bool TPriorityQueue<T, Compare, D, Alloc>::Contains(THandle handle) const
+{
+    return handle.id < capacity && positions[handle.id] != npos && generations[handle.id] == handle.generation;
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline const T& TPriorityQueue<T, Compare, D, Alloc>::Value(THandle handle) const
+{
+    if (!Contains(handle))
+        ERROR("handle_error");
+    return memory[positions[handle.id]];
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+inline void TPriorityQueue<T, Compare, D, Alloc>::DecreaseKey(THandle handle, const T& elem)
+{
+    if (!Contains(handle))
+        ERROR("handle_error");
+    size_t index = positions[handle.id];
+    if (compare(memory[index], elem))
+        ERROR("key_error");
+    memory[index] = elem;
+    SiftUp(index);
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+void TPriorityQueue<T, Compare, D, Alloc>::WriteToFile(const TString& filename) const
+{
+    std::ofstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    file << size << std::endl;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        file << memory[i] << std::endl;
+    }
+
+    file.close();
+}
+
+// Parses into a fresh queue, so a damaged stream leaves this one as it was. The element count only
+// bounds the loop: storage grows with the elements actually read. Every id starts past the newest
+// generation seen here, so handles taken before the load stay stale.
+template<class T, class Compare, size_t D, class Alloc>
+void TPriorityQueue<T, Compare, D, Alloc>::Load(std::istream& is)
+{
+    size_t count;
+    if (!(is >> count))
+        ERROR("format_error");
+
+    std::vector<T> elements;
+    T element;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!(is >> element))
+            ERROR("format_error");
+        elements.push_back(element);
+    }
+
+    TPriorityQueue loaded(elements.begin(), elements.end(), 0, compare, allocator);
+    size_t generation = 0;
+    for (size_t i = 0; i < capacity; ++i)
+        if (generations[i] >= generation)
+            generation = generations[i] + 1;
+    for (size_t i = 0; i < loaded.capacity; ++i)
+        loaded.generations[i] = generation;
+    *this = std::move(loaded);
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+void TPriorityQueue<T, Compare, D, Alloc>::ReadFromFile(const TString& filename)
+{
+    std::ifstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    Load(file);
+
+    file.close();
+}
+
+template<class T, class Compare, size_t D, class Alloc>
+std::ostream& operator<<(std::ostream& os, const TPriorityQueue<T, Compare, D, Alloc>& queue)
+{
+    os << "[";
+    for (size_t i = 0; i < queue.size; ++i) {
+        os << queue.memory[i];
+        if (i < queue.size - 1)
+            os << ", ";
+    }
+    os << "]";
+    return os;
+}
+
+template<class O, class C, size_t E, class A>
+std::istream& operator>>(std::istream& is, TPriorityQueue<O, C, E, A>& queue)
+{
+    queue.Load(is);
+    return is;
+}
@@ -2,19 +2,41 @@
 
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <vector>
 #include "TError.h"
+#include "TBlockOps.h"
+#include "TBinaryFormat.h"
+#include "TReduce.h"
+#include "TRingIterator.h"
 #define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
 
 
-template<class T>
+template<class T, class Alloc = std::allocator<T>>
 class TQueue {
 protected:
+    size_t head;
     size_t size;
     size_t capacity;
     T* memory;
+    std::atomic<size_t>* shares;
+    bool unshareable;
+    Alloc allocator;
+
+    size_t Slot(size_t index) const;
+    size_t FirstPart() const;
+    void CopyInto(T* raw) const;
+    void MoveInto(T* raw);
+    void Allocate(size_t count);
+    void Detach();
+    void Leak();
+    void Release();
 public:
+    typedef TRingIterator<T> iterator;
+    typedef TRingIterator<const T> const_iterator;
+
     TQueue();
-    TQueue(size_t capacity_);
+    TQueue(size_t capacity_, const Alloc& allocator_ = Alloc());
     TQueue(const TQueue& other);
     TQueue(TQueue&& other) noexcept;
     ~TQueue();
@@ -26,201 +48,455 @@ public:
 
     bool IsEmpty();
     bool IsFull();
-
-    T operator[] (size_t index) const;
-
-    T* begin() const;
-    const T* cbegin() const;
-    T* end() const;
-    const T* cend() const;
-
-    void Put(T elem);
+    bool IsShared() const;
+    Alloc GetAllocator() const;
+
+    T& operator[] (size_t index);
+    const T& operator[] (size_t index) const;
+
+    iterator begin();
+    const_iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end();
+    const_iterator end() const;
+    const_iterator cend() const;
+
+    void Put(const T& elem);
+    void Put(T&& elem);
+    template<class... Args>
+    T& Emplace(Args&&... args);
+    template<class It>
+    void PutRange(It first, It last);
     T Get();
-    T Head();
-    T Tail();
-    T Min();
+    size_t GetN(T* out, size_t n);
+    size_t PeekN(T* out, size_t n) const;
+    T& Head();
+    const T& Head() const;
+    T& Tail();
+    const T& Tail() const;
+    T Min() const;
+    T Max() const;
+    T Sum() const;
+    TMinMax<T> MinMax() const;
+    size_t ArgMin() const;
+    template<class Pool>
+    T Min(Pool& pool) const;
+    template<class Pool>
+    T Max(Pool& pool) const;
+    template<class Pool>
+    T Sum(Pool& pool) const;
+    template<class Pool>
+    TMinMax<T> MinMax(Pool& pool) const;
+    template<class Pool>
+    size_t ArgMin(Pool& pool) const;
     size_t Size();
 
     void WriteToFile(const TString& filename) const;
+    void WriteToFile(const TString& filename, bool binary) const;
     void ReadFromFile(const TString& filename);
 
-    template<class U>
-    friend std::ostream& operator<<(std::ostream& os, const TQueue<U>& stack);
-    template<class O>
-    friend std::istream& operator>>(std::istream& is, TQueue<O>& stack);
+    template<class U, class A>
+    friend std::ostream& operator<<(std::ostream& os, const TQueue<U, A>& stack);
+    template<class O, class A>
+    friend std::istream& operator>>(std::istream& is, TQueue<O, A>& stack);
 };
 
-template<class T>
-inline TQueue<T>::TQueue() : size(0), capacity(0)
+template<class T, class Alloc>
+inline size_t TQueue<T, Alloc>::Slot(size_t index) const
 {
-    memory = nullptr;
+    index += head;
+    return index < capacity ? index : index - capacity;
 }
 
-template<class T>
-inline TQueue<T>::TQueue(size_t capacity_) : size(0), capacity(capacity_)
+template<class T, class Alloc>
+inline size_t TQueue<T, Alloc>::FirstPart() const
 {
-    if (capacity)
-        memory = new T[capacity];
-    else
-        memory = nullptr;
+    return capacity - head < size ? capacity - head : size;
 }
 
-template<class T>
-inline TQueue<T>::TQueue(const TQueue& other) : size(other.size), capacity(other.capacity)
+template<class T, class Alloc>
+inline void TQueue<T, Alloc>::CopyInto(T* raw) const
 {
-    if (other.memory)
+    size_t firstPart = FirstPart();
+    UninitializedCopy(raw, memory + head, firstPart);
+    try
     {
-        memory = new T[capacity];
-        for (size_t i = 0; i < size; ++i)
-            memory[i] = other.memory[i];
+        UninitializedCopy(raw + firstPart, memory, size - firstPart);
     }
-    else
+    catch (...)
     {
+        DestroyRange(raw, firstPart);
+        throw;
+    }
+}
+
+template<class T, class Alloc>
+inline void TQueue<T, Alloc>::MoveInto(T* raw)
+{
+    size_t firstPart = FirstPart();
+    UninitializedMove(raw, memory + head, firstPart);
+    try
+    {
+        UninitializedMove(raw + firstPart, memory, size - firstPart);
+    }
+    catch (...)
+    {
+        DestroyRange(raw, firstPart);
+        throw;
+    }
+}
+
+template<class T, class Alloc>
+inline void TQueue<T, Alloc>::Allocate(size_t count)
+{
+    memory = AllocateRaw(allocator, count);
+    capacity = count;
+    if (memory == nullptr)
+        return;
+    try
+    {
+        shares = AllocateShareCount(allocator);
+    }
+    catch (...)
+    {
+        DeallocateRaw(allocator, memory, capacity);
         memory = nullptr;
+        capacity = 0;
+        throw;
     }
 }
 
-template<class T>
-inline TQueue<T>::TQueue(TQueue&& other) noexcept
+template<class T, class Alloc>
+inline void TQueue<T, Alloc>::Detach()
 {
+    if constexpr (std::is_copy_constructible<T>::value)
+    {
+        if (!IsShared())
+            return;
+        TQueue<T, Alloc> own(capacity, allocator);
+        CopyInto(own.memory);
+        own.size = size;
+        *this = std::move(own);
+    }
+}
+
+template<class T, class Alloc>
+inline void TQueue<T, Alloc>::Leak()
+{
+    Detach();
+    unshareable = true;
+}
+
+template<class T, class Alloc>
+inline void TQueue<T, Alloc>::Release()
+{
+    if (DropShare(shares))
+    {
+        size_t firstPart = FirstPart();
+        DestroyRange(memory + head, firstPart);
+        DestroyRange(memory, size - firstPart);
+        DeallocateRaw(allocator, memory, capacity);
+        if (shares != nullptr)
+            DeallocateShareCount(allocator, shares);
+    }
+    memory = nullptr;
+    shares = nullptr;
+    unshareable = false;
+    head = 0;
+    size = 0;
+    capacity = 0;
+}
+
+template<class T, class Alloc>
+inline TQueue<T, Alloc>::TQueue() : head(0), size(0), capacity(0), shares(nullptr), unshareable(false)
+{
+    memory = nullptr;
+}
+
+template<class T, class Alloc>
+inline TQueue<T, Alloc>::TQueue(size_t capacity_, const Alloc& allocator_) : head(0), size(0), capacity(0), shares(nullptr), unshareable(false), allocator(allocator_)
+{
+    Allocate(capacity_);
+}
+
+template<class T, class Alloc>
+inline TQueue<T, Alloc>::TQueue(const TQueue& other) : head(0), size(0), capacity(0), shares(nullptr), unshareable(false), allocator(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.allocator))
+{
+    if (other.shares != nullptr && !other.unshareable && allocator == other.allocator)
+    {
+        other.shares->fetch_add(1, std::memory_order_relaxed);
+        shares = other.shares;
+        memory = other.memory;
+        capacity = other.capacity;
+        head = other.head;
+        size = other.size;
+        return;
+    }
+    Allocate(other.capacity);
+    try
+    {
+        other.CopyInto(memory);
+    }
+    catch (...)
+    {
+        Release();
+        throw;
+    }
+    size = other.size;
+}
+
+template<class T, class Alloc>
+inline TQueue<T, Alloc>::TQueue(TQueue&& other) noexcept : allocator(std::move(other.allocator))
+{
+    head = other.head;
     size = other.size;
     capacity = other.capacity;
     memory = other.memory;
+    shares = other.shares;
+    unshareable = other.unshareable;
     other.memory = nullptr;
+    other.shares = nullptr;
+    other.unshareable = false;
+    other.head = 0;
     other.size = 0;
     other.capacity = 0;
 }
 
-template<class T>
-inline TQueue<T>::~TQueue()
+template<class T, class Alloc>
+inline TQueue<T, Alloc>::~TQueue()
 {
-    if (memory != nullptr)
-        delete[] memory;
-    size = 0;
-    capacity = 0;
+    Release();
 }
 
-template<class T>
-inline TQueue<T>& TQueue<T>::operator=(const TQueue<T>& other)
+template<class T, class Alloc>
+inline TQueue<T, Alloc>& TQueue<T, Alloc>::operator=(const TQueue<T, Alloc>& other)
 {
-    if (*this != other)
+    if (this != &other)
     {
-        size = other.size;
-        capacity = other.capacity;
-        if (memory)
-            delete[] memory;
-        if (other.memory)
-        {
-            memory = new T[capacity];
-            for (size_t i = 0; i < size; ++i)
-                memory[i] = other.memory[i];
-        }
-        else
-            memory = nullptr;
+        TQueue<T, Alloc> copy(other);
+        *this = std::move(copy);
     }
     return *this;
 }
 
-template<class T>
-inline TQueue<T>& TQueue<T>::operator=(TQueue<T>&& other) noexcept
+template<class T, class Alloc>
+inline TQueue<T, Alloc>& TQueue<T, Alloc>::operator=(TQueue<T, Alloc>&& other) noexcept
 {
-    if (*this != other)
+    if (this == &other)
+        return *this;
+    Release();
+    if constexpr (!std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
     {
-        size = other.size;
-        capacity = other.capacity;
-        memory = other.memory;
-        other.memory = nullptr;
-        other.size = 0;
-        other.capacity = 0;
+        if (!(allocator == other.allocator))
+        {
+            Allocate(other.capacity);
+            if (other.IsShared())
+                other.CopyInto(memory);
+            else
+                other.MoveInto(memory);
+            size = other.size;
+            other.Release();
+            return *this;
+        }
     }
+    else
+        allocator = std::move(other.allocator);
+    head = other.head;
+    size = other.size;
+    capacity = other.capacity;
+    memory = other.memory;
+    shares = other.shares;
+    unshareable = other.unshareable;
+    other.memory = nullptr;
+    other.shares = nullptr;
+    other.unshareable = false;
+    other.head = 0;
+    other.size = 0;
+    other.capacity = 0;
     return *this;
 }
 
-template<class T>
-inline bool TQueue<T>::operator==(const TQueue& other)
+template<class T, class Alloc>
+inline bool TQueue<T, Alloc>::operator==(const TQueue& other)
 {
     if (size != other.size || capacity != other.capacity)
         return false;
-    for (size_t i = 0; i < size; ++i)
-        if (memory[i] != other.memory[i])
+    if (memory == other.memory && head == other.head)
+        return true;
+    size_t i = 0;
+    while (i < size)
+    {
+        size_t slot = Slot(i);
+        size_t otherSlot = other.Slot(i);
+        size_t run = size - i;
+        if (capacity - slot < run)
+            run = capacity - slot;
+        if (other.capacity - otherSlot < run)
+            run = other.capacity - otherSlot;
+        if (!BlockEqual(memory + slot, other.memory + otherSlot, run))
             return false;
+        i += run;
+    }
     return true;
 }
 
-template<class T>
-inline bool TQueue<T>::operator!=(const TQueue& other)
+template<class T, class Alloc>
+inline bool TQueue<T, Alloc>::operator!=(const TQueue& other)
 {
-    if (size != other.size || capacity != other.capacity)
-        return true;
-    for (size_t i = 0; i < size; ++i)
-        if (memory[i] != other.memory[i])
-            return true;
-    return false;
+    return !(*this == other);
 }
 
-template<class T>
-inline bool TQueue<T>::IsEmpty()
+template<class T, class Alloc>
+inline bool TQueue<T, Alloc>::IsEmpty()
 {
     return size == 0;
 }
 
-template<class T>
-inline bool TQueue<T>::IsFull()
+template<class T, class Alloc>
+inline bool TQueue<T, Alloc>::IsFull()
 {
     return size == capacity;
 }
 
-template<class T>
-inline T TQueue<T>:: operator[] (size_t index) const
+template<class T, class Alloc>
+inline bool TQueue<T, Alloc>::IsShared() const
+{
+    return shares != nullptr && shares->load(std::memory_order_acquire) > 1;
+}
+
+template<class T, class Alloc>
+inline Alloc TQueue<T, Alloc>::GetAllocator() const
+{
+    return allocator;
+}
+
+template<class T, class Alloc>
+inline T& TQueue<T, Alloc>:: operator[] (size_t index)
+{
+    if (index >= size)
+        ERROR("size_error");
+    Leak();
+    return memory[Slot(index)];
+}
+
+template<class T, class Alloc>
+inline const T& TQueue<T, Alloc>:: operator[] (size_t index) const
 {
     if (index >= size)
         ERROR("size_error");
-    return memory[index];
+    return memory[Slot(index)];
+}
+
+template<class T, class Alloc>
+inline typename TQueue<T, Alloc>::iterator TQueue<T, Alloc>:: begin()
+{
+    Leak();
+    return iterator(memory, capacity, head);
+}
+
+template<class T, class Alloc>
+inline typename TQueue<T, Alloc>::const_iterator TQueue<T, Alloc>:: begin() const
+{
+    return const_iterator(memory, capacity, head);
+}
+
+template<class T, class Alloc>
+inline typename TQueue<T, Alloc>::const_iterator TQueue<T, Alloc>::cbegin() const
+{
+    return const_iterator(memory, capacity, head);
 }
 
-template<class T>
-inline T* TQueue<T>:: begin() const
+template<class T, class Alloc>
+inline typename TQueue<T, Alloc>::iterator TQueue<T, Alloc>::end()
 {
-    return memory;
+    Leak();
+    return iterator(memory, capacity, head + size);
 }
 
-template<class T>
-inline const T* TQueue<T>::cbegin() const
+template<class T, class Alloc>
+inline typename TQueue<T, Alloc>::const_iterator TQueue<T, Alloc>::end() const
 {
-    return memory;
+    return const_iterator(memory, capacity, head + size);
 }
 
-template<class T>
-inline T* TQueue<T>::end() const
+template<class T, class Alloc>
+inline typename TQueue<T, Alloc>::const_iterator TQueue<T, Alloc>::cend() const
 {
-    return memory+size;
+    return const_iterator(memory, capacity, head + size);
 }
 
-template<class T>
-inline const T* TQueue<T>::cend() const
+template<class T, class Alloc>
+inline void TQueue<T, Alloc>::Put(const T& elem)
 {
-    return memory+size;
+    if (size != capacity)
+    {
+        Detach();
+        new (memory + Slot(size)) T(elem);
+        size++;
+    }
+    else
+        ERROR("full_queue");
 }
 
-template<class T>
-inline void TQueue<T>::Put(T elem)
+template<class T, class Alloc>
+inline void TQueue<T, Alloc>::Put(T&& elem)
 {
     if (size != capacity)
     {
-        memory[size++] = elem;
+        Detach();
+        new (memory + Slot(size)) T(std::move(elem));
+        size++;
     }
     else
         ERROR("full_queue");
 }
 
-template<class T>
-inline T TQueue<T>::Get()
+template<class T, class Alloc>
+template<class... Args>
+inline T& TQueue<T, Alloc>::Emplace(Args&&... args)
+{
+    if (size == capacity)
+        ERROR("full_queue");
+    Detach();
+    T* slot = new (memory + Slot(size)) T(std::forward<Args>(args)...);
+    size++;
+    return *slot;
+}
+
+template<class T, class Alloc>
+template<class It>
+inline void TQueue<T, Alloc>::PutRange(It first, It last)
+{
+    size_t count = static_cast<size_t>(std::distance(first, last));
+    if (count > capacity - size)
+        ERROR("full_queue");
+    if (count == 0)
+        return;
+    Detach();
+    size_t tail = Slot(size);
+    size_t firstPart = capacity - tail < count ? capacity - tail : count;
+    first = UninitializedCopyFrom(memory + tail, first, firstPart);
+    try
+    {
+        UninitializedCopyFrom(memory, first, count - firstPart);
+    }
+    catch (...)
+    {
+        DestroyRange(memory + tail, firstPart);
+        throw;
+    }
+    size += count;
+}
+
+template<class T, class Alloc>
+inline T TQueue<T, Alloc>::Get()
 {
     if (size != 0)
     {
-        T elem(std::move(memory[0]));
-        for (size_t i = 0; i < size-1;++i)
-            memory[i] = std::move(memory[i+1]);
+        Detach();
+        T elem(std::move(memory[head]));
+        memory[head].~T();
+        head = Slot(1);
         size--;
         return elem;
     }
@@ -228,95 +504,337 @@ inline T TQueue<T>::Get()
         ERROR("empty_stack");
 }
 
-template<class T>
-inline T TQueue<T>::Head()
+template<class T, class Alloc>
+inline size_t TQueue<T, Alloc>::GetN(T* out, size_t n)
 {
+    size_t count = n < size ? n : size;
+    if (count == 0)
+        return 0;
+    Detach();
+    size_t firstPart = capacity - head < count ? capacity - head : count;
+    BlockMove(out, memory + head, firstPart);
+    BlockMove(out + firstPart, memory, count - firstPart);
+    DestroyRange(memory + head, firstPart);
+    DestroyRange(memory, count - firstPart);
+    head = Slot(count);
+    size -= count;
+    return count;
+}
+
+template<class T, class Alloc>
+inline size_t TQueue<T, Alloc>::PeekN(T* out, size_t n) const
+{
+    size_t count = n < size ? n : size;
+    if (count == 0)
+        return 0;
+    size_t firstPart = capacity - head < count ? capacity - head : count;
+    BlockCopy(out, memory + head, firstPart);
+    BlockCopy(out + firstPart, memory, count - firstPart);
+    return count;
+}
+
+template<class T, class Alloc>
+inline T& TQueue<T, Alloc>::Head()
+{
+    Leak();
     if(size!=0)
-        return memory[0];
+        return memory[head];
     else
         ERROR("empty_stack");
 }
 
-template<class T>
-inline T TQueue<T>::Tail()
+template<class T, class Alloc>
+inline const T& TQueue<T, Alloc>::Head() const
 {
+    if(size!=0)
+        return memory[head];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, class Alloc>
+inline T& TQueue<T, Alloc>::Tail()
+{
+    Leak();
     if (size != 0)
-        return memory[size-1];
+        return memory[Slot(size-1)];
     else
         ERROR("empty_stack");
 }
 
-template<class T>
-inline T TQueue<T>::Min()
+template<class T, class Alloc>
+inline const T& TQueue<T, Alloc>::Tail() const
 {
     if (size != 0)
+        return memory[Slot(size-1)];
+    else
+        ERROR("empty_stack");
+}
+
+// The ring is reduced as its two contiguous parts, [head, capacity) and [0, tail), and the results are combined.
+template<class T, class Alloc>
+inline T TQueue<T, Alloc>::Min() const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    size_t first = FirstPart();
+    T min = ReduceMin(memory + head, first);
+    if (first < size)
     {
-        T min = memory[0];
-        for (size_t i = 1; i < size; ++i)
-            if (memory[i] < min)
-                min = memory[i];
-        return min;
+        T wrapped = ReduceMin(memory, size - first);
+        if (wrapped < min)
+            min = wrapped;
     }
-    else
+    return min;
+}
+
+template<class T, class Alloc>
+inline T TQueue<T, Alloc>::Max() const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    size_t first = FirstPart();
+    T max = ReduceMax(memory + head, first);
+    if (first < size)
+    {
+        T wrapped = ReduceMax(memory, size - first);
+        if (max < wrapped)
+            max = wrapped;
+    }
+    return max;
+}
+
+template<class T, class Alloc>
+inline T TQueue<T, Alloc>::Sum() const
+{
+    if (size == 0)
         ERROR("empty_stack");
+    size_t first = FirstPart();
+    T sum = ReduceSum(memory + head, first);
+    if (first < size)
+        sum = sum + ReduceSum(memory, size - first);
+    return sum;
 }
 
-template<class T>
-inline size_t TQueue<T>::Size()
+template<class T, class Alloc>
+inline TMinMax<T> TQueue<T, Alloc>::MinMax() const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    size_t first = FirstPart();
+    TMinMax<T> result = ReduceMinMax(memory + head, first);
+    if (first < size)
+    {
+        TMinMax<T> wrapped = ReduceMinMax(memory, size - first);
+        if (wrapped.min < result.min)
+            result.min = wrapped.min;
+        if (result.max < wrapped.max)
+            result.max = wrapped.max;
+    }
+    return result;
+}
+
+// Index counted from the head of the first smallest element.
+template<class T, class Alloc>
+inline size_t TQueue<T, Alloc>::ArgMin() const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    size_t first = FirstPart();
+    size_t best = ReduceArgMin(memory + head, first);
+    if (first < size)
+    {
+        size_t wrapped = ReduceArgMin(memory, size - first);
+        if (memory[wrapped] < memory[head + best])
+            best = first + wrapped;
+    }
+    return best;
+}
+
+template<class T, class Alloc>
+template<class Pool>
+inline T TQueue<T, Alloc>::Min(Pool& pool) const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    size_t first = FirstPart();
+    T min = ParallelReduceMin(pool, memory + head, first);
+    if (first < size)
+    {
+        T wrapped = ParallelReduceMin(pool, memory, size - first);
+        if (wrapped < min)
+            min = wrapped;
+    }
+    return min;
+}
+
+template<class T, class Alloc>
+template<class Pool>
+inline T TQueue<T, Alloc>::Max(Pool& pool) const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    size_t first = FirstPart();
+    T max = ParallelReduceMax(pool, memory + head, first);
+    if (first < size)
+    {
+        T wrapped = ParallelReduceMax(pool, memory, size - first);
+        if (max < wrapped)
+            max = wrapped;
+    }
+    return max;
+}
+
+template<class T, class Alloc>
+template<class Pool>
+inline T TQueue<T, Alloc>::Sum(Pool& pool) const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    size_t first = FirstPart();
+    T sum = ParallelReduceSum(pool, memory + head, first);
+    if (first < size)
+        sum = sum + ParallelReduceSum(pool, memory, size - first);
+    return sum;
+}
+
+template<class T, class Alloc>
+template<class Pool>
+inline TMinMax<T> TQueue<T, Alloc>::MinMax(Pool& pool) const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    size_t first = FirstPart();
+    TMinMax<T> result = ParallelReduceMinMax(pool, memory + head, first);
+    if (first < size)
+    {
+        TMinMax<T> wrapped = ParallelReduceMinMax(pool, memory, size - first);
+        if (wrapped.min < result.min)
+            result.min = wrapped.min;
+        if (result.max < wrapped.max)
+            result.max = wrapped.max;
+    }
+    return result;
+}
+
+template<class T, class Alloc>
+template<class Pool>
+inline size_t TQueue<T, Alloc>::ArgMin(Pool& pool) const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    size_t first = FirstPart();
+    size_t best = ParallelReduceArgMin(pool, memory + head, first);
+    if (first < size)
+    {
+        size_t wrapped = ParallelReduceArgMin(pool, memory, size - first);
+        if (memory[wrapped] < memory[head + best])
+            best = first + wrapped;
+    }
+    return best;
+}
+
+template<class T, class Alloc>
+inline size_t TQueue<T, Alloc>::Size()
 {
     return size;
 }
 
-template<class T>
-void TQueue<T>::WriteToFile(const TString& filename) const
+template<class T, class Alloc>
+void TQueue<T, Alloc>::WriteToFile(const TString& filename) const
 {
+    WriteToFile(filename, TBinaryCodec<T>::supported && size >= binaryFileThreshold);
+}
+
+template<class T, class Alloc>
+void TQueue<T, Alloc>::WriteToFile(const TString& filename, bool binary) const
+{
+    if constexpr (TBinaryCodec<T>::supported)
+    {
+        if (binary)
+        {
+            std::ofstream file(filename.CStr(), std::ios::binary);
+            if (!file.is_open())
+                ERROR("file_open_error");
+            WriteSequence(file, "TQUEUE", memory + head, FirstPart(), memory, size - FirstPart(), capacity);
+            file.close();
+            return;
+        }
+    }
+    else if (binary)
+        ERROR("format_error");
+
     std::ofstream file(filename.CStr());
     if (!file.is_open())
         ERROR("file_open_error");
 
-    file << size << std::endl;
+    file << size << '\n';
 
     for (size_t i = 0; i < size; ++i)
     {
-        file << memory[i] << std::endl;
+        file << memory[Slot(i)] << '\n';
     }
 
     file.close();
 }
 
-template<class T>
-void TQueue<T>::ReadFromFile(const TString& filename)
+// Accepts both formats: a binary file is recognised by its magic and restores the capacity as well.
+// The file is loaded into a new container, so a damaged one leaves this one unchanged.
+template<class T, class Alloc>
+void TQueue<T, Alloc>::ReadFromFile(const TString& filename)
 {
-    std::ifstream file(filename.CStr());
+    std::ifstream file(filename.CStr(), std::ios::binary);
     if (!file.is_open())
         ERROR("file_open_error");
 
-    size_t count;
-    file >> count;
-
-    if (memory != nullptr)
-        delete[] memory;
+    if (HasMagic(file, "TQUEUE"))
+    {
+        if constexpr (TBinaryCodec<T>::supported)
+        {
+            TBinaryReader reader(file);
+            TSequenceHeader header = ReadSequenceHeader<T>(reader, "TQUEUE");
+            TQueue<T, Alloc> loaded(header.capacity, allocator);
+            TChecksum sum;
+            reader.Track(&sum);
+            TBinaryCodec<T>::Read(reader, loaded.memory, header.count, loaded.size);
+            if (sum.Finish() != header.dataChecksum)
+                ERROR("checksum_error");
+            *this = std::move(loaded);
+            file.close();
+            return;
+        }
+        else
+            ERROR("format_error");
+    }
+    file.close();
+    file.open(filename.CStr());
 
-    capacity = count;
-    size = 0;
-    memory = new T[capacity];
+    size_t count;
+    if (!(file >> count))
+        ERROR("format_error");
 
+    // The count only bounds the loop, so a bogus one runs out of elements instead of memory.
+    std::vector<T> elements;
     T element;
     for (size_t i = 0; i < count; ++i)
     {
-        file >> element;
-        memory[size++] = element;
+        if (!(file >> element))
+            ERROR("format_error");
+        elements.push_back(element);
     }
+    TQueue<T, Alloc> loaded(elements.size(), allocator);
+    loaded.PutRange(elements.begin(), elements.end());
+    *this = std::move(loaded);
 
     file.close();
 }
 
-template<class T>
-std::ostream& operator<<(std::ostream& os, const TQueue<T>& queue)
+template<class T, class Alloc>
+std::ostream& operator<<(std::ostream& os, const TQueue<T, Alloc>& queue)
 {
     os << "[";
     for (size_t i = 0; i < queue.size; ++i) {
-        os << queue.memory[i];
+        os << queue.memory[queue.Slot(i)];
         if (i < queue.size - 1)
             os << ", ";
     }
@@ -324,24 +842,21 @@ std::ostream& operator<<(std::ostream& os, const TQueue<T>& queue)
     return os;
 }
 
-template<class T>
-std::istream& operator>>(std::istream& is, TQueue<T>& queue)
+template<class T, class Alloc>
+std::istream& operator>>(std::istream& is, TQueue<T, Alloc>& queue)
 {
     size_t count;
     is >> count;
 
-    if (queue.memory != nullptr)
-        delete[] queue.memory;
-
-    queue.capacity = count;
-    queue.size = 0;
-    queue.memory = new T[queue.capacity];
+    queue.Release();
+    queue.Allocate(count);
 
     T element;
     for (size_t i = 0; i < count; ++i)
     {
         is >> element;
-        queue.memory[queue.size++] = element;
+        new (queue.memory + queue.size) T(element);
+        queue.size++;
     }
 
     return is;
@@ -0,0 +1,50 @@
+#include "TReduceKernels.h"
+
+namespace {
+    bool HasAvx2()
+    {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+        static const bool has = __builtin_cpu_supports("avx2");
+        return has;
+#else
+        return false;
+#endif
+    }
+
+    const size_t baselineBytes = 16;
+}
+
+template<class T>
+T TSimdReduce<T>::Min(const T* data, size_t count)
+{
+    return HasAvx2() ? TSimdAvx2<T>::Min(data, count) : KernelMin<T, baselineBytes>(data, count);
+}
+
+template<class T>
+T TSimdReduce<T>::Max(const T* data, size_t count)
+{
+    return HasAvx2() ? TSimdAvx2<T>::Max(data, count) : KernelMax<T, baselineBytes>(data, count);
+}
+
+template<class T>
+T TSimdReduce<T>::Sum(const T* data, size_t count)
+{
+    return HasAvx2() ? TSimdAvx2<T>::Sum(data, count) : KernelSum<T, baselineBytes>(data, count);
+}
+
+template<class T>
+TMinMax<T> TSimdReduce<T>::MinMax(const T* data, size_t count)
+{
+    return HasAvx2() ? TSimdAvx2<T>::MinMax(data, count) : KernelMinMax<T, baselineBytes>(data, count);
+}
+
+template<class T>
+size_t TSimdReduce<T>::ArgMin(const T* data, size_t count)
+{
+    return HasAvx2() ? TSimdAvx2<T>::ArgMin(data, count) : KernelArgMin<T, baselineBytes>(data, count);
+}
+
+template struct TSimdReduce<int>;
+template struct TSimdReduce<int64_t>;
+template struct TSimdReduce<float>;
+template struct TSimdReduce<double>;
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+
+template<class T>
+struct TMinMax
+{
+    T min;
+    T max;
+};
+
+// int, int64_t, float and double go through vector kernels chosen at run time (AVX2 when the CPU has it,
+// the SSE2 baseline otherwise); every other type uses the scalar loops below. All functions expect count > 0.
+template<class T>
+struct TSimdReducible : std::integral_constant<bool,
+    std::is_same<T, int>::value || std::is_same<T, int64_t>::value ||
+    std::is_same<T, float>::value || std::is_same<T, double>::value> {};
+
+template<class T>
+struct TSimdReduce
+{
+    static T Min(const T* data, size_t count);
+    static T Max(const T* data, size_t count);
+    static T Sum(const T* data, size_t count);
+    static TMinMax<T> MinMax(const T* data, size_t count);
+    static size_t ArgMin(const T* data, size_t count);
+};
+
+template<class T>
+inline typename std::remove_cv<T>::type ScalarMin(T* data, size_t count)
+{
+    typename std::remove_cv<T>::type result = data[0];
+    for (size_t i = 1; i < count; ++i)
+        if (data[i] < result)
+            result = data[i];
+    return result;
+}
+
+template<class T>
+inline typename std::remove_cv<T>::type ScalarMax(T* data, size_t count)
+{
+    typename std::remove_cv<T>::type result = data[0];
+    for (size_t i = 1; i < count; ++i)
+        if (result < data[i])
+            result = data[i];
+    return result;
+}
+
+template<class T>
+inline typename std::remove_cv<T>::type ScalarSum(T* data, size_t count)
+{
+    typename std::remove_cv<T>::type result = data[0];
+    for (size_t i = 1; i < count; ++i)
+        result = result + data[i];
+    return result;
+}
+
+template<class T>
+inline TMinMax<typename std::remove_cv<T>::type> ScalarMinMax(T* data, size_t count)
+{
+    TMinMax<typename std::remove_cv<T>::type> result = { data[0], data[0] };
+    for (size_t i = 1; i < count; ++i)
+    {
+        if (data[i] < result.min)
+            result.min = data[i];
+        if (result.max < data[i])
+            result.max = data[i];
+    }
+    return result;
+}
+
+template<class T>
+inline size_t ScalarArgMin(T* data, size_t count)
+{
+    size_t best = 0;
+    for (size_t i = 1; i < count; ++i)
+        if (data[i] < data[best])
+            best = i;
+    return best;
+}
+
+template<class T>
+inline typename std::remove_cv<T>::type ReduceMin(T* data, size_t count)
+{
+    typedef typename std::remove_cv<T>::type U;
+    if constexpr (TSimdReducible<U>::value)
+        return TSimdReduce<U>::Min(data, count);
+    else
+        return ScalarMin(data, count);
+}
+
+template<class T>
+inline typename std::remove_cv<T>::type ReduceMax(T* data, size_t count)
+{
+    typedef typename std::remove_cv<T>::type U;
+    if constexpr (TSimdReducible<U>::value)
+        return TSimdReduce<U>::Max(data, count);
+    else
+        return ScalarMax(data, count);
+}
+
+template<class T>
+inline typename std::remove_cv<T>::type ReduceSum(T* data, size_t count)
+{
+    typedef typename std::remove_cv<T>::type U;
+    if constexpr (TSimdReducible<U>::value)
+        return TSimdReduce<U>::Sum(data, count);
+    else
+        return ScalarSum(data, count);
+}
+
+template<class T>
+inline TMinMax<typename std::remove_cv<T>::type> ReduceMinMax(T* data, size_t count)
+{
+    typedef typename std::remove_cv<T>::type U;
+    if constexpr (TSimdReducible<U>::value)
+        return TSimdReduce<U>::MinMax(data, count);
+    else
+        return ScalarMinMax(data, count);
+}
+
+template<class T>
+inline size_t ReduceArgMin(T* data, size_t count)
+{
+    typedef typename std::remove_cv<T>::type U;
+    if constexpr (TSimdReducible<U>::value)
+        return TSimdReduce<U>::ArgMin(data, count);
+    else
+        return ScalarArgMin(data, count);
+}
+
+// Parallel versions split the buffer into contiguous chunks run on a TThreadPool (any type with
+// ThreadCount and ParallelForRange will do) and combine the per-chunk results in order.
+// Buffers shorter than parallelGrain per worker are reduced on the calling thread.
+const size_t parallelGrain = 1 << 16;
+
+template<class Pool>
+inline size_t ChunkCount(Pool& pool, size_t count)
+{
+    size_t chunks = count / parallelGrain;
+    if (chunks > pool.ThreadCount() * 4)
+        chunks = pool.ThreadCount() * 4;
+    return chunks;
+}
+
+template<class Pool, class T>
+inline typename std::remove_cv<T>::type ParallelReduceMin(Pool& pool, T* data, size_t count)
+{
+    size_t chunks = ChunkCount(pool, count);
+    if (chunks < 2)
+        return ReduceMin(data, count);
+    std::vector<typename std::remove_cv<T>::type> partial(chunks);
+    pool.ParallelForRange(0, chunks, [&](size_t lo, size_t hi)
+    {
+        for (size_t c = lo; c < hi; ++c)
+            partial[c] = ReduceMin(data + c * count / chunks, (c + 1) * count / chunks - c * count / chunks);
+    }, 1);
+    return ScalarMin(partial.data(), chunks);
+}
+
+template<class Pool, class T>
+inline typename std::remove_cv<T>::type ParallelReduceMax(Pool& pool, T* data, size_t count)
+{
+    size_t chunks = ChunkCount(pool, count);
+    if (chunks < 2)
+        return ReduceMax(data, count);
+    std::vector<typename std::remove_cv<T>::type> partial(chunks);
+    pool.ParallelForRange(0, chunks, [&](size_t lo, size_t hi)
+    {
+        for (size_t c = lo; c < hi; ++c)
+            partial[c] = ReduceMax(data + c * count / chunks, (c + 1) * count / chunks - c * count / chunks);
+    }, 1);
+    return ScalarMax(partial.data(), chunks);
+}
+
+template<class Pool, class T>
+inline typename std::remove_cv<T>::type ParallelReduceSum(Pool& pool, T* data, size_t count)
+{
+    size_t chunks = ChunkCount(pool, count);
+    if (chunks < 2)
+        return ReduceSum(data, count);
+    std::vector<typename std::remove_cv<T>::type> partial(chunks);
+    pool.ParallelForRange(0, chunks, [&](size_t lo, size_t hi)
+    {
+        for (size_t c = lo; c < hi; ++c)
+            partial[c] = ReduceSum(data + c * count / chunks, (c + 1) * count / chunks - c * count / chunks);
+    }, 1);
+    return ScalarSum(partial.data(), chunks);
+}
+
+template<class Pool, class T>
+inline TMinMax<typename std::remove_cv<T>::type> ParallelReduceMinMax(Pool& pool, T* data, size_t count)
+{
+    size_t chunks = ChunkCount(pool, count);
+    if (chunks < 2)
+        return ReduceMinMax(data, count);
+    std::vector<TMinMax<typename std::remove_cv<T>::type>> partial(chunks);
+    pool.ParallelForRange(0, chunks, [&](size_t lo, size_t hi)
+    {
+        for (size_t c = lo; c < hi; ++c)
+            partial[c] = ReduceMinMax(data + c * count / chunks, (c + 1) * count / chunks - c * count / chunks);
+    }, 1);
+    TMinMax<typename std::remove_cv<T>::type> result = partial[0];
+    for (size_t c = 1; c < chunks; ++c)
+    {
+        if (partial[c].min < result.min)
+            result.min = partial[c].min;
+        if (result.max < partial[c].max)
+            result.max = partial[c].max;
+    }
+    return result;
+}
+
+template<class Pool, class T>
+inline size_t ParallelReduceArgMin(Pool& pool, T* data, size_t count)
+{
+    size_t chunks = ChunkCount(pool, count);
+    if (chunks < 2)
+        return ReduceArgMin(data, count);
+    std::vector<size_t> partial(chunks);
+    pool.ParallelForRange(0, chunks, [&](size_t lo, size_t hi)
+    {
+        for (size_t c = lo; c < hi; ++c)
+            partial[c] = c * count / chunks + ReduceArgMin(data + c * count / chunks, (c + 1) * count / chunks - c * count / chunks);
+    }, 1);
+    size_t best = partial[0];
+    for (size_t c = 1; c < chunks; ++c)
+        if (data[partial[c]] < data[best])
+            best = partial[c];
+    return best;
+}
@@ -0,0 +1,41 @@
+#include "TReduceKernels.h"
+
+// Built with -mavx2 where the compiler supports it (see CMakeLists.txt); only called once the CPU has been checked.
+namespace {
+    const size_t avx2Bytes = 32;
+}
+
+template<class T>
+T TSimdAvx2<T>::Min(const T* data, size_t count)
+{
+    return KernelMin<T, avx2Bytes>(data, count);
+}
+
+template<class T>
+T TSimdAvx2<T>::Max(const T* data, size_t count)
+{
+    return KernelMax<T, avx2Bytes>(data, count);
+}
+
+template<class T>
+T TSimdAvx2<T>::Sum(const T* data, size_t count)
+{
+    return KernelSum<T, avx2Bytes>(data, count);
+}
+
+template<class T>
+TMinMax<T> TSimdAvx2<T>::MinMax(const T* data, size_t count)
+{
+    return KernelMinMax<T, avx2Bytes>(data, count);
+}
+
+template<class T>
+size_t TSimdAvx2<T>::ArgMin(const T* data, size_t count)
+{
+    return KernelArgMin<T, avx2Bytes>(data, count);
+}
+
+template struct TSimdAvx2<int>;
+template struct TSimdAvx2<int64_t>;
+template struct TSimdAvx2<float>;
+template struct TSimdAvx2<double>;
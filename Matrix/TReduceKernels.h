@@ -0,0 +1,231 @@
+#pragma once
+
+#include <cstddef>
+#include "TReduce.h"
+
+
+// Reduction kernels shared by TReduce.cpp and TReduceAvx2.cpp. They are written once with GCC vector
+// extensions, so every translation unit that includes this header gets code for its own instruction set.
+// The anonymous namespace keeps the copies apart: nothing built with -mavx2 may leak into the baseline path.
+namespace {
+
+#if defined(__GNUC__)
+
+template<class T, size_t Bytes>
+struct TLanes
+{
+    typedef T V __attribute__((vector_size(Bytes)));
+    static const size_t width = Bytes / sizeof(T);
+    static const size_t step = 4 * width;
+
+    static V Load(const T* p)
+    {
+        V v;
+        __builtin_memcpy(&v, p, sizeof(V));
+        return v;
+    }
+};
+
+template<class T, size_t Bytes>
+inline T KernelMin(const T* data, size_t count)
+{
+    typedef TLanes<T, Bytes> L;
+    typedef typename L::V V;
+    T result = data[0];
+    size_t i = 0;
+    if (count >= L::step)
+    {
+        V a0 = L::Load(data), a1 = L::Load(data + L::width), a2 = L::Load(data + 2 * L::width), a3 = L::Load(data + 3 * L::width);
+        for (i = L::step; i + L::step <= count; i += L::step)
+        {
+            V b0 = L::Load(data + i), b1 = L::Load(data + i + L::width), b2 = L::Load(data + i + 2 * L::width), b3 = L::Load(data + i + 3 * L::width);
+            a0 = b0 < a0 ? b0 : a0;
+            a1 = b1 < a1 ? b1 : a1;
+            a2 = b2 < a2 ? b2 : a2;
+            a3 = b3 < a3 ? b3 : a3;
+        }
+        a0 = a1 < a0 ? a1 : a0;
+        a2 = a3 < a2 ? a3 : a2;
+        a0 = a2 < a0 ? a2 : a0;
+        result = a0[0];
+        for (size_t lane = 1; lane < L::width; ++lane)
+            if (a0[lane] < result)
+                result = a0[lane];
+    }
+    for (; i < count; ++i)
+        if (data[i] < result)
+            result = data[i];
+    return result;
+}
+
+template<class T, size_t Bytes>
+inline T KernelMax(const T* data, size_t count)
+{
+    typedef TLanes<T, Bytes> L;
+    typedef typename L::V V;
+    T result = data[0];
+    size_t i = 0;
+    if (count >= L::step)
+    {
+        V a0 = L::Load(data), a1 = L::Load(data + L::width), a2 = L::Load(data + 2 * L::width), a3 = L::Load(data + 3 * L::width);
+        for (i = L::step; i + L::step <= count; i += L::step)
+        {
+            V b0 = L::Load(data + i), b1 = L::Load(data + i + L::width), b2 = L::Load(data + i + 2 * L::width), b3 = L::Load(data + i + 3 * L::width);
+            a0 = a0 < b0 ? b0 : a0;
+            a1 = a1 < b1 ? b1 : a1;
+            a2 = a2 < b2 ? b2 : a2;
+            a3 = a3 < b3 ? b3 : a3;
+        }
+        a0 = a0 < a1 ? a1 : a0;
+        a2 = a2 < a3 ? a3 : a2;
+        a0 = a0 < a2 ? a2 : a0;
+        result = a0[0];
+        for (size_t lane = 1; lane < L::width; ++lane)
+            if (result < a0[lane])
+                result = a0[lane];
+    }
+    for (; i < count; ++i)
+        if (result < data[i])
+            result = data[i];
+    return result;
+}
+
+// Lanes are summed separately, so floating point sums may round differently from a left-to-right loop.
+template<class T, size_t Bytes>
+inline T KernelSum(const T* data, size_t count)
+{
+    typedef TLanes<T, Bytes> L;
+    typedef typename L::V V;
+    T result = T();
+    size_t i = 0;
+    if (count >= L::step)
+    {
+        V a0 = L::Load(data), a1 = L::Load(data + L::width), a2 = L::Load(data + 2 * L::width), a3 = L::Load(data + 3 * L::width);
+        for (i = L::step; i + L::step <= count; i += L::step)
+        {
+            a0 += L::Load(data + i);
+            a1 += L::Load(data + i + L::width);
+            a2 += L::Load(data + i + 2 * L::width);
+            a3 += L::Load(data + i + 3 * L::width);
+        }
+        a0 = (a0 + a1) + (a2 + a3);
+        for (size_t lane = 0; lane < L::width; ++lane)
+            result += a0[lane];
+    }
+    for (; i < count; ++i)
+        result += data[i];
+    return result;
+}
+
+template<class T, size_t Bytes>
+inline TMinMax<T> KernelMinMax(const T* data, size_t count)
+{
+    typedef TLanes<T, Bytes> L;
+    typedef typename L::V V;
+    TMinMax<T> result = { data[0], data[0] };
+    size_t i = 0;
+    if (count >= 2 * L::width)
+    {
+        V lo0 = L::Load(data), lo1 = L::Load(data + L::width);
+        V hi0 = lo0, hi1 = lo1;
+        for (i = 2 * L::width; i + 2 * L::width <= count; i += 2 * L::width)
+        {
+            V b0 = L::Load(data + i), b1 = L::Load(data + i + L::width);
+            lo0 = b0 < lo0 ? b0 : lo0;
+            lo1 = b1 < lo1 ? b1 : lo1;
+            hi0 = hi0 < b0 ? b0 : hi0;
+            hi1 = hi1 < b1 ? b1 : hi1;
+        }
+        lo0 = lo1 < lo0 ? lo1 : lo0;
+        hi0 = hi0 < hi1 ? hi1 : hi0;
+        result.min = lo0[0];
+        result.max = hi0[0];
+        for (size_t lane = 1; lane < L::width; ++lane)
+        {
+            if (lo0[lane] < result.min)
+                result.min = lo0[lane];
+            if (result.max < hi0[lane])
+                result.max = hi0[lane];
+        }
+    }
+    for (; i < count; ++i)
+    {
+        if (data[i] < result.min)
+            result.min = data[i];
+        if (result.max < data[i])
+            result.max = data[i];
+    }
+    return result;
+}
+
+// Finds the minimum first, then the first slot that holds it; both passes stream through memory once.
+template<class T, size_t Bytes>
+inline size_t KernelArgMin(const T* data, size_t count)
+{
+    typedef TLanes<T, Bytes> L;
+    typedef typename L::V V;
+    T min = KernelMin<T, Bytes>(data, count);
+    V target = V() + min;
+    size_t i = 0;
+    for (; i + L::width <= count; i += L::width)
+    {
+        V hit = L::Load(data + i) == target;
+        for (size_t lane = 0; lane < L::width; ++lane)
+            if (hit[lane])
+                return i + lane;
+    }
+    for (; i < count; ++i)
+        if (data[i] == min)
+            return i;
+    size_t best = 0;
+    for (i = 1; i < count; ++i)
+        if (data[i] < data[best])
+            best = i;
+    return best;
+}
+
+#else
+
+template<class T, size_t Bytes>
+inline T KernelMin(const T* data, size_t count)
+{
+    return ScalarMin(data, count);
+}
+
+template<class T, size_t Bytes>
+inline T KernelMax(const T* data, size_t count)
+{
+    return ScalarMax(data, count);
+}
+
+template<class T, size_t Bytes>
+inline T KernelSum(const T* data, size_t count)
+{
+    return ScalarSum(data, count);
+}
+
+template<class T, size_t Bytes>
+inline TMinMax<T> KernelMinMax(const T* data, size_t count)
+{
+    return ScalarMinMax(data, count);
+}
+
+template<class T, size_t Bytes>
+inline size_t KernelArgMin(const T* data, size_t count)
+{
+    return ScalarArgMin(data, count);
+}
+
+#endif
+
+}
+
+template<class T>
+struct TSimdAvx2
+{
+    static T Min(const T* data, size_t count);
+    static T Max(const T* data, size_t count);
+    static T Sum(const T* data, size_t count);
+    static TMinMax<T> MinMax(const T* data, size_t count);
+    static size_t ArgMin(const T* data, size_t count);
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+
+
+template<class V>
+class TRingIterator {
+protected:
+    V* memory;
+    size_t capacity;
+    size_t position;
+public:
+    constexpr TRingIterator(V* memory_, size_t capacity_, size_t position_);
+
+    constexpr V& operator*() const;
+    constexpr V* operator->() const;
+    constexpr TRingIterator& operator++();
+    constexpr TRingIterator operator++(int);
+    constexpr bool operator==(const TRingIterator& other) const;
+    constexpr bool operator!=(const TRingIterator& other) const;
+};
+
+template<class V>
+constexpr TRingIterator<V>::TRingIterator(V* memory_, size_t capacity_, size_t position_) : memory(memory_), capacity(capacity_), position(position_)
+{
+}
+
+template<class V>
+constexpr V& TRingIterator<V>::operator*() const
+{
+    return memory[position % capacity];
+}
+
+template<class V>
+constexpr V* TRingIterator<V>::operator->() const
+{
+    return &memory[position % capacity];
+}
+
+template<class V>
+constexpr TRingIterator<V>& TRingIterator<V>::operator++()
+{
+    ++position;
+    return *this;
+}
+
+template<class V>
+constexpr TRingIterator<V> TRingIterator<V>::operator++(int)
+{
+    TRingIterator old(*this);
+    ++position;
+    return old;
+}
+
+template<class V>
+constexpr bool TRingIterator<V>::operator==(const TRingIterator& other) const
+{
+    return memory == other.memory && position == other.position;
+}
+
+template<class V>
+constexpr bool TRingIterator<V>::operator!=(const TRingIterator& other) const
+{
+    return !(*this == other);
+}
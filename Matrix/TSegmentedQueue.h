@@ -0,0 +1,488 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include "TError.h"
+#include "TBlockOps.h"
+#include "TBlockChain.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+// Queue over a chain of B-element blocks: elements never move while queued, and the block drained at
+// the head is recycled for the tail, so a queue with steady throughput performs no allocations.
+template<class T, size_t B = 64, class Alloc = std::allocator<T>>
+class TSegmentedQueue {
+protected:
+    typedef TBlockChain<T, B, Alloc> TChain;
+    typedef typename TChain::TBlock TBlock;
+
+    TBlock* headBlock;
+    size_t headIndex;
+    TBlock* tailBlock;
+    size_t tailCount;
+    size_t size;
+    TChain chain;
+
+    void PushBlock();
+    void PopTailBlock();
+    void Clear();
+public:
+    typedef TSegmentIterator<T, TBlock> iterator;
+    typedef TSegmentIterator<const T, TBlock> const_iterator;
+
+    TSegmentedQueue(const Alloc& allocator_ = Alloc());
+    TSegmentedQueue(const TSegmentedQueue& other);
+    TSegmentedQueue(TSegmentedQueue&& other) noexcept;
+    ~TSegmentedQueue();
+
+    TSegmentedQueue& operator=(const TSegmentedQueue& other);
+    TSegmentedQueue& operator=(TSegmentedQueue&& other);
+    bool operator==(const TSegmentedQueue& other);
+    bool operator!=(const TSegmentedQueue& other);
+
+    bool IsEmpty();
+    size_t SpareBlocks() const;
+    size_t AllocatedBlocks() const;
+    void ShrinkToFit();
+    Alloc GetAllocator() const;
+
+    iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end() const;
+    const_iterator cend() const;
+
+    void Put(const T& elem);
+    void Put(T&& elem);
+    template<class... Args>
+    T& Emplace(Args&&... args);
+    template<class It>
+    void PutRange(It first, It last);
+    T Get();
+    size_t GetN(T* out, size_t n);
+    size_t PeekN(T* out, size_t n) const;
+    T& Head();
+    const T& Head() const;
+    T& Tail();
+    const T& Tail() const;
+    T Min();
+    size_t Size();
+
+    void WriteToFile(const TString& filename) const;
+    void ReadFromFile(const TString& filename);
+
+    template<class U, size_t M, class A>
+    friend std::ostream& operator<<(std::ostream& os, const TSegmentedQueue<U, M, A>& queue);
+    template<class O, size_t M, class A>
+    friend std::istream& operator>>(std::istream& is, TSegmentedQueue<O, M, A>& queue);
+};
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedQueue<T, B, Alloc>::PushBlock()
+{
+    TBlock* block = chain.Acquire();
+    block->prev = tailBlock;
+    if (tailBlock != nullptr)
+        tailBlock->next = block;
+    else
+    {
+        headBlock = block;
+        headIndex = 0;
+    }
+    tailBlock = block;
+    tailCount = 0;
+}
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedQueue<T, B, Alloc>::PopTailBlock()
+{
+    TBlock* block = tailBlock;
+    tailBlock = tailBlock->prev;
+    tailBlock->next = nullptr;
+    tailCount = B;
+    chain.Recycle(block);
+}
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedQueue<T, B, Alloc>::Clear()
+{
+    while (headBlock != nullptr)
+    {
+        TBlock* block = headBlock;
+        size_t last = block == tailBlock ? tailCount : B;
+        DestroyRange(block->Items() + headIndex, last - headIndex);
+        headBlock = block->next;
+        headIndex = 0;
+        chain.Recycle(block);
+    }
+    tailBlock = nullptr;
+    tailCount = 0;
+    size = 0;
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedQueue<T, B, Alloc>::TSegmentedQueue(const Alloc& allocator_) : headBlock(nullptr), headIndex(0), tailBlock(nullptr), tailCount(0), size(0), chain(allocator_)
+{
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedQueue<T, B, Alloc>::TSegmentedQueue(const TSegmentedQueue& other) : headBlock(nullptr), headIndex(0), tailBlock(nullptr), tailCount(0), size(0), chain(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.chain.GetAllocator()))
+{
+    try
+    {
+        for (const_iterator it = other.cbegin(); it != other.cend(); ++it)
+            Put(*it);
+    }
+    catch (...)
+    {
+        Clear();
+        throw;
+    }
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedQueue<T, B, Alloc>::TSegmentedQueue(TSegmentedQueue&& other) noexcept : headBlock(other.headBlock), headIndex(other.headIndex), tailBlock(other.tailBlock), tailCount(other.tailCount), size(other.size), chain(std::move(other.chain))
+{
+    other.headBlock = nullptr;
+    other.headIndex = 0;
+    other.tailBlock = nullptr;
+    other.tailCount = 0;
+    other.size = 0;
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedQueue<T, B, Alloc>::~TSegmentedQueue()
+{
+    Clear();
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedQueue<T, B, Alloc>& TSegmentedQueue<T, B, Alloc>::operator=(const TSegmentedQueue& other)
+{
+    if (this != &other)
+    {
+        TSegmentedQueue copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedQueue<T, B, Alloc>& TSegmentedQueue<T, B, Alloc>::operator=(TSegmentedQueue&& other)
+{
+    if (this == &other)
+        return *this;
+    Clear();
+    if (!chain.SameStorage(other.chain))
+    {
+        for (iterator it = other.begin(); it != other.end(); ++it)
+            Put(std::move(*it));
+        other.Clear();
+        return *this;
+    }
+    chain.StealFrom(other.chain);
+    headBlock = other.headBlock;
+    headIndex = other.headIndex;
+    tailBlock = other.tailBlock;
+    tailCount = other.tailCount;
+    size = other.size;
+    other.headBlock = nullptr;
+    other.headIndex = 0;
+    other.tailBlock = nullptr;
+    other.tailCount = 0;
+    other.size = 0;
+    return *this;
+}
+
+template<class T, size_t B, class Alloc>
+inline bool TSegmentedQueue<T, B, Alloc>::operator==(const TSegmentedQueue& other)
+{
+    if (size != other.size)
+        return false;
+    for (iterator a = begin(), b = other.begin(); a != end(); ++a, ++b)
+        if (*a != *b)
+            return false;
+    return true;
+}
+
+template<class T, size_t B, class Alloc>
+inline bool TSegmentedQueue<T, B, Alloc>::operator!=(const TSegmentedQueue& other)
+{
+    return !(*this == other);
+}
+
+template<class T, size_t B, class Alloc>
+inline bool TSegmentedQueue<T, B, Alloc>::IsEmpty()
+{
+    return size == 0;
+}
+
+template<class T, size_t B, class Alloc>
+inline size_t TSegmentedQueue<T, B, Alloc>::SpareBlocks() const
+{
+    return chain.FreeCount();
+}
+
+template<class T, size_t B, class Alloc>
+inline size_t TSegmentedQueue<T, B, Alloc>::AllocatedBlocks() const
+{
+    return chain.BlockCount();
+}
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedQueue<T, B, Alloc>::ShrinkToFit()
+{
+    chain.Trim();
+}
+
+template<class T, size_t B, class Alloc>
+inline Alloc TSegmentedQueue<T, B, Alloc>::GetAllocator() const
+{
+    return chain.GetAllocator();
+}
+
+template<class T, size_t B, class Alloc>
+inline typename TSegmentedQueue<T, B, Alloc>::iterator TSegmentedQueue<T, B, Alloc>::begin() const
+{
+    return iterator(headBlock, headIndex, B);
+}
+
+template<class T, size_t B, class Alloc>
+inline typename TSegmentedQueue<T, B, Alloc>::const_iterator TSegmentedQueue<T, B, Alloc>::cbegin() const
+{
+    return const_iterator(headBlock, headIndex, B);
+}
+
+template<class T, size_t B, class Alloc>
+inline typename TSegmentedQueue<T, B, Alloc>::iterator TSegmentedQueue<T, B, Alloc>::end() const
+{
+    return iterator(tailBlock, tailCount, B);
+}
+
+template<class T, size_t B, class Alloc>
+inline typename TSegmentedQueue<T, B, Alloc>::const_iterator TSegmentedQueue<T, B, Alloc>::cend() const
+{
+    return const_iterator(tailBlock, tailCount, B);
+}
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedQueue<T, B, Alloc>::Put(const T& elem)
+{
+    Emplace(elem);
+}
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedQueue<T, B, Alloc>::Put(T&& elem)
+{
+    Emplace(std::move(elem));
+}
+
+template<class T, size_t B, class Alloc>
+template<class... Args>
+inline T& TSegmentedQueue<T, B, Alloc>::Emplace(Args&&... args)
+{
+    if (tailBlock == nullptr || tailCount == B)
+        PushBlock();
+    T* slot;
+    try
+    {
+        slot = new (tailBlock->Items() + tailCount) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        if (tailCount == 0 && tailBlock != headBlock)
+            PopTailBlock();
+        throw;
+    }
+    tailCount++;
+    size++;
+    return *slot;
+}
+
+template<class T, size_t B, class Alloc>
+template<class It>
+inline void TSegmentedQueue<T, B, Alloc>::PutRange(It first, It last)
+{
+    for (; first != last; ++first)
+        Emplace(*first);
+}
+
+template<class T, size_t B, class Alloc>
+inline T TSegmentedQueue<T, B, Alloc>::Get()
+{
+    if (size != 0)
+    {
+        T* slot = headBlock->Items() + headIndex;
+        T elem(std::move(*slot));
+        slot->~T();
+        headIndex++;
+        size--;
+        if (headBlock == tailBlock)
+        {
+            if (size == 0)
+            {
+                headIndex = 0;
+                tailCount = 0;
+            }
+        }
+        else if (headIndex == B)
+        {
+            TBlock* block = headBlock;
+            headBlock = headBlock->next;
+            headBlock->prev = nullptr;
+            headIndex = 0;
+            chain.Recycle(block);
+        }
+        return elem;
+    }
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t B, class Alloc>
+inline size_t TSegmentedQueue<T, B, Alloc>::GetN(T* out, size_t n)
+{
+    size_t count = n < size ? n : size;
+    for (size_t i = 0; i < count; ++i)
+        out[i] = Get();
+    return count;
+}
+
+template<class T, size_t B, class Alloc>
+inline size_t TSegmentedQueue<T, B, Alloc>::PeekN(T* out, size_t n) const
+{
+    size_t count = n < size ? n : size;
+    const_iterator it = cbegin();
+    for (size_t i = 0; i < count; ++i, ++it)
+        out[i] = *it;
+    return count;
+}
+
+template<class T, size_t B, class Alloc>
+inline T& TSegmentedQueue<T, B, Alloc>::Head()
+{
+    if (size != 0)
+        return headBlock->Items()[headIndex];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t B, class Alloc>
+inline const T& TSegmentedQueue<T, B, Alloc>::Head() const
+{
+    if (size != 0)
+        return headBlock->Items()[headIndex];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t B, class Alloc>
+inline T& TSegmentedQueue<T, B, Alloc>::Tail()
+{
+    if (size != 0)
+        return tailBlock->Items()[tailCount - 1];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t B, class Alloc>
+inline const T& TSegmentedQueue<T, B, Alloc>::Tail() const
+{
+    if (size != 0)
+        return tailBlock->Items()[tailCount - 1];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t B, class Alloc>
+inline T TSegmentedQueue<T, B, Alloc>::Min()
+{
+    if (size != 0)
+    {
+        iterator it = begin();
+        T min = *it;
+        for (++it; it != end(); ++it)
+            if (*it < min)
+                min = *it;
+        return min;
+    }
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t B, class Alloc>
+inline size_t TSegmentedQueue<T, B, Alloc>::Size()
+{
+    return size;
+}
+
+template<class T, size_t B, class Alloc>
+void TSegmentedQueue<T, B, Alloc>::WriteToFile(const TString& filename) const
+{
+    std::ofstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    file << size << std::endl;
+
+    for (const_iterator it = cbegin(); it != cend(); ++it)
+    {
+        file << *it << std::endl;
+    }
+
+    file.close();
+}
+
+template<class T, size_t B, class Alloc>
+void TSegmentedQueue<T, B, Alloc>::ReadFromFile(const TString& filename)
+{
+    std::ifstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    size_t count;
+    file >> count;
+
+    Clear();
+
+    T element;
+    for (size_t i = 0; i < count; ++i)
+    {
+        file >> element;
+        Put(element);
+    }
+
+    file.close();
+}
+
+template<class T, size_t B, class Alloc>
+std::ostream& operator<<(std::ostream& os, const TSegmentedQueue<T, B, Alloc>& queue)
+{
+    os << "[";
+    size_t i = 0;
+    for (auto it = queue.cbegin(); it != queue.cend(); ++it, ++i) {
+        os << *it;
+        if (i < queue.size - 1)
+            os << ", ";
+    }
+    os << "]";
+    return os;
+}
+
+template<class O, size_t M, class A>
+std::istream& operator>>(std::istream& is, TSegmentedQueue<O, M, A>& queue)
+{
+    size_t count;
+    is >> count;
+
+    queue.Clear();
+
+    O element;
+    for (size_t i = 0; i < count; ++i)
+    {
+        is >> element;
+        queue.Put(element);
+    }
+
+    return is;
+}
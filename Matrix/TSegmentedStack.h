@@ -0,0 +1,458 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include "TError.h"
+#include "TBlockOps.h"
+#include "TBlockChain.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+// Stack over a chain of B-element blocks: growing never moves elements, so references stay valid until
+// the element is popped, and emptied blocks are reused instead of freed.
+template<class T, size_t B = 64, class Alloc = std::allocator<T>>
+class TSegmentedStack {
+protected:
+    typedef TBlockChain<T, B, Alloc> TChain;
+    typedef typename TChain::TBlock TBlock;
+
+    TBlock* bottom;
+    TBlock* top;
+    size_t topCount;
+    size_t size;
+    TChain chain;
+
+    void PushBlock();
+    void PopBlock();
+    void Clear();
+public:
+    typedef TSegmentIterator<T, TBlock> iterator;
+    typedef TSegmentIterator<const T, TBlock> const_iterator;
+
+    TSegmentedStack(const Alloc& allocator_ = Alloc());
+    TSegmentedStack(const TSegmentedStack& other);
+    TSegmentedStack(TSegmentedStack&& other) noexcept;
+    ~TSegmentedStack();
+
+    TSegmentedStack& operator=(const TSegmentedStack& other);
+    TSegmentedStack& operator=(TSegmentedStack&& other);
+    bool operator==(const TSegmentedStack& other);
+    bool operator!=(const TSegmentedStack& other);
+
+    bool IsEmpty();
+    size_t SpareBlocks() const;
+    size_t AllocatedBlocks() const;
+    void ShrinkToFit();
+    Alloc GetAllocator() const;
+
+    iterator begin() const;
+    const_iterator cbegin() const;
+    iterator end() const;
+    const_iterator cend() const;
+
+    void Put(const T& elem);
+    void Put(T&& elem);
+    template<class... Args>
+    T& Emplace(Args&&... args);
+    template<class It>
+    void PutRange(It first, It last);
+    T Get();
+    size_t PopN(T* out, size_t n);
+    size_t PeekN(T* out, size_t n) const;
+    T& Top();
+    const T& Top() const;
+    T Min();
+    size_t Size();
+
+    void WriteToFile(const TString& filename) const;
+    void ReadFromFile(const TString& filename);
+
+    template<class U, size_t M, class A>
+    friend std::ostream& operator<<(std::ostream& os, const TSegmentedStack<U, M, A>& stack);
+    template<class O, size_t M, class A>
+    friend std::istream& operator>>(std::istream& is, TSegmentedStack<O, M, A>& stack);
+};
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedStack<T, B, Alloc>::PushBlock()
+{
+    TBlock* block = chain.Acquire();
+    block->prev = top;
+    if (top != nullptr)
+        top->next = block;
+    else
+        bottom = block;
+    top = block;
+    topCount = 0;
+}
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedStack<T, B, Alloc>::PopBlock()
+{
+    TBlock* block = top;
+    top = top->prev;
+    if (top != nullptr)
+    {
+        top->next = nullptr;
+        topCount = B;
+    }
+    else
+    {
+        bottom = nullptr;
+        topCount = 0;
+    }
+    chain.Recycle(block);
+}
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedStack<T, B, Alloc>::Clear()
+{
+    while (top != nullptr)
+    {
+        DestroyRange(top->Items(), topCount);
+        PopBlock();
+    }
+    size = 0;
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedStack<T, B, Alloc>::TSegmentedStack(const Alloc& allocator_) : bottom(nullptr), top(nullptr), topCount(0), size(0), chain(allocator_)
+{
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedStack<T, B, Alloc>::TSegmentedStack(const TSegmentedStack& other) : bottom(nullptr), top(nullptr), topCount(0), size(0), chain(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.chain.GetAllocator()))
+{
+    try
+    {
+        for (const_iterator it = other.cbegin(); it != other.cend(); ++it)
+            Put(*it);
+    }
+    catch (...)
+    {
+        Clear();
+        throw;
+    }
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedStack<T, B, Alloc>::TSegmentedStack(TSegmentedStack&& other) noexcept : bottom(other.bottom), top(other.top), topCount(other.topCount), size(other.size), chain(std::move(other.chain))
+{
+    other.bottom = nullptr;
+    other.top = nullptr;
+    other.topCount = 0;
+    other.size = 0;
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedStack<T, B, Alloc>::~TSegmentedStack()
+{
+    Clear();
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedStack<T, B, Alloc>& TSegmentedStack<T, B, Alloc>::operator=(const TSegmentedStack& other)
+{
+    if (this != &other)
+    {
+        TSegmentedStack copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template<class T, size_t B, class Alloc>
+inline TSegmentedStack<T, B, Alloc>& TSegmentedStack<T, B, Alloc>::operator=(TSegmentedStack&& other)
+{
+    if (this == &other)
+        return *this;
+    Clear();
+    if (!chain.SameStorage(other.chain))
+    {
+        for (iterator it = other.begin(); it != other.end(); ++it)
+            Put(std::move(*it));
+        other.Clear();
+        return *this;
+    }
+    chain.StealFrom(other.chain);
+    bottom = other.bottom;
+    top = other.top;
+    topCount = other.topCount;
+    size = other.size;
+    other.bottom = nullptr;
+    other.top = nullptr;
+    other.topCount = 0;
+    other.size = 0;
+    return *this;
+}
+
+template<class T, size_t B, class Alloc>
+inline bool TSegmentedStack<T, B, Alloc>::operator==(const TSegmentedStack& other)
+{
+    if (size != other.size)
+        return false;
+    for (iterator a = begin(), b = other.begin(); a != end(); ++a, ++b)
+        if (*a != *b)
+            return false;
+    return true;
+}
+
+template<class T, size_t B, class Alloc>
+inline bool TSegmentedStack<T, B, Alloc>::operator!=(const TSegmentedStack& other)
+{
+    return !(*this == other);
+}
+
+template<class T, size_t B, class Alloc>
+inline bool TSegmentedStack<T, B, Alloc>::IsEmpty()
+{
+    return size == 0;
+}
+
+template<class T, size_t B, class Alloc>
+inline size_t TSegmentedStack<T, B, Alloc>::SpareBlocks() const
+{
+    return chain.FreeCount();
+}
+
+template<class T, size_t B, class Alloc>
+inline size_t TSegmentedStack<T, B, Alloc>::AllocatedBlocks() const
+{
+    return chain.BlockCount();
+}
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedStack<T, B, Alloc>::ShrinkToFit()
+{
+    chain.Trim();
+}
+
+template<class T, size_t B, class Alloc>
+inline Alloc TSegmentedStack<T, B, Alloc>::GetAllocator() const
+{
+    return chain.GetAllocator();
+}
+
+template<class T, size_t B, class Alloc>
+inline typename TSegmentedStack<T, B, Alloc>::iterator TSegmentedStack<T, B, Alloc>::begin() const
+{
+    return iterator(bottom, 0, B);
+}
+
+template<class T, size_t B, class Alloc>
+inline typename TSegmentedStack<T, B, Alloc>::const_iterator TSegmentedStack<T, B, Alloc>::cbegin() const
+{
+    return const_iterator(bottom, 0, B);
+}
+
+template<class T, size_t B, class Alloc>
+inline typename TSegmentedStack<T, B, Alloc>::iterator TSegmentedStack<T, B, Alloc>::end() const
+{
+    return iterator(top, topCount, B);
+}
+
+template<class T, size_t B, class Alloc>
+inline typename TSegmentedStack<T, B, Alloc>::const_iterator TSegmentedStack<T, B, Alloc>::cend() const
+{
+    return const_iterator(top, topCount, B);
+}
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedStack<T, B, Alloc>::Put(const T& elem)
+{
+    Emplace(elem);
+}
+
+template<class T, size_t B, class Alloc>
+inline void TSegmentedStack<T, B, Alloc>::Put(T&& elem)
+{
+    Emplace(std::move(elem));
+}
+
+template<class T, size_t B, class Alloc>
+template<class... Args>
+inline T& TSegmentedStack<T, B, Alloc>::Emplace(Args&&... args)
+{
+    if (top == nullptr || topCount == B)
+        PushBlock();
+    T* slot;
+    try
+    {
+        slot = new (top->Items() + topCount) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        if (topCount == 0)
+            PopBlock();
+        throw;
+    }
+    topCount++;
+    size++;
+    return *slot;
+}
+
+template<class T, size_t B, class Alloc>
+template<class It>
+inline void TSegmentedStack<T, B, Alloc>::PutRange(It first, It last)
+{
+    for (; first != last; ++first)
+        Emplace(*first);
+}
+
+template<class T, size_t B, class Alloc>
+inline T TSegmentedStack<T, B, Alloc>::Get()
+{
+    if (size != 0)
+    {
+        T* slot = top->Items() + topCount - 1;
+        T elem(std::move(*slot));
+        slot->~T();
+        topCount--;
+        size--;
+        if (topCount == 0)
+            PopBlock();
+        return elem;
+    }
+    else
+        ERROR("empty_stack");
+}
+
+// PopN and PeekN copy the top n elements bottom-to-top, i.e. in the order they lie in the stack.
+template<class T, size_t B, class Alloc>
+inline size_t TSegmentedStack<T, B, Alloc>::PopN(T* out, size_t n)
+{
+    size_t count = n < size ? n : size;
+    for (size_t i = count; i > 0; --i)
+        out[i - 1] = Get();
+    return count;
+}
+
+template<class T, size_t B, class Alloc>
+inline size_t TSegmentedStack<T, B, Alloc>::PeekN(T* out, size_t n) const
+{
+    size_t count = n < size ? n : size;
+    TBlock* block = top;
+    size_t index = topCount;
+    for (size_t i = count; i > 0; --i)
+    {
+        if (index == 0)
+        {
+            block = block->prev;
+            index = B;
+        }
+        out[i - 1] = block->Items()[--index];
+    }
+    return count;
+}
+
+template<class T, size_t B, class Alloc>
+inline T& TSegmentedStack<T, B, Alloc>::Top()
+{
+    if (size != 0)
+        return top->Items()[topCount - 1];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t B, class Alloc>
+inline const T& TSegmentedStack<T, B, Alloc>::Top() const
+{
+    if (size != 0)
+        return top->Items()[topCount - 1];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t B, class Alloc>
+inline T TSegmentedStack<T, B, Alloc>::Min()
+{
+    if (size != 0)
+    {
+        iterator it = begin();
+        T min = *it;
+        for (++it; it != end(); ++it)
+            if (*it < min)
+                min = *it;
+        return min;
+    }
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t B, class Alloc>
+inline size_t TSegmentedStack<T, B, Alloc>::Size()
+{
+    return size;
+}
+
+template<class T, size_t B, class Alloc>
+void TSegmentedStack<T, B, Alloc>::WriteToFile(const TString& filename) const
+{
+    std::ofstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    file << size << std::endl;
+
+    for (const_iterator it = cbegin(); it != cend(); ++it)
+    {
+        file << *it << std::endl;
+    }
+
+    file.close();
+}
+
+template<class T, size_t B, class Alloc>
+void TSegmentedStack<T, B, Alloc>::ReadFromFile(const TString& filename)
+{
+    std::ifstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    size_t count;
+    file >> count;
+
+    Clear();
+
+    T element;
+    for (size_t i = 0; i < count; ++i)
+    {
+        file >> element;
+        Put(element);
+    }
+
+    file.close();
+}
+
+template<class T, size_t B, class Alloc>
+std::ostream& operator<<(std::ostream& os, const TSegmentedStack<T, B, Alloc>& stack)
+{
+    os << "[";
+    size_t i = 0;
+    for (auto it = stack.cbegin(); it != stack.cend(); ++it, ++i) {
+        os << *it;
+        if (i < stack.size - 1)
+            os << ", ";
+    }
+    os << "]";
+    return os;
+}
+
+template<class O, size_t M, class A>
+std::istream& operator>>(std::istream& is, TSegmentedStack<O, M, A>& stack)
+{
+    size_t count;
+    is >> count;
+
+    stack.Clear();
+
+    O element;
+    for (size_t i = 0; i < count; ++i)
+    {
+        is >> element;
+        stack.Put(element);
+    }
+
+    return is;
+}
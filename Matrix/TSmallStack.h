@@ -0,0 +1,531 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <memory>
+#include "TError.h"
+#include "TBlockOps.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+// Keeps up to N elements in an inline buffer and moves them to the heap only when the stack gets deeper;
+// from there the heap storage grows geometrically.
+template<class T, size_t N, class Alloc = std::allocator<T>>
+class TSmallStack {
+    static_assert(N > 0, "TSmallStack needs at least one inline slot");
+protected:
+    size_t start;
+    size_t capacity;
+    T* memory;
+    Alloc allocator;
+    alignas(T) unsigned char buffer[N * sizeof(T)];
+
+    T* Inline();
+    void MoveToStorage(T* target, size_t targetCapacity);
+    template<class... Args>
+    T& GrowAndEmplace(Args&&... args);
+    void StealFrom(TSmallStack& other);
+    void Release();
+public:
+    TSmallStack(const Alloc& allocator_ = Alloc());
+    TSmallStack(const TSmallStack& other);
+    TSmallStack(TSmallStack&& other) noexcept(std::is_nothrow_move_constructible<T>::value);
+    ~TSmallStack();
+
+    TSmallStack& operator=(const TSmallStack& other);
+    TSmallStack& operator=(TSmallStack&& other) noexcept(std::is_nothrow_move_constructible<T>::value);
+    bool operator==(const TSmallStack& other);
+    bool operator!=(const TSmallStack& other);
+
+    bool IsEmpty();
+    bool IsInline() const;
+    size_t Capacity() const;
+    Alloc GetAllocator() const;
+
+    void Reserve(size_t count);
+    void ShrinkToFit();
+
+    T& operator[] (size_t index);
+    const T& operator[] (size_t index) const;
+
+    T* begin() const;
+    const T* cbegin() const;
+    T* end() const;
+    const T* cend() const;
+
+    void Put(const T& elem);
+    void Put(T&& elem);
+    template<class... Args>
+    T& Emplace(Args&&... args);
+    template<class It>
+    void PutRange(It first, It last);
+    T Get();
+    size_t PopN(T* out, size_t n);
+    size_t PeekN(T* out, size_t n) const;
+    T& Top();
+    const T& Top() const;
+    T Min();
+    size_t Size();
+
+    void WriteToFile(const TString& filename) const;
+    void ReadFromFile(const TString& filename);
+
+    template<class U, size_t M, class A>
+    friend std::ostream& operator<<(std::ostream& os, const TSmallStack<U, M, A>& stack);
+    template<class O, size_t M, class A>
+    friend std::istream& operator>>(std::istream& is, TSmallStack<O, M, A>& stack);
+};
+
+template<class T, size_t N, class Alloc>
+inline T* TSmallStack<T, N, Alloc>::Inline()
+{
+    return reinterpret_cast<T*>(buffer);
+}
+
+template<class T, size_t N, class Alloc>
+inline void TSmallStack<T, N, Alloc>::MoveToStorage(T* target, size_t targetCapacity)
+{
+    UninitializedMove(target, memory, start);
+    DestroyRange(memory, start);
+    if (!IsInline())
+        DeallocateRaw(allocator, memory, capacity);
+    memory = target;
+    capacity = targetCapacity;
+}
+
+// The new element is built in the new block before the old ones move,
+// so an argument that refers into the stack itself stays valid.
+template<class T, size_t N, class Alloc>
+template<class... Args>
+inline T& TSmallStack<T, N, Alloc>::GrowAndEmplace(Args&&... args)
+{
+    size_t newCapacity = capacity * 2 > start + 1 ? capacity * 2 : start + 1;
+    T* target = AllocateRaw(allocator, newCapacity);
+    try
+    {
+        new (target + start) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        DeallocateRaw(allocator, target, newCapacity);
+        throw;
+    }
+    try
+    {
+        MoveToStorage(target, newCapacity);
+    }
+    catch (...)
+    {
+        target[start].~T();
+        DeallocateRaw(allocator, target, newCapacity);
+        throw;
+    }
+    start++;
+    return memory[start - 1];
+}
+
+template<class T, size_t N, class Alloc>
+inline void TSmallStack<T, N, Alloc>::StealFrom(TSmallStack& other)
+{
+    if (other.IsInline())
+    {
+        UninitializedMove(memory, other.memory, other.start);
+        start = other.start;
+        other.Release();
+    }
+    else
+    {
+        memory = other.memory;
+        capacity = other.capacity;
+        start = other.start;
+        other.memory = other.Inline();
+        other.capacity = N;
+        other.start = 0;
+    }
+}
+
+template<class T, size_t N, class Alloc>
+inline void TSmallStack<T, N, Alloc>::Release()
+{
+    DestroyRange(memory, start);
+    if (!IsInline())
+        DeallocateRaw(allocator, memory, capacity);
+    memory = Inline();
+    start = 0;
+    capacity = N;
+}
+
+template<class T, size_t N, class Alloc>
+inline TSmallStack<T, N, Alloc>::TSmallStack(const Alloc& allocator_) : start(0), capacity(N), allocator(allocator_)
+{
+    memory = Inline();
+}
+
+template<class T, size_t N, class Alloc>
+inline TSmallStack<T, N, Alloc>::TSmallStack(const TSmallStack& other) : start(0), capacity(N), allocator(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.allocator))
+{
+    memory = Inline();
+    Reserve(other.start);
+    try
+    {
+        UninitializedCopy(memory, other.memory, other.start);
+    }
+    catch (...)
+    {
+        Release();
+        throw;
+    }
+    start = other.start;
+}
+
+template<class T, size_t N, class Alloc>
+inline TSmallStack<T, N, Alloc>::TSmallStack(TSmallStack&& other) noexcept(std::is_nothrow_move_constructible<T>::value) : start(0), capacity(N), allocator(std::move(other.allocator))
+{
+    memory = Inline();
+    StealFrom(other);
+}
+
+template<class T, size_t N, class Alloc>
+inline TSmallStack<T, N, Alloc>::~TSmallStack()
+{
+    Release();
+}
+
+template<class T, size_t N, class Alloc>
+inline TSmallStack<T, N, Alloc>& TSmallStack<T, N, Alloc>::operator=(const TSmallStack& other)
+{
+    if (this != &other)
+    {
+        TSmallStack copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+template<class T, size_t N, class Alloc>
+inline TSmallStack<T, N, Alloc>& TSmallStack<T, N, Alloc>::operator=(TSmallStack&& other) noexcept(std::is_nothrow_move_constructible<T>::value)
+{
+    if (this == &other)
+        return *this;
+    Release();
+    if constexpr (!std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
+    {
+        if (!other.IsInline() && !(allocator == other.allocator))
+        {
+            memory = AllocateRaw(allocator, other.capacity);
+            capacity = other.capacity;
+            UninitializedMove(memory, other.memory, other.start);
+            start = other.start;
+            other.Release();
+            return *this;
+        }
+    }
+    else
+        allocator = std::move(other.allocator);
+    StealFrom(other);
+    return *this;
+}
+
+template<class T, size_t N, class Alloc>
+inline bool TSmallStack<T, N, Alloc>::operator==(const TSmallStack& other)
+{
+    if (start != other.start)
+        return false;
+    return BlockEqual(memory, other.memory, start);
+}
+
+template<class T, size_t N, class Alloc>
+inline bool TSmallStack<T, N, Alloc>::operator!=(const TSmallStack& other)
+{
+    return !(*this == other);
+}
+
+template<class T, size_t N, class Alloc>
+inline bool TSmallStack<T, N, Alloc>::IsEmpty()
+{
+    return start == 0;
+}
+
+template<class T, size_t N, class Alloc>
+inline bool TSmallStack<T, N, Alloc>::IsInline() const
+{
+    return memory == reinterpret_cast<const T*>(buffer);
+}
+
+template<class T, size_t N, class Alloc>
+inline size_t TSmallStack<T, N, Alloc>::Capacity() const
+{
+    return capacity;
+}
+
+template<class T, size_t N, class Alloc>
+inline Alloc TSmallStack<T, N, Alloc>::GetAllocator() const
+{
+    return allocator;
+}
+
+template<class T, size_t N, class Alloc>
+inline void TSmallStack<T, N, Alloc>::Reserve(size_t count)
+{
+    if (count <= capacity)
+        return;
+    T* target = AllocateRaw(allocator, count);
+    try
+    {
+        MoveToStorage(target, count);
+    }
+    catch (...)
+    {
+        DeallocateRaw(allocator, target, count);
+        throw;
+    }
+}
+
+template<class T, size_t N, class Alloc>
+inline void TSmallStack<T, N, Alloc>::ShrinkToFit()
+{
+    if (IsInline() || start == capacity)
+        return;
+    if (start <= N)
+    {
+        T* heap = memory;
+        size_t heapCapacity = capacity;
+        UninitializedMove(Inline(), heap, start);
+        DestroyRange(heap, start);
+        DeallocateRaw(allocator, heap, heapCapacity);
+        memory = Inline();
+        capacity = N;
+    }
+    else
+    {
+        T* target = AllocateRaw(allocator, start);
+        try
+        {
+            MoveToStorage(target, start);
+        }
+        catch (...)
+        {
+            DeallocateRaw(allocator, target, start);
+            throw;
+        }
+    }
+}
+
+template<class T, size_t N, class Alloc>
+inline T& TSmallStack<T, N, Alloc>:: operator[] (size_t index)
+{
+    if (index >= start)
+        ERROR("size_error");
+    return memory[index];
+}
+
+template<class T, size_t N, class Alloc>
+inline const T& TSmallStack<T, N, Alloc>:: operator[] (size_t index) const
+{
+    if (index >= start)
+        ERROR("size_error");
+    return memory[index];
+}
+
+template<class T, size_t N, class Alloc>
+inline T* TSmallStack<T, N, Alloc>::begin() const
+{
+    return memory;
+}
+
+template<class T, size_t N, class Alloc>
+inline const T* TSmallStack<T, N, Alloc>::cbegin() const
+{
+    return memory;
+}
+
+template<class T, size_t N, class Alloc>
+inline T* TSmallStack<T, N, Alloc>::end() const
+{
+    return memory+start;
+}
+
+template<class T, size_t N, class Alloc>
+inline const T* TSmallStack<T, N, Alloc>::cend() const
+{
+    return memory+start;
+}
+
+template<class T, size_t N, class Alloc>
+inline void TSmallStack<T, N, Alloc>::Put(const T& elem)
+{
+    Emplace(elem);
+}
+
+template<class T, size_t N, class Alloc>
+inline void TSmallStack<T, N, Alloc>::Put(T&& elem)
+{
+    Emplace(std::move(elem));
+}
+
+template<class T, size_t N, class Alloc>
+template<class... Args>
+inline T& TSmallStack<T, N, Alloc>::Emplace(Args&&... args)
+{
+    if (start == capacity)
+        return GrowAndEmplace(std::forward<Args>(args)...);
+    T* slot = new (memory + start) T(std::forward<Args>(args)...);
+    start++;
+    return *slot;
+}
+
+template<class T, size_t N, class Alloc>
+template<class It>
+inline void TSmallStack<T, N, Alloc>::PutRange(It first, It last)
+{
+    size_t count = static_cast<size_t>(std::distance(first, last));
+    if (count > capacity - start)
+        Reserve(start + count > capacity * 2 ? start + count : capacity * 2);
+    UninitializedCopyFrom(memory + start, first, count);
+    start += count;
+}
+
+template<class T, size_t N, class Alloc>
+inline T TSmallStack<T, N, Alloc>::Get()
+{
+    if (start != 0)
+    {
+        T elem(std::move(memory[start - 1]));
+        start--;
+        memory[start].~T();
+        return elem;
+    }
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t N, class Alloc>
+inline size_t TSmallStack<T, N, Alloc>::PopN(T* out, size_t n)
+{
+    size_t count = n < start ? n : start;
+    BlockMove(out, memory + start - count, count);
+    DestroyRange(memory + start - count, count);
+    start -= count;
+    return count;
+}
+
+template<class T, size_t N, class Alloc>
+inline size_t TSmallStack<T, N, Alloc>::PeekN(T* out, size_t n) const
+{
+    size_t count = n < start ? n : start;
+    BlockCopy(out, memory + start - count, count);
+    return count;
+}
+
+template<class T, size_t N, class Alloc>
+inline T& TSmallStack<T, N, Alloc>::Top()
+{
+    if(start!=0)
+        return memory[start - 1];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t N, class Alloc>
+inline const T& TSmallStack<T, N, Alloc>::Top() const
+{
+    if(start!=0)
+        return memory[start - 1];
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t N, class Alloc>
+inline T TSmallStack<T, N, Alloc>::Min()
+{
+    if (start != 0)
+    {
+        T min = memory[0];
+        for (size_t i = 1; i < start; ++i)
+            if (memory[i] < min)
+                min = memory[i];
+        return min;
+    }
+    else
+        ERROR("empty_stack");
+}
+
+template<class T, size_t N, class Alloc>
+inline size_t TSmallStack<T, N, Alloc>::Size()
+{
+    return start;
+}
+
+template<class T, size_t N, class Alloc>
+void TSmallStack<T, N, Alloc>::WriteToFile(const TString& filename) const
+{
+    std::ofstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    file << start << std::endl;
+
+    for (size_t i = 0; i < start; ++i)
+    {
+        file << memory[i] << std::endl;
+    }
+
+    file.close();
+}
+
+template<class T, size_t N, class Alloc>
+void TSmallStack<T, N, Alloc>::ReadFromFile(const TString& filename)
+{
+    std::ifstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    size_t count;
+    file >> count;
+
+    Release();
+    Reserve(count);
+
+    T element;
+    for (size_t i = 0; i < count; ++i)
+    {
+        file >> element;
+        new (memory + start) T(element);
+        start++;
+    }
+
+    file.close();
+}
+
+template<class T, size_t N, class Alloc>
+std::ostream& operator<<(std::ostream& os, const TSmallStack<T, N, Alloc>& stack)
+{
+    os << "[";
+    for (size_t i = 0; i < stack.start; ++i) {
+        os << stack.memory[i];
+        if (i < stack.start - 1)
+            os << ", ";
+    }
+    os << "]";
+    return os;
+}
+
+template<class O, size_t M, class A>
+std::istream& operator>>(std::istream& is, TSmallStack<O, M, A>& stack)
+{
+    size_t count;
+    is >> count;
+
+    stack.Release();
+    stack.Reserve(count);
+
+    O element;
+    for (size_t i = 0; i < count; ++i)
+    {
+        is >> element;
+        new (stack.memory + stack.start) O(element);
+        stack.start++;
+    }
+
+    return is;
+}
@@ -2,20 +2,58 @@
 
 #include <iostream>
 #include <fstream>
+#include <atomic>
+#include <memory>
+#include <vector>
 #include "TError.h"
+#include "TBlockOps.h"
+#include "TBinaryFormat.h"
+#include "TReduce.h"
 #define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
 
 #include <iostream>
 
-template<class T>
+// level is the mark's position among the live marks of its stack. serial is unique in the process, so a
+// mark never matches a later one that reuses its level, on this stack or on whatever is assigned to it.
+struct TStackMark
+{
+    size_t depth;
+    size_t level;
+    size_t serial;
+
+    static size_t NextSerial()
+    {
+        static std::atomic<size_t> serials(0);
+        return serials.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+};
+
+template<class T, class Alloc = std::allocator<T>>
 class TStack {
 protected:
     size_t start;
     size_t capacity;
     T* memory;
+    std::atomic<size_t>* shares;
+    bool unshareable;
+    // One entry per live mark, oldest first; low is the smallest depth since that mark and before the next one.
+    struct TMarkEntry
+    {
+        size_t serial;
+        size_t low;
+    };
+    std::vector<TMarkEntry> marks;
+    Alloc allocator;
+
+    void Allocate(size_t count);
+    void Detach();
+    void Leak();
+    void Release();
+    void TrackLow();
+    size_t CheckMark(TStackMark mark) const;
 public:
     TStack();
-    TStack(size_t size_);
+    TStack(size_t size_, const Alloc& allocator_ = Alloc());
     TStack(const TStack& other);
     TStack(TStack&& other) noexcept;
     ~TStack();
@@ -27,267 +65,673 @@ public:
 
     bool IsEmpty();
     bool IsFull();
+    bool IsShared() const;
+    Alloc GetAllocator() const;
 
-    T operator[] (size_t index) const;
+    T& operator[] (size_t index);
+    const T& operator[] (size_t index) const;
 
-    T* begin() const;
+    T* begin();
+    const T* begin() const;
     const T* cbegin() const;
-    T* end() const;
+    T* end();
+    const T* end() const;
     const T* cend() const;
 
-    void Put(T elem);
+    void Put(const T& elem);
+    void Put(T&& elem);
+    template<class... Args>
+    T& Emplace(Args&&... args);
+    template<class It>
+    void PutRange(It first, It last);
     T Get();
-    T Top();
-    T Min();
+    size_t PopN(T* out, size_t n);
+    size_t PeekN(T* out, size_t n) const;
+    T& Top();
+    const T& Top() const;
+    T Min() const;
+    T Max() const;
+    T Sum() const;
+    TMinMax<T> MinMax() const;
+    size_t ArgMin() const;
+    template<class Pool>
+    T Min(Pool& pool) const;
+    template<class Pool>
+    T Max(Pool& pool) const;
+    template<class Pool>
+    T Sum(Pool& pool) const;
+    template<class Pool>
+    TMinMax<T> MinMax(Pool& pool) const;
+    template<class Pool>
+    size_t ArgMin(Pool& pool) const;
     size_t Size();
 
+    TStackMark Mark();
+    void RollbackTo(TStackMark mark);
+    void Commit(TStackMark mark);
+
     void WriteToFile(const TString& filename) const;
+    void WriteToFile(const TString& filename, bool binary) const;
     void ReadFromFile(const TString& filename);
 
-    template<class U>
-    friend std::ostream& operator<<(std::ostream& os, const TStack<U>& stack);
-    template<class O>
-    friend std::istream& operator>>(std::istream& is, TStack<O>& stack);
+    template<class U, class A>
+    friend std::ostream& operator<<(std::ostream& os, const TStack<U, A>& stack);
+    template<class O, class A>
+    friend std::istream& operator>>(std::istream& is, TStack<O, A>& stack);
 };
 
-template<class T>
-inline TStack<T>::TStack() : start(0), capacity(0)
+template<class T, class Alloc>
+inline void TStack<T, Alloc>::Allocate(size_t count)
+{
+    memory = AllocateRaw(allocator, count);
+    capacity = count;
+    if (memory == nullptr)
+        return;
+    try
+    {
+        shares = AllocateShareCount(allocator);
+    }
+    catch (...)
+    {
+        DeallocateRaw(allocator, memory, capacity);
+        memory = nullptr;
+        capacity = 0;
+        throw;
+    }
+}
+
+template<class T, class Alloc>
+inline void TStack<T, Alloc>::Detach()
+{
+    if constexpr (std::is_copy_constructible<T>::value)
+    {
+        if (!IsShared())
+            return;
+        TStack<T, Alloc> own(capacity, allocator);
+        UninitializedCopy(own.memory, memory, start);
+        own.start = start;
+        own.marks.swap(marks);
+        *this = std::move(own);
+    }
+}
+
+template<class T, class Alloc>
+inline void TStack<T, Alloc>::Leak()
 {
+    Detach();
+    unshareable = true;
+}
+
+template<class T, class Alloc>
+inline void TStack<T, Alloc>::Release()
+{
+    if (DropShare(shares))
+    {
+        DestroyRange(memory, start);
+        DeallocateRaw(allocator, memory, capacity);
+        if (shares != nullptr)
+            DeallocateShareCount(allocator, shares);
+    }
     memory = nullptr;
+    shares = nullptr;
+    unshareable = false;
+    marks.clear();
+    start = 0;
+    capacity = 0;
 }
 
-template<class T>
-inline TStack<T>::TStack(size_t size_) : start(0), capacity(size_)
+template<class T, class Alloc>
+inline TStack<T, Alloc>::TStack() : start(0), capacity(0), shares(nullptr), unshareable(false)
 {
-    if (capacity)
-        memory = new T[capacity];
-    else
-        memory = nullptr;
+    memory = nullptr;
 }
 
-template<class T>
-inline TStack<T>::TStack(const TStack& other) : start(other.start), capacity(other.capacity)
+template<class T, class Alloc>
+inline TStack<T, Alloc>::TStack(size_t size_, const Alloc& allocator_) : start(0), capacity(0), shares(nullptr), unshareable(false), allocator(allocator_)
 {
-    memory = new T[capacity];
-    for (size_t i = 0; i < start; ++i)
-        memory[i] = other.memory[i];
+    Allocate(size_);
 }
 
-template<class T>
-inline TStack<T>::TStack(TStack&& other) noexcept
+template<class T, class Alloc>
+inline TStack<T, Alloc>::TStack(const TStack& other) : start(0), capacity(0), shares(nullptr), unshareable(false), allocator(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.allocator))
+{
+    marks = other.marks;
+    if (other.shares != nullptr && !other.unshareable && allocator == other.allocator)
+    {
+        other.shares->fetch_add(1, std::memory_order_relaxed);
+        shares = other.shares;
+        memory = other.memory;
+        capacity = other.capacity;
+        start = other.start;
+        return;
+    }
+    Allocate(other.capacity);
+    try
+    {
+        UninitializedCopy(memory, other.memory, other.start);
+    }
+    catch (...)
+    {
+        Release();
+        throw;
+    }
+    start = other.start;
+}
+
+template<class T, class Alloc>
+inline TStack<T, Alloc>::TStack(TStack&& other) noexcept : allocator(std::move(other.allocator))
 {
     start = other.start;
     capacity = other.capacity;
     memory = other.memory;
+    shares = other.shares;
+    unshareable = other.unshareable;
+    marks = std::move(other.marks);
+    other.marks.clear();
     other.memory = nullptr;
+    other.shares = nullptr;
+    other.unshareable = false;
     other.start = 0;
     other.capacity = 0;
 }
 
-template<class T>
-inline TStack<T>::~TStack()
+template<class T, class Alloc>
+inline TStack<T, Alloc>::~TStack()
 {
-    if (memory != 0)
-        delete[] memory;
-    start = 0;
-    capacity = 0;
+    Release();
 }
 
-template<class T>
-inline TStack<T>& TStack<T>::operator=(const TStack<T>& other)
+template<class T, class Alloc>
+inline TStack<T, Alloc>& TStack<T, Alloc>::operator=(const TStack<T, Alloc>& other)
 {
-    if (*this != other)
+    if (this != &other)
     {
-        start = other.start;
-        capacity = other.capacity;
-        memory = new T[capacity];
-        for (size_t i = 0; i < start; ++i)
-            memory[i] = other.memory[i];
+        TStack<T, Alloc> copy(other);
+        *this = std::move(copy);
     }
     return *this;
 }
 
-template<class T>
-inline TStack<T>& TStack<T>::operator=(TStack<T>&& other) noexcept
+template<class T, class Alloc>
+inline TStack<T, Alloc>& TStack<T, Alloc>::operator=(TStack<T, Alloc>&& other) noexcept
 {
-    if (*this != other)
+    if (this == &other)
+        return *this;
+    Release();
+    if constexpr (!std::allocator_traits<Alloc>::propagate_on_container_move_assignment::value)
     {
-        start = other.start;
-        capacity = other.capacity;
-        memory = other.memory;
-        other.memory = nullptr;
-        other.start = 0;
-        other.capacity = 0;
+        if (!(allocator == other.allocator))
+        {
+            Allocate(other.capacity);
+            if (other.IsShared())
+                UninitializedCopy(memory, other.memory, other.start);
+            else
+                UninitializedMove(memory, other.memory, other.start);
+            start = other.start;
+            marks = std::move(other.marks);
+            other.Release();
+            return *this;
+        }
     }
+    else
+        allocator = std::move(other.allocator);
+    start = other.start;
+    capacity = other.capacity;
+    memory = other.memory;
+    shares = other.shares;
+    unshareable = other.unshareable;
+    marks = std::move(other.marks);
+    other.marks.clear();
+    other.memory = nullptr;
+    other.shares = nullptr;
+    other.unshareable = false;
+    other.start = 0;
+    other.capacity = 0;
     return *this;
 }
 
-template<class T>
-inline bool TStack<T>::operator==(const TStack& other)
+template<class T, class Alloc>
+inline bool TStack<T, Alloc>::operator==(const TStack& other)
 {
     if (start != other.start || capacity != other.capacity)
         return false;
-    for (size_t i = 0; i < start; ++i)
-        if (memory[i] != other.memory[i])
-            return false;
-    return true;
+    if (memory == other.memory)
+        return true;
+    return BlockEqual(memory, other.memory, start);
 }
 
-template<class T>
-inline bool TStack<T>::operator!=(const TStack& other)
+template<class T, class Alloc>
+inline bool TStack<T, Alloc>::operator!=(const TStack& other)
 {
-    if (start != other.start || capacity != other.capacity)
-        return true;
-    for (size_t i = 0; i < start; ++i)
-        if (memory[i] != other.memory[i])
-            return true;
-    return false;
+    return !(*this == other);
 }
 
-template<class T>
-inline bool TStack<T>::IsEmpty()
+template<class T, class Alloc>
+inline bool TStack<T, Alloc>::IsEmpty()
 {
     return start == 0;
 }
 
-template<class T>
-inline bool TStack<T>::IsFull()
+template<class T, class Alloc>
+inline bool TStack<T, Alloc>::IsFull()
 {
     return start == capacity;
 }
 
-template<class T>
-inline T TStack<T>:: operator[] (size_t index) const
+template<class T, class Alloc>
+inline bool TStack<T, Alloc>::IsShared() const
+{
+    return shares != nullptr && shares->load(std::memory_order_acquire) > 1;
+}
+
+template<class T, class Alloc>
+inline Alloc TStack<T, Alloc>::GetAllocator() const
+{
+    return allocator;
+}
+
+template<class T, class Alloc>
+inline T& TStack<T, Alloc>:: operator[] (size_t index)
+{
+    if (index >= start)
+        ERROR("size_error");
+    Leak();
+    return memory[index];
+}
+
+template<class T, class Alloc>
+inline const T& TStack<T, Alloc>:: operator[] (size_t index) const
 {
     if (index >= start)
         ERROR("size_error");
     return memory[index];
 }
 
-template<class T>
-inline T* TStack<T>:: begin() const
+template<class T, class Alloc>
+inline T* TStack<T, Alloc>:: begin()
+{
+    Leak();
+    return memory;
+}
+
+template<class T, class Alloc>
+inline const T* TStack<T, Alloc>:: begin() const
 {
     return memory;
 }
 
-template<class T>
-inline const T* TStack<T>::cbegin() const
+template<class T, class Alloc>
+inline const T* TStack<T, Alloc>::cbegin() const
 {
     return memory;
 }
 
-template<class T>
-inline T* TStack<T>::end() const
+template<class T, class Alloc>
+inline T* TStack<T, Alloc>::end()
 {
+    Leak();
     return memory+start;
 }
 
-template<class T>
-inline const T* TStack<T>::cend() const
+template<class T, class Alloc>
+inline const T* TStack<T, Alloc>::end() const
 {
     return memory+start;
 }
 
-template<class T>
-inline void TStack<T>::Put(T elem)
+template<class T, class Alloc>
+inline const T* TStack<T, Alloc>::cend() const
+{
+    return memory+start;
+}
+
+template<class T, class Alloc>
+inline void TStack<T, Alloc>::Put(const T& elem)
 {
     if (start != capacity)
     {
-        memory[start] = elem;
+        Detach();
+        new (memory + start) T(elem);
         start++;
     }
     else
         ERROR("full_stack");
 }
 
-template<class T>
-inline T TStack<T>::Get()
+template<class T, class Alloc>
+inline void TStack<T, Alloc>::Put(T&& elem)
+{
+    if (start != capacity)
+    {
+        Detach();
+        new (memory + start) T(std::move(elem));
+        start++;
+    }
+    else
+        ERROR("full_stack");
+}
+
+template<class T, class Alloc>
+template<class... Args>
+inline T& TStack<T, Alloc>::Emplace(Args&&... args)
+{
+    if (start == capacity)
+        ERROR("full_stack");
+    Detach();
+    T* slot = new (memory + start) T(std::forward<Args>(args)...);
+    start++;
+    return *slot;
+}
+
+template<class T, class Alloc>
+inline T TStack<T, Alloc>::Get()
 {
     if (start != 0)
     {
+        Detach();
+        T elem(std::move(memory[start - 1]));
         start--;
-        return memory[start];
+        memory[start].~T();
+        TrackLow();
+        return elem;
     }
     else
         ERROR("empty_stack");
 }
 
-template<class T>
-inline T TStack<T>::Top()
+template<class T, class Alloc>
+template<class It>
+inline void TStack<T, Alloc>::PutRange(It first, It last)
+{
+    size_t count = static_cast<size_t>(std::distance(first, last));
+    if (count > capacity - start)
+        ERROR("full_stack");
+    Detach();
+    UninitializedCopyFrom(memory + start, first, count);
+    start += count;
+}
+
+// PopN and PeekN copy the top n elements bottom-to-top, i.e. in the order they lie in the stack.
+template<class T, class Alloc>
+inline size_t TStack<T, Alloc>::PopN(T* out, size_t n)
+{
+    size_t count = n < start ? n : start;
+    Detach();
+    BlockMove(out, memory + start - count, count);
+    DestroyRange(memory + start - count, count);
+    start -= count;
+    TrackLow();
+    return count;
+}
+
+template<class T, class Alloc>
+inline size_t TStack<T, Alloc>::PeekN(T* out, size_t n) const
 {
+    size_t count = n < start ? n : start;
+    BlockCopy(out, memory + start - count, count);
+    return count;
+}
+
+template<class T, class Alloc>
+inline T& TStack<T, Alloc>::Top()
+{
+    Leak();
     if(start!=0)
         return memory[start - 1];
     else
         ERROR("empty_stack");
 }
 
-template<class T>
-inline T TStack<T>::Min()
+template<class T, class Alloc>
+inline const T& TStack<T, Alloc>::Top() const
 {
-    if (start != 0)
-    {
-        T min = memory[0];
-        for (size_t i = 1; i < start; ++i)
-            if (memory[i] < min)
-                min = memory[i];
-        return min;
-    }
+    if(start!=0)
+        return memory[start - 1];
     else
         ERROR("empty_stack");
 }
 
-template<class T>
-inline size_t TStack<T>::Size()
+// Reductions run over the live prefix of the buffer; arithmetic T gets the vector kernels from TReduce.h.
+template<class T, class Alloc>
+inline T TStack<T, Alloc>::Min() const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return ReduceMin(memory, start);
+}
+
+template<class T, class Alloc>
+inline T TStack<T, Alloc>::Max() const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return ReduceMax(memory, start);
+}
+
+template<class T, class Alloc>
+inline T TStack<T, Alloc>::Sum() const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return ReduceSum(memory, start);
+}
+
+template<class T, class Alloc>
+inline TMinMax<T> TStack<T, Alloc>::MinMax() const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return ReduceMinMax(memory, start);
+}
+
+// Index from the bottom of the stack of the first smallest element.
+template<class T, class Alloc>
+inline size_t TStack<T, Alloc>::ArgMin() const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return ReduceArgMin(memory, start);
+}
+
+template<class T, class Alloc>
+template<class Pool>
+inline T TStack<T, Alloc>::Min(Pool& pool) const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return ParallelReduceMin(pool, memory, start);
+}
+
+template<class T, class Alloc>
+template<class Pool>
+inline T TStack<T, Alloc>::Max(Pool& pool) const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return ParallelReduceMax(pool, memory, start);
+}
+
+template<class T, class Alloc>
+template<class Pool>
+inline T TStack<T, Alloc>::Sum(Pool& pool) const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return ParallelReduceSum(pool, memory, start);
+}
+
+template<class T, class Alloc>
+template<class Pool>
+inline TMinMax<T> TStack<T, Alloc>::MinMax(Pool& pool) const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return ParallelReduceMinMax(pool, memory, start);
+}
+
+template<class T, class Alloc>
+template<class Pool>
+inline size_t TStack<T, Alloc>::ArgMin(Pool& pool) const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return ParallelReduceArgMin(pool, memory, start);
+}
+
+template<class T, class Alloc>
+inline size_t TStack<T, Alloc>::Size()
 {
     return start;
 }
 
-template<class T>
-void TStack<T>::WriteToFile(const TString& filename) const
+// Marks nest: RollbackTo keeps its mark and drops the ones taken after it, Commit drops both. A mark
+// stays usable for rollback only while the stack has not been popped below it, since the popped
+// elements are gone; RollbackTo then throws mark_error rather than restore the wrong elements.
+// RollbackTo destroys only what was pushed since, and is O(1) for trivially destructible T.
+template<class T, class Alloc>
+inline TStackMark TStack<T, Alloc>::Mark()
+{
+    size_t serial = TStackMark::NextSerial();
+    marks.push_back(TMarkEntry{serial, start});
+    return TStackMark{start, marks.size(), serial};
+}
+
+template<class T, class Alloc>
+inline void TStack<T, Alloc>::TrackLow()
+{
+    if (!marks.empty() && start < marks.back().low)
+        marks.back().low = start;
+}
+
+// Returns the smallest depth since the mark was taken.
+template<class T, class Alloc>
+inline size_t TStack<T, Alloc>::CheckMark(TStackMark mark) const
+{
+    if (mark.level == 0 || mark.level > marks.size() || marks[mark.level - 1].serial != mark.serial)
+        ERROR("mark_error");
+    size_t low = start;
+    for (size_t i = mark.level - 1; i < marks.size(); ++i)
+        if (marks[i].low < low)
+            low = marks[i].low;
+    return low;
+}
+
+template<class T, class Alloc>
+inline void TStack<T, Alloc>::RollbackTo(TStackMark mark)
 {
+    if (CheckMark(mark) < mark.depth)
+        ERROR("mark_error");
+    if (mark.depth != start)
+    {
+        Detach();
+        DestroyRange(memory + mark.depth, start - mark.depth);
+        start = mark.depth;
+    }
+    marks.resize(mark.level);
+    marks.back().low = start;
+}
+
+// Keeps everything done since the mark; the outer mark, if any, inherits the mark's low depth.
+template<class T, class Alloc>
+inline void TStack<T, Alloc>::Commit(TStackMark mark)
+{
+    size_t low = CheckMark(mark);
+    marks.resize(mark.level - 1);
+    if (!marks.empty() && low < marks.back().low)
+        marks.back().low = low;
+}
+
+template<class T, class Alloc>
+void TStack<T, Alloc>::WriteToFile(const TString& filename) const
+{
+    WriteToFile(filename, TBinaryCodec<T>::supported && start >= binaryFileThreshold);
+}
+
+template<class T, class Alloc>
+void TStack<T, Alloc>::WriteToFile(const TString& filename, bool binary) const
+{
+    if constexpr (TBinaryCodec<T>::supported)
+    {
+        if (binary)
+        {
+            std::ofstream file(filename.CStr(), std::ios::binary);
+            if (!file.is_open())
+                ERROR("file_open_error");
+            WriteSequence(file, "TSTACK", memory, start, memory, 0, capacity);
+            file.close();
+            return;
+        }
+    }
+    else if (binary)
+        ERROR("format_error");
+
     std::ofstream file(filename.CStr());
     if (!file.is_open())
         ERROR("file_open_error");
 
-    file << start << std::endl;
+    file << start << '\n';
 
     for (size_t i = 0; i < start; ++i)
     {
-        file << memory[i] << std::endl;
+        file << memory[i] << '\n';
     }
 
     file.close();
 }
 
-template<class T>
-void TStack<T>::ReadFromFile(const TString& filename)
+// Accepts both formats: a binary file is recognised by its magic and restores the capacity as well.
+// The file is loaded into a new container, so a damaged one leaves this one unchanged.
+template<class T, class Alloc>
+void TStack<T, Alloc>::ReadFromFile(const TString& filename)
 {
-    std::ifstream file(filename.CStr());
+    std::ifstream file(filename.CStr(), std::ios::binary);
     if (!file.is_open())
         ERROR("file_open_error");
 
-    size_t count;
-    file >> count;
-
-    if (memory != nullptr)
-        delete[] memory;
+    if (HasMagic(file, "TSTACK"))
+    {
+        if constexpr (TBinaryCodec<T>::supported)
+        {
+            TBinaryReader reader(file);
+            TSequenceHeader header = ReadSequenceHeader<T>(reader, "TSTACK");
+            TStack<T, Alloc> loaded(header.capacity, allocator);
+            TChecksum sum;
+            reader.Track(&sum);
+            TBinaryCodec<T>::Read(reader, loaded.memory, header.count, loaded.start);
+            if (sum.Finish() != header.dataChecksum)
+                ERROR("checksum_error");
+            *this = std::move(loaded);
+            file.close();
+            return;
+        }
+        else
+            ERROR("format_error");
+    }
+    file.close();
+    file.open(filename.CStr());
 
-    capacity = count;
-    start = 0;
-    memory = new T[capacity];
+    size_t count;
+    if (!(file >> count))
+        ERROR("format_error");
 
+    // The count only bounds the loop, so a bogus one runs out of elements instead of memory.
+    std::vector<T> elements;
     T element;
     for (size_t i = 0; i < count; ++i)
     {
-        file >> element;
-        memory[start++] = element;
+        if (!(file >> element))
+            ERROR("format_error");
+        elements.push_back(element);
     }
+    TStack<T, Alloc> loaded(elements.size(), allocator);
+    loaded.PutRange(elements.begin(), elements.end());
+    *this = std::move(loaded);
 
     file.close();
 }
 
-template<class T>
-std::ostream& operator<<(std::ostream& os, const TStack<T>& stack)
+template<class T, class Alloc>
+std::ostream& operator<<(std::ostream& os, const TStack<T, Alloc>& stack)
 {
     os << "[";
     for (size_t i = 0; i < stack.start; ++i) {
@@ -299,24 +743,21 @@ std::ostream& operator<<(std::ostream& os, const TStack<T>& stack)
     return os;
 }
 
-template<class O>
-std::istream& operator>>(std::istream& is, TStack<O>& stack)
+template<class O, class A>
+std::istream& operator>>(std::istream& is, TStack<O, A>& stack)
 {
     size_t count;
     is >> count;
 
-    if (stack.memory != nullptr)
-        delete[] stack.memory;
-
-    stack.capacity = count;
-    stack.start = 0;
-    stack.memory = new O[stack.capacity];
+    stack.Release();
+    stack.Allocate(count);
 
     O element;
     for (size_t i = 0; i < count; ++i)
     {
         is >> element;
-        stack.memory[stack.start++] = element;
+        new (stack.memory + stack.start) O(element);
+        stack.start++;
     }
 
     return is;
@@ -0,0 +1,356 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <utility>
+#include "TError.h"
+#include "TRingIterator.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+template<class T, size_t N>
+class TStaticQueue {
+protected:
+    size_t head;
+    size_t size;
+    T memory[N];
+
+    constexpr size_t Slot(size_t index) const;
+public:
+    typedef TRingIterator<T> iterator;
+    typedef TRingIterator<const T> const_iterator;
+
+    constexpr TStaticQueue();
+
+    constexpr bool operator==(const TStaticQueue& other) const;
+    constexpr bool operator!=(const TStaticQueue& other) const;
+
+    constexpr bool IsEmpty() const;
+    constexpr bool IsFull() const;
+    constexpr size_t Capacity() const;
+
+    constexpr T& operator[] (size_t index);
+    constexpr const T& operator[] (size_t index) const;
+
+    constexpr iterator begin();
+    constexpr const_iterator begin() const;
+    constexpr const_iterator cbegin() const;
+    constexpr iterator end();
+    constexpr const_iterator end() const;
+    constexpr const_iterator cend() const;
+
+    constexpr void Put(const T& elem);
+    constexpr void Put(T&& elem);
+    template<class... Args>
+    constexpr T& Emplace(Args&&... args);
+    template<class It>
+    constexpr void PutRange(It first, It last);
+    constexpr T Get();
+    constexpr size_t GetN(T* out, size_t n);
+    constexpr size_t PeekN(T* out, size_t n) const;
+    constexpr T& Head();
+    constexpr const T& Head() const;
+    constexpr T& Tail();
+    constexpr const T& Tail() const;
+    constexpr T Min() const;
+    constexpr size_t Size() const;
+
+    void WriteToFile(const TString& filename) const;
+    void ReadFromFile(const TString& filename);
+
+    template<class U, size_t M>
+    friend std::ostream& operator<<(std::ostream& os, const TStaticQueue<U, M>& queue);
+    template<class O, size_t M>
+    friend std::istream& operator>>(std::istream& is, TStaticQueue<O, M>& queue);
+};
+
+template<class T, size_t N>
+constexpr size_t TStaticQueue<T, N>::Slot(size_t index) const
+{
+    size_t slot = head + index;
+    return slot >= N ? slot - N : slot;
+}
+
+template<class T, size_t N>
+constexpr TStaticQueue<T, N>::TStaticQueue() : head(0), size(0), memory{}
+{
+}
+
+template<class T, size_t N>
+constexpr bool TStaticQueue<T, N>::operator==(const TStaticQueue& other) const
+{
+    if (size != other.size)
+        return false;
+    for (size_t i = 0; i < size; ++i)
+        if (!(memory[Slot(i)] == other.memory[other.Slot(i)]))
+            return false;
+    return true;
+}
+
+template<class T, size_t N>
+constexpr bool TStaticQueue<T, N>::operator!=(const TStaticQueue& other) const
+{
+    return !(*this == other);
+}
+
+template<class T, size_t N>
+constexpr bool TStaticQueue<T, N>::IsEmpty() const
+{
+    return size == 0;
+}
+
+template<class T, size_t N>
+constexpr bool TStaticQueue<T, N>::IsFull() const
+{
+    return size == N;
+}
+
+template<class T, size_t N>
+constexpr size_t TStaticQueue<T, N>::Capacity() const
+{
+    return N;
+}
+
+template<class T, size_t N>
+constexpr T& TStaticQueue<T, N>::operator[] (size_t index)
+{
+    if (index >= size)
+        ERROR("size_error");
+    return memory[Slot(index)];
+}
+
+template<class T, size_t N>
+constexpr const T& TStaticQueue<T, N>::operator[] (size_t index) const
+{
+    if (index >= size)
+        ERROR("size_error");
+    return memory[Slot(index)];
+}
+
+template<class T, size_t N>
+constexpr typename TStaticQueue<T, N>::iterator TStaticQueue<T, N>::begin()
+{
+    return iterator(memory, N, head);
+}
+
+template<class T, size_t N>
+constexpr typename TStaticQueue<T, N>::const_iterator TStaticQueue<T, N>::begin() const
+{
+    return const_iterator(memory, N, head);
+}
+
+template<class T, size_t N>
+constexpr typename TStaticQueue<T, N>::const_iterator TStaticQueue<T, N>::cbegin() const
+{
+    return const_iterator(memory, N, head);
+}
+
+template<class T, size_t N>
+constexpr typename TStaticQueue<T, N>::iterator TStaticQueue<T, N>::end()
+{
+    return iterator(memory, N, head + size);
+}
+
+template<class T, size_t N>
+constexpr typename TStaticQueue<T, N>::const_iterator TStaticQueue<T, N>::end() const
+{
+    return const_iterator(memory, N, head + size);
+}
+
+template<class T, size_t N>
+constexpr typename TStaticQueue<T, N>::const_iterator TStaticQueue<T, N>::cend() const
+{
+    return const_iterator(memory, N, head + size);
+}
+
+template<class T, size_t N>
+constexpr void TStaticQueue<T, N>::Put(const T& elem)
+{
+    if (size == N)
+        ERROR("full_queue");
+    memory[Slot(size)] = elem;
+    size++;
+}
+
+template<class T, size_t N>
+constexpr void TStaticQueue<T, N>::Put(T&& elem)
+{
+    if (size == N)
+        ERROR("full_queue");
+    memory[Slot(size)] = std::move(elem);
+    size++;
+}
+
+template<class T, size_t N>
+template<class... Args>
+constexpr T& TStaticQueue<T, N>::Emplace(Args&&... args)
+{
+    if (size == N)
+        ERROR("full_queue");
+    T& slot = memory[Slot(size)];
+    slot = T(std::forward<Args>(args)...);
+    size++;
+    return slot;
+}
+
+template<class T, size_t N>
+template<class It>
+constexpr void TStaticQueue<T, N>::PutRange(It first, It last)
+{
+    size_t count = static_cast<size_t>(std::distance(first, last));
+    if (count > N - size)
+        ERROR("full_queue");
+    for (; first != last; ++first)
+    {
+        memory[Slot(size)] = *first;
+        size++;
+    }
+}
+
+template<class T, size_t N>
+constexpr T TStaticQueue<T, N>::Get()
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    T elem = std::move(memory[head]);
+    head = Slot(1);
+    size--;
+    return elem;
+}
+
+template<class T, size_t N>
+constexpr size_t TStaticQueue<T, N>::GetN(T* out, size_t n)
+{
+    size_t count = n < size ? n : size;
+    for (size_t i = 0; i < count; ++i)
+        out[i] = std::move(memory[Slot(i)]);
+    head = Slot(count);
+    size -= count;
+    return count;
+}
+
+template<class T, size_t N>
+constexpr size_t TStaticQueue<T, N>::PeekN(T* out, size_t n) const
+{
+    size_t count = n < size ? n : size;
+    for (size_t i = 0; i < count; ++i)
+        out[i] = memory[Slot(i)];
+    return count;
+}
+
+template<class T, size_t N>
+constexpr T& TStaticQueue<T, N>::Head()
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    return memory[head];
+}
+
+template<class T, size_t N>
+constexpr const T& TStaticQueue<T, N>::Head() const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    return memory[head];
+}
+
+template<class T, size_t N>
+constexpr T& TStaticQueue<T, N>::Tail()
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    return memory[Slot(size - 1)];
+}
+
+template<class T, size_t N>
+constexpr const T& TStaticQueue<T, N>::Tail() const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    return memory[Slot(size - 1)];
+}
+
+template<class T, size_t N>
+constexpr T TStaticQueue<T, N>::Min() const
+{
+    if (size == 0)
+        ERROR("empty_stack");
+    T min = memory[head];
+    for (size_t i = 1; i < size; ++i)
+        if (memory[Slot(i)] < min)
+            min = memory[Slot(i)];
+    return min;
+}
+
+template<class T, size_t N>
+constexpr size_t TStaticQueue<T, N>::Size() const
+{
+    return size;
+}
+
+template<class T, size_t N>
+void TStaticQueue<T, N>::WriteToFile(const TString& filename) const
+{
+    std::ofstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    file << size << std::endl;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        file << memory[Slot(i)] << std::endl;
+    }
+
+    file.close();
+}
+
+template<class T, size_t N>
+void TStaticQueue<T, N>::ReadFromFile(const TString& filename)
+{
+    std::ifstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    size_t count;
+    file >> count;
+    if (count > N)
+        ERROR("full_queue");
+
+    head = 0;
+    size = 0;
+    for (size_t i = 0; i < count; ++i)
+        file >> memory[size++];
+
+    file.close();
+}
+
+template<class T, size_t N>
+std::ostream& operator<<(std::ostream& os, const TStaticQueue<T, N>& queue)
+{
+    os << "[";
+    for (size_t i = 0; i < queue.size; ++i) {
+        os << queue.memory[queue.Slot(i)];
+        if (i < queue.size - 1)
+            os << ", ";
+    }
+    os << "]";
+    return os;
+}
+
+template<class O, size_t M>
+std::istream& operator>>(std::istream& is, TStaticQueue<O, M>& queue)
+{
+    size_t count;
+    is >> count;
+    if (count > M)
+        ERROR("full_queue");
+
+    queue.head = 0;
+    queue.size = 0;
+    for (size_t i = 0; i < count; ++i)
+        is >> queue.memory[queue.size++];
+
+    return is;
+}
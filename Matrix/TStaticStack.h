@@ -0,0 +1,312 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <utility>
+#include "TError.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+template<class T, size_t N>
+class TStaticStack {
+protected:
+    size_t start;
+    T memory[N];
+public:
+    constexpr TStaticStack();
+
+    constexpr bool operator==(const TStaticStack& other) const;
+    constexpr bool operator!=(const TStaticStack& other) const;
+
+    constexpr bool IsEmpty() const;
+    constexpr bool IsFull() const;
+    constexpr size_t Capacity() const;
+
+    constexpr T& operator[] (size_t index);
+    constexpr const T& operator[] (size_t index) const;
+
+    constexpr T* begin();
+    constexpr const T* begin() const;
+    constexpr const T* cbegin() const;
+    constexpr T* end();
+    constexpr const T* end() const;
+    constexpr const T* cend() const;
+
+    constexpr void Put(const T& elem);
+    constexpr void Put(T&& elem);
+    template<class... Args>
+    constexpr T& Emplace(Args&&... args);
+    template<class It>
+    constexpr void PutRange(It first, It last);
+    constexpr T Get();
+    constexpr size_t PopN(T* out, size_t n);
+    constexpr size_t PeekN(T* out, size_t n) const;
+    constexpr T& Top();
+    constexpr const T& Top() const;
+    constexpr T Min() const;
+    constexpr size_t Size() const;
+
+    void WriteToFile(const TString& filename) const;
+    void ReadFromFile(const TString& filename);
+
+    template<class U, size_t M>
+    friend std::ostream& operator<<(std::ostream& os, const TStaticStack<U, M>& stack);
+    template<class O, size_t M>
+    friend std::istream& operator>>(std::istream& is, TStaticStack<O, M>& stack);
+};
+
+template<class T, size_t N>
+constexpr TStaticStack<T, N>::TStaticStack() : start(0), memory{}
+{
+}
+
+template<class T, size_t N>
+constexpr bool TStaticStack<T, N>::operator==(const TStaticStack& other) const
+{
+    if (start != other.start)
+        return false;
+    for (size_t i = 0; i < start; ++i)
+        if (!(memory[i] == other.memory[i]))
+            return false;
+    return true;
+}
+
+template<class T, size_t N>
+constexpr bool TStaticStack<T, N>::operator!=(const TStaticStack& other) const
+{
+    return !(*this == other);
+}
+
+template<class T, size_t N>
+constexpr bool TStaticStack<T, N>::IsEmpty() const
+{
+    return start == 0;
+}
+
+template<class T, size_t N>
+constexpr bool TStaticStack<T, N>::IsFull() const
+{
+    return start == N;
+}
+
+template<class T, size_t N>
+constexpr size_t TStaticStack<T, N>::Capacity() const
+{
+    return N;
+}
+
+template<class T, size_t N>
+constexpr T& TStaticStack<T, N>::operator[] (size_t index)
+{
+    if (index >= start)
+        ERROR("size_error");
+    return memory[index];
+}
+
+template<class T, size_t N>
+constexpr const T& TStaticStack<T, N>::operator[] (size_t index) const
+{
+    if (index >= start)
+        ERROR("size_error");
+    return memory[index];
+}
+
+template<class T, size_t N>
+constexpr T* TStaticStack<T, N>::begin()
+{
+    return memory;
+}
+
+template<class T, size_t N>
+constexpr const T* TStaticStack<T, N>::begin() const
+{
+    return memory;
+}
+
+template<class T, size_t N>
+constexpr const T* TStaticStack<T, N>::cbegin() const
+{
+    return memory;
+}
+
+template<class T, size_t N>
+constexpr T* TStaticStack<T, N>::end()
+{
+    return memory + start;
+}
+
+template<class T, size_t N>
+constexpr const T* TStaticStack<T, N>::end() const
+{
+    return memory + start;
+}
+
+template<class T, size_t N>
+constexpr const T* TStaticStack<T, N>::cend() const
+{
+    return memory + start;
+}
+
+template<class T, size_t N>
+constexpr void TStaticStack<T, N>::Put(const T& elem)
+{
+    if (start == N)
+        ERROR("full_stack");
+    memory[start++] = elem;
+}
+
+template<class T, size_t N>
+constexpr void TStaticStack<T, N>::Put(T&& elem)
+{
+    if (start == N)
+        ERROR("full_stack");
+    memory[start++] = std::move(elem);
+}
+
+template<class T, size_t N>
+template<class... Args>
+constexpr T& TStaticStack<T, N>::Emplace(Args&&... args)
+{
+    if (start == N)
+        ERROR("full_stack");
+    memory[start] = T(std::forward<Args>(args)...);
+    return memory[start++];
+}
+
+template<class T, size_t N>
+template<class It>
+constexpr void TStaticStack<T, N>::PutRange(It first, It last)
+{
+    size_t count = static_cast<size_t>(std::distance(first, last));
+    if (count > N - start)
+        ERROR("full_stack");
+    for (; first != last; ++first)
+        memory[start++] = *first;
+}
+
+template<class T, size_t N>
+constexpr T TStaticStack<T, N>::Get()
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    start--;
+    return std::move(memory[start]);
+}
+
+template<class T, size_t N>
+constexpr size_t TStaticStack<T, N>::PopN(T* out, size_t n)
+{
+    size_t count = n < start ? n : start;
+    for (size_t i = 0; i < count; ++i)
+        out[i] = std::move(memory[start - count + i]);
+    start -= count;
+    return count;
+}
+
+template<class T, size_t N>
+constexpr size_t TStaticStack<T, N>::PeekN(T* out, size_t n) const
+{
+    size_t count = n < start ? n : start;
+    for (size_t i = 0; i < count; ++i)
+        out[i] = memory[start - count + i];
+    return count;
+}
+
+template<class T, size_t N>
+constexpr T& TStaticStack<T, N>::Top()
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return memory[start - 1];
+}
+
+template<class T, size_t N>
+constexpr const T& TStaticStack<T, N>::Top() const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    return memory[start - 1];
+}
+
+template<class T, size_t N>
+constexpr T TStaticStack<T, N>::Min() const
+{
+    if (start == 0)
+        ERROR("empty_stack");
+    T min = memory[0];
+    for (size_t i = 1; i < start; ++i)
+        if (memory[i] < min)
+            min = memory[i];
+    return min;
+}
+
+template<class T, size_t N>
+constexpr size_t TStaticStack<T, N>::Size() const
+{
+    return start;
+}
+
+template<class T, size_t N>
+void TStaticStack<T, N>::WriteToFile(const TString& filename) const
+{
+    std::ofstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    file << start << std::endl;
+
+    for (size_t i = 0; i < start; ++i)
+    {
+        file << memory[i] << std::endl;
+    }
+
+    file.close();
+}
+
+template<class T, size_t N>
+void TStaticStack<T, N>::ReadFromFile(const TString& filename)
+{
+    std::ifstream file(filename.CStr());
+    if (!file.is_open())
+        ERROR("file_open_error");
+
+    size_t count;
+    file >> count;
+    if (count > N)
+        ERROR("full_stack");
+
+    start = 0;
+    for (size_t i = 0; i < count; ++i)
+        file >> memory[start++];
+
+    file.close();
+}
+
+template<class T, size_t N>
+std::ostream& operator<<(std::ostream& os, const TStaticStack<T, N>& stack)
+{
+    os << "[";
+    for (size_t i = 0; i < stack.start; ++i) {
+        os << stack.memory[i];
+        if (i < stack.start - 1)
+            os << ", ";
+    }
+    os << "]";
+    return os;
+}
+
+template<class O, size_t M>
+std::istream& operator>>(std::istream& is, TStaticStack<O, M>& stack)
+{
+    size_t count;
+    is >> count;
+    if (count > M)
+        ERROR("full_stack");
+
+    stack.start = 0;
+    for (size_t i = 0; i < count; ++i)
+        is >> stack.memory[stack.start++];
+
+    return is;
+}
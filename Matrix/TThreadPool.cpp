@@ -0,0 +1,194 @@
+#include "TThreadPool.h"
+
+namespace {
+    thread_local const TThreadPool* currentPool = nullptr;
+    thread_local size_t currentIndex = 0;
+    thread_local const TThreadPool* runningPool = nullptr;
+    thread_local size_t stealSeed = 0x9E3779B9u;
+
+    size_t NextVictim(size_t bound)
+    {
+        stealSeed ^= stealSeed << 13;
+        stealSeed ^= stealSeed >> 7;
+        stealSeed ^= stealSeed << 17;
+        return stealSeed % bound;
+    }
+}
+
+TThreadPool::TThreadPool() : TThreadPool(std::thread::hardware_concurrency())
+{
+}
+
+TThreadPool::TThreadPool(size_t threadCount_) : threadCount(threadCount_ ? threadCount_ : 1), injection(64), queued(0), pending(0), stopping(false)
+{
+    deques = new TWorkStealingDeque<TTask*>[threadCount];
+    threads = new std::thread[threadCount];
+    Start();
+}
+
+TThreadPool::~TThreadPool()
+{
+    Drain();
+    stopping.store(true);
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeUp.notify_all();
+    }
+    for (size_t i = 0; i < threadCount; ++i)
+        if (threads[i].joinable())
+            threads[i].join();
+    delete[] threads;
+    delete[] deques;
+}
+
+void TThreadPool::Start()
+{
+    for (size_t i = 0; i < threadCount; ++i)
+        threads[i] = std::thread(&TThreadPool::WorkerLoop, this, i);
+}
+
+void TThreadPool::WorkerLoop(size_t index)
+{
+    currentPool = this;
+    currentIndex = index;
+    stealSeed += index * 0x2545F491u;
+    while (true)
+    {
+        if (RunOne(index))
+            continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeUp.wait(lock, [this]() { return stopping.load() || queued.load(std::memory_order_acquire) != 0; });
+        if (stopping.load())
+            break;
+    }
+    currentPool = nullptr;
+}
+
+size_t TThreadPool::CurrentWorker() const
+{
+    return currentPool == this ? currentIndex : threadCount;
+}
+
+size_t TThreadPool::ThreadCount() const
+{
+    return threadCount;
+}
+
+size_t TThreadPool::Pending() const
+{
+    return pending.load();
+}
+
+void TThreadPool::Inject(TTask* task)
+{
+    std::lock_guard<std::mutex> lock(injectionMutex);
+    if (injection.IsFull())
+    {
+        TQueue<TTask*> grown(injection.Size() * 2);
+        while (!injection.IsEmpty())
+            grown.Put(injection.Get());
+        injection = std::move(grown);
+    }
+    injection.Put(task);
+}
+
+// queued counts the tasks not yet taken; Submit raises it before publishing a task, so it never underflows.
+TThreadPool::TTask* TThreadPool::FindTask(size_t self)
+{
+    TTask* task = TakeTask(self);
+    if (task != nullptr)
+        queued.fetch_sub(1, std::memory_order_acq_rel);
+    return task;
+}
+
+TThreadPool::TTask* TThreadPool::TakeTask(size_t self)
+{
+    TTask* task = nullptr;
+    if (self < threadCount && deques[self].Pop(task))
+        return task;
+    {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        if (!injection.IsEmpty())
+            return injection.Get();
+    }
+    size_t first = NextVictim(threadCount);
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        size_t victim = (first + i) % threadCount;
+        if (victim != self && deques[victim].Steal(task))
+            return task;
+    }
+    return nullptr;
+}
+
+bool TThreadPool::RunOne(size_t self)
+{
+    TTask* task = FindTask(self);
+    if (task == nullptr)
+        return false;
+    Run(task);
+    return true;
+}
+
+void TThreadPool::Run(TTask* task)
+{
+    const TThreadPool* outer = runningPool;
+    runningPool = this;
+    try
+    {
+        (*task)();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!firstError)
+            firstError = std::current_exception();
+    }
+    runningPool = outer;
+    delete task;
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        Notify();
+}
+
+// Taking the lock orders the wake-up after any sleeper's check of its condition, so none is lost.
+void TThreadPool::Notify()
+{
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    wakeUp.notify_all();
+}
+
+void TThreadPool::Submit(TTask task)
+{
+    if (!task)
+        ERROR("empty_task");
+    TTask* heapTask = new TTask(std::move(task));
+    pending.fetch_add(1, std::memory_order_acq_rel);
+    queued.fetch_add(1, std::memory_order_acq_rel);
+    size_t self = CurrentWorker();
+    if (self < threadCount)
+        deques[self].Push(heapTask);
+    else
+        Inject(heapTask);
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    wakeUp.notify_one();
+}
+
+void TThreadPool::Drain()
+{
+    HelpUntil([this]() { return pending.load(std::memory_order_acquire) == 0; });
+}
+
+// A task waiting for every task would wait for itself, whichever thread happens to run it.
+void TThreadPool::WaitAll()
+{
+    if (runningPool == this)
+        ERROR("wait_in_task");
+    Drain();
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        std::swap(error, firstError);
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
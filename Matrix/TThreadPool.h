@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "TError.h"
+#include "TQueue.h"
+#include "TWorkStealingDeque.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+class TThreadPool {
+public:
+    typedef std::function<void()> TTask;
+protected:
+    size_t threadCount;
+    std::thread* threads;
+    TWorkStealingDeque<TTask*>* deques;
+    TQueue<TTask*> injection;
+    std::mutex injectionMutex;
+    std::mutex sleepMutex;
+    // Workers and waiters sleep on wakeUp until a task is queued or what they wait for is done.
+    std::condition_variable wakeUp;
+    std::atomic<size_t> queued;
+    std::atomic<size_t> pending;
+    std::atomic<bool> stopping;
+    std::mutex errorMutex;
+    std::exception_ptr firstError;
+
+    void Start();
+    void WorkerLoop(size_t index);
+    size_t CurrentWorker() const;
+    void Inject(TTask* task);
+    TTask* FindTask(size_t self);
+    TTask* TakeTask(size_t self);
+    bool RunOne(size_t self);
+    void Run(TTask* task);
+    void Notify();
+    template<class Done>
+    void HelpUntil(Done done);
+    void Drain();
+public:
+    TThreadPool();
+    TThreadPool(size_t threadCount_);
+    TThreadPool(const TThreadPool& other) = delete;
+    ~TThreadPool();
+
+    TThreadPool& operator=(const TThreadPool& other) = delete;
+
+    size_t ThreadCount() const;
+    size_t Pending() const;
+
+    void Submit(TTask task);
+    void WaitAll();
+
+    template<class F>
+    void ParallelForRange(size_t first, size_t last, F func, size_t grain = 0);
+    template<class F>
+    void ParallelFor(size_t first, size_t last, F func, size_t grain = 0);
+};
+
+// Runs queued tasks on the calling thread until done() holds, sleeping while there is nothing to run.
+// Whoever makes done() true must call Notify().
+template<class Done>
+inline void TThreadPool::HelpUntil(Done done)
+{
+    size_t self = CurrentWorker();
+    while (!done())
+    {
+        if (RunOne(self))
+            continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeUp.wait(lock, [this, &done]() { return done() || queued.load(std::memory_order_acquire) != 0; });
+    }
+}
+
+template<class F>
+inline void TThreadPool::ParallelForRange(size_t first, size_t last, F func, size_t grain)
+{
+    if (first >= last)
+        return;
+    size_t total = last - first;
+    if (grain == 0)
+        grain = (total + threadCount * 4 - 1) / (threadCount * 4);
+    if (grain == 0)
+        grain = 1;
+
+    std::atomic<size_t> remaining((total + grain - 1) / grain);
+    std::mutex chunkErrorMutex;
+    std::exception_ptr chunkError;
+    for (size_t lo = first; lo < last; lo += grain)
+    {
+        size_t hi = (last - lo > grain) ? lo + grain : last;
+        Submit([&, lo, hi]()
+        {
+            try
+            {
+                func(lo, hi);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(chunkErrorMutex);
+                if (!chunkError)
+                    chunkError = std::current_exception();
+            }
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                Notify();
+        });
+    }
+
+    HelpUntil([&remaining]() { return remaining.load(std::memory_order_acquire) == 0; });
+
+    if (chunkError)
+        std::rethrow_exception(chunkError);
+}
+
+template<class F>
+inline void TThreadPool::ParallelFor(size_t first, size_t last, F func, size_t grain)
+{
+    ParallelForRange(first, last, [&func](size_t lo, size_t hi)
+    {
+        for (size_t i = lo; i < hi; ++i)
+            func(i);
+    }, grain);
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include "TError.h"
+#define ERROR(err,...) throw TError(err, __func__, __FILE__, __LINE__)
+
+
+template<class T>
+class TWorkStealingDeque {
+    static_assert(std::is_trivially_copyable<T>::value, "TWorkStealingDeque stores trivially copyable elements (e.g. pointers)");
+protected:
+    struct TBuffer {
+        int64_t capacity;
+        std::atomic<T>* slots;
+        TBuffer* previous;
+
+        TBuffer(int64_t capacity_, TBuffer* previous_);
+        ~TBuffer();
+        T Load(int64_t index) const;
+        void Store(int64_t index, T elem);
+        TBuffer* Grow(int64_t top, int64_t bottom);
+    };
+
+    alignas(64) std::atomic<int64_t> top;
+    alignas(64) std::atomic<int64_t> bottom;
+    alignas(64) std::atomic<TBuffer*> buffer;
+public:
+    TWorkStealingDeque();
+    TWorkStealingDeque(size_t capacity_);
+    TWorkStealingDeque(const TWorkStealingDeque& other) = delete;
+    ~TWorkStealingDeque();
+
+    TWorkStealingDeque& operator=(const TWorkStealingDeque& other) = delete;
+
+    bool IsEmpty() const;
+    size_t Size() const;
+    size_t Capacity() const;
+
+    void Push(T elem);
+    bool Pop(T& elem);
+    bool Steal(T& elem);
+};
+
+template<class T>
+inline TWorkStealingDeque<T>::TBuffer::TBuffer(int64_t capacity_, TBuffer* previous_) : capacity(capacity_), previous(previous_)
+{
+    slots = new std::atomic<T>[capacity];
+}
+
+template<class T>
+inline TWorkStealingDeque<T>::TBuffer::~TBuffer()
+{
+    delete[] slots;
+    if (previous != nullptr)
+        delete previous;
+}
+
+template<class T>
+inline T TWorkStealingDeque<T>::TBuffer::Load(int64_t index) const
+{
+    return slots[index & (capacity - 1)].load(std::memory_order_relaxed);
+}
+
+template<class T>
+inline void TWorkStealingDeque<T>::TBuffer::Store(int64_t index, T elem)
+{
+    slots[index & (capacity - 1)].store(elem, std::memory_order_relaxed);
+}
+
+template<class T>
+inline typename TWorkStealingDeque<T>::TBuffer* TWorkStealingDeque<T>::TBuffer::Grow(int64_t top, int64_t bottom)
+{
+    TBuffer* grown = new TBuffer(capacity * 2, this);
+    for (int64_t i = top; i < bottom; ++i)
+        grown->Store(i, Load(i));
+    return grown;
+}
+
+template<class T>
+inline TWorkStealingDeque<T>::TWorkStealingDeque() : TWorkStealingDeque(64)
+{
+}
+
+template<class T>
+inline TWorkStealingDeque<T>::TWorkStealingDeque(size_t capacity_) : top(0), bottom(0)
+{
+    int64_t rounded = 1;
+    while (rounded < static_cast<int64_t>(capacity_))
+        rounded <<= 1;
+    buffer.store(new TBuffer(rounded, nullptr), std::memory_order_relaxed);
+}
+
+template<class T>
+inline TWorkStealingDeque<T>::~TWorkStealingDeque()
+{
+    delete buffer.load(std::memory_order_relaxed);
+}
+
+template<class T>
+inline bool TWorkStealingDeque<T>::IsEmpty() const
+{
+    return Size() == 0;
+}
+
+template<class T>
+inline size_t TWorkStealingDeque<T>::Size() const
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_relaxed);
+    return b > t ? static_cast<size_t>(b - t) : 0;
+}
+
+template<class T>
+inline size_t TWorkStealingDeque<T>::Capacity() const
+{
+    return static_cast<size_t>(buffer.load(std::memory_order_relaxed)->capacity);
+}
+
+template<class T>
+inline void TWorkStealingDeque<T>::Push(T elem)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    TBuffer* a = buffer.load(std::memory_order_relaxed);
+    if (b - t > a->capacity - 1)
+    {
+        a = a->Grow(t, b);
+        buffer.store(a, std::memory_order_release);
+    }
+    a->Store(b, elem);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+template<class T>
+inline bool TWorkStealingDeque<T>::Pop(T& elem)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    TBuffer* a = buffer.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b)
+    {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+    elem = a->Load(b);
+    if (t == b)
+    {
+        bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+    return true;
+}
+
+template<class T>
+inline bool TWorkStealingDeque<T>::Steal(T& elem)
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return false;
+    TBuffer* a = buffer.load(std::memory_order_acquire);
+    T stolen = a->Load(t);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return false;
+    elem = stolen;
+    return true;
+}
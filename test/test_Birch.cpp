@@ -3,8 +3,102 @@
 #include "TQueue.h"
 #include "TStack.h"
 #include "TMultyStack.h"
+#include "TWorkStealingDeque.h"
+#include "TThreadPool.h"
+#include "TConcurrentMultyStack.h"
+#include "TBroadcastRing.h"
+#include "TPoolAllocator.h"
+#include "TStaticStack.h"
+#include "TStaticQueue.h"
+#include "TSmallStack.h"
+#include "TSegmentedStack.h"
+#include "TSegmentedQueue.h"
+#include "TPersistentStack.h"
+#include "TPersistentQueue.h"
+#include "TDeque.h"
+#include "TPriorityQueue.h"
+#include "TMultyQueue.h"
+#include "TMappedMultyStack.h"
 
 #include <gtest.h>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <sstream>
+
+struct TCounted
+{
+    static int alive;
+    int value;
+    TCounted(int value_ = 0) : value(value_) { alive++; }
+    TCounted(const TCounted& other) : value(other.value) { alive++; }
+    ~TCounted() { alive--; }
+    TCounted& operator=(const TCounted& other) { value = other.value; return *this; }
+    bool operator!=(const TCounted& other) const { return value != other.value; }
+    bool operator<(const TCounted& other) const { return value < other.value; }
+};
+
+int TCounted::alive = 0;
+
+// Allocator whose allocations start failing once budget runs out; a negative budget never runs out.
+struct TAllocBudget
+{
+    static int left;
+};
+
+int TAllocBudget::left = -1;
+
+template<class T>
+struct TFailingAllocator
+{
+    typedef T value_type;
+
+    TFailingAllocator() = default;
+    template<class U>
+    TFailingAllocator(const TFailingAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        if (TAllocBudget::left == 0)
+            throw std::bad_alloc();
+        if (TAllocBudget::left > 0)
+            TAllocBudget::left--;
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) { std::allocator<T>().deallocate(p, n); }
+    template<class U>
+    bool operator==(const TFailingAllocator<U>&) const { return true; }
+    template<class U>
+    bool operator!=(const TFailingAllocator<U>&) const { return false; }
+};
+
+constexpr bool BracketsBalanced(const char* text)
+{
+    TStaticStack<char, 16> open;
+    for (; *text != '\0'; ++text)
+    {
+        if (*text == '(' || *text == '[')
+            open.Put(*text);
+        else if (*text == ')' || *text == ']')
+        {
+            if (open.IsEmpty() || open.Get() != (*text == ')' ? '(' : '['))
+                return false;
+        }
+    }
+    return open.IsEmpty();
+}
+
+constexpr int RotateQueue(int steps)
+{
+    TStaticQueue<int, 3> queue;
+    queue.Put(1);
+    queue.Put(2);
+    queue.Put(3);
+    for (int i = 0; i < steps; ++i)
+        queue.Put(queue.Get());
+    return queue.Head() * 100 + queue[1] * 10 + queue.Tail();
+}
 
 TEST(TQueue, can_create_queue_with_positive_capacity)
 {
@@ -282,6 +376,233 @@ TEST(TQueue, can_load_from_file)
     EXPECT_TRUE(queue == loadedQueue);
 }
 
+TEST(TQueue, read_rejects_huge_text_count)
+{
+    std::ofstream("test_queue.txt") << "100000000000000\n1\n2\n";
+    TQueue<int> loaded(1);
+    loaded.Put(7);
+    ASSERT_ANY_THROW(loaded.ReadFromFile("test_queue.txt"));
+    EXPECT_EQ(1, loaded.Size());
+    EXPECT_EQ(7, loaded.Head());
+}
+
+TEST(TQueue, binary_file_keeps_wrapped_order)
+{
+    TQueue<int> queue(4);
+    queue.Put(1);
+    queue.Put(2);
+    queue.Put(3);
+    queue.Get();
+    queue.Get();
+    queue.Put(4);
+    queue.Put(5);
+    queue.WriteToFile("test_queue.bin", true);
+
+    TQueue<int> loaded;
+    loaded.ReadFromFile("test_queue.bin");
+    EXPECT_TRUE(queue == loaded);
+    EXPECT_EQ(3, loaded.Get());
+    loaded.Put(6);
+    loaded.Put(7);
+    EXPECT_TRUE(loaded.IsFull());
+}
+
+TEST(TQueue, writes_binary_file_only_for_large_queues)
+{
+    TQueue<int> small(3);
+    small.Put(1);
+    small.WriteToFile("test_queue.txt");
+    std::ifstream text("test_queue.txt");
+    EXPECT_EQ('1', text.get());
+    text.close();
+
+    TQueue<int> large(5000);
+    for (int i = 0; i < 5000; ++i)
+        large.Put(i);
+    large.WriteToFile("test_queue.bin");
+    std::ifstream binary("test_queue.bin", std::ios::binary);
+    EXPECT_EQ('T', binary.get());
+    binary.close();
+
+    TQueue<int> loaded;
+    loaded.ReadFromFile("test_queue.bin");
+    EXPECT_TRUE(large == loaded);
+}
+
+TEST(TQueue, keeps_order_across_wraparound)
+{
+    TQueue<int> queue(3);
+    queue.Put(1);
+    queue.Put(2);
+    EXPECT_EQ(1, queue.Get());
+    queue.Put(3);
+    queue.Put(4);
+
+    EXPECT_TRUE(queue.IsFull());
+    EXPECT_EQ(2, queue.Head());
+    EXPECT_EQ(4, queue.Tail());
+    EXPECT_EQ(3, queue[1]);
+    int sum = 0;
+    for (auto it = queue.begin(); it != queue.end(); ++it)
+        sum += *it;
+    EXPECT_EQ(9, sum);
+    EXPECT_EQ(2, queue.Get());
+    EXPECT_EQ(3, queue.Get());
+    EXPECT_EQ(4, queue.Get());
+}
+
+TEST(TQueue, can_put_range)
+{
+    TQueue<int> queue(4);
+    int values[] = { 1, 2, 3 };
+    queue.Put(0);
+    queue.Get();
+    queue.Put(0);
+    queue.Get();
+
+    queue.PutRange(values, values + 3);
+    EXPECT_EQ(3, queue.Size());
+    EXPECT_EQ(1, queue.Get());
+    EXPECT_EQ(2, queue.Get());
+    EXPECT_EQ(3, queue.Get());
+}
+
+TEST(TQueue, throw_put_range_when_not_enough_space)
+{
+    TQueue<int> queue(2);
+    int values[] = { 1, 2, 3 };
+
+    ASSERT_ANY_THROW(queue.PutRange(values, values + 3));
+    EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(TQueue, can_get_and_peek_n_across_wraparound)
+{
+    TQueue<TString> queue(4);
+    queue.Put("x");
+    queue.Put("x");
+    queue.Get();
+    queue.Get();
+    TString values[] = { "a", "b", "c" };
+    queue.PutRange(values, values + 3);
+
+    TString out[4];
+    EXPECT_EQ(3, queue.PeekN(out, 4));
+    EXPECT_EQ(3, queue.Size());
+    EXPECT_TRUE(out[2] == "c");
+    EXPECT_EQ(2, queue.GetN(out, 2));
+    EXPECT_TRUE(out[0] == "a");
+    EXPECT_TRUE(out[1] == "b");
+    EXPECT_TRUE(queue.Head() == "c");
+    EXPECT_EQ(1, queue.GetN(out, 2));
+    EXPECT_EQ(0, queue.GetN(out, 2));
+}
+
+TEST(TQueue, can_store_move_only_elements)
+{
+    TQueue<std::unique_ptr<int>> queue(2);
+    queue.Put(std::unique_ptr<int>(new int(1)));
+    queue.Emplace(new int(2));
+
+    EXPECT_EQ(2, *queue.Tail());
+    std::unique_ptr<int> head = queue.Get();
+    EXPECT_EQ(1, *head);
+    EXPECT_EQ(2, *queue.Head());
+}
+
+TEST(TQueue, head_and_tail_return_references)
+{
+    TQueue<TString> queue(2);
+    queue.Emplace("ab");
+    queue.Emplace(3, 'c');
+    queue.Head() += "x";
+    queue.Tail() = "d";
+
+    EXPECT_TRUE(queue[0] == "abx");
+    EXPECT_TRUE(queue.Get() == "abx");
+    EXPECT_TRUE(queue.Get() == "d");
+}
+
+TEST(TQueue, reserving_capacity_constructs_no_elements)
+{
+    TCounted::alive = 0;
+    {
+        TQueue<TCounted> queue(1000);
+        EXPECT_EQ(0, TCounted::alive);
+        queue.Put(TCounted(1));
+        queue.Put(TCounted(2));
+        EXPECT_EQ(2, TCounted::alive);
+        queue.Get();
+        EXPECT_EQ(1, TCounted::alive);
+        TQueue<TCounted> copy(queue);
+        EXPECT_EQ(1, TCounted::alive);
+        copy.Emplace(3);
+        EXPECT_EQ(3, TCounted::alive);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TQueue, equality_compares_logical_order_across_wraparound)
+{
+    TQueue<int> wrapped(3);
+    wrapped.Put(0);
+    wrapped.Put(0);
+    wrapped.Get();
+    wrapped.Get();
+    wrapped.Put(1);
+    wrapped.Put(2);
+    TQueue<int> straight(3);
+    straight.Put(1);
+    straight.Put(2);
+
+    EXPECT_TRUE(wrapped == straight);
+    straight.Put(3);
+    wrapped.Put(4);
+    EXPECT_TRUE(wrapped != straight);
+}
+
+TEST(TQueue, reductions_cover_wrapped_ring)
+{
+    TQueue<float> queue(100);
+    for (int i = 0; i < 100; ++i)
+        queue.Put(static_cast<float>(i));
+    for (int i = 0; i < 60; ++i)
+        queue.Get();
+    for (int i = 0; i < 50; ++i)
+        queue.Put(static_cast<float>(i == 30 ? -1 : 200 + i));
+
+    EXPECT_EQ(-1.0f, queue.Min());
+    EXPECT_EQ(249.0f, queue.Max());
+    EXPECT_EQ(70, queue.ArgMin());
+    TMinMax<float> range = queue.MinMax();
+    EXPECT_EQ(-1.0f, range.min);
+    EXPECT_EQ(249.0f, range.max);
+
+    TQueue<int> small(4);
+    small.Put(3);
+    small.Put(1);
+    EXPECT_EQ(4, small.Sum());
+    EXPECT_EQ(1, small.ArgMin());
+}
+
+TEST(TQueue, parallel_reductions_match_sequential)
+{
+    TThreadPool pool(2);
+    TQueue<int> queue(300000);
+    for (int i = 0; i < 300000; ++i)
+        queue.Put(i % 1000);
+    for (int i = 0; i < 1000; ++i)
+        queue.Get();
+    for (int i = 0; i < 1000; ++i)
+        queue.Put(i - 5);
+
+    EXPECT_EQ(-5, queue.Min(pool));
+    EXPECT_EQ(queue.Max(), queue.Max(pool));
+    EXPECT_EQ(queue.Sum(), queue.Sum(pool));
+    EXPECT_EQ(299000, queue.ArgMin(pool));
+    EXPECT_EQ(queue.ArgMin(), queue.ArgMin(pool));
+}
+
 TEST(TStack, can_create_stack_with_positive_capacity)
 {
     ASSERT_NO_THROW(TStack<int> stack(5));
@@ -540,6 +861,380 @@ TEST(TStack, can_load_from_file)
     EXPECT_TRUE(stack == loadedStack);
 }
 
+TEST(TStack, binary_file_keeps_strings)
+{
+    TStack<TString> stack(5);
+    stack.Put(TString(""));
+    stack.Put(TString("ab"));
+    stack.Put(TString("hello world"));
+    stack.WriteToFile("test_stack.bin", true);
+
+    TStack<TString> loaded;
+    loaded.ReadFromFile("test_stack.bin");
+    EXPECT_EQ(3, loaded.Size());
+    EXPECT_TRUE(loaded.Get() == "hello world");
+    EXPECT_TRUE(loaded.Get() == "ab");
+    EXPECT_TRUE(loaded.Get() == "");
+    loaded.Put(TString("x"));
+    loaded.Put(TString("y"));
+    loaded.Put(TString("z"));
+    loaded.Put(TString("w"));
+    loaded.Put(TString("v"));
+    EXPECT_TRUE(loaded.IsFull());
+}
+
+TEST(TStack, read_rejects_damaged_binary_file)
+{
+    TStack<int> stack(2000);
+    for (int i = 0; i < 1500; ++i)
+        stack.Put(i);
+    stack.WriteToFile("test_stack.bin");
+
+    std::fstream file("test_stack.bin", std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(-1, std::ios::end);
+    file.put('\x7f');
+    file.close();
+    TStack<int> loaded;
+    ASSERT_ANY_THROW(loaded.ReadFromFile("test_stack.bin"));
+
+    stack.WriteToFile("test_stack.bin");
+    TStack<double> other;
+    ASSERT_ANY_THROW(other.ReadFromFile("test_stack.bin"));
+    loaded.ReadFromFile("test_stack.bin");
+    EXPECT_TRUE(stack == loaded);
+}
+
+TEST(TStack, failed_read_leaves_stack_unchanged)
+{
+    TStack<TString> stack(3);
+    stack.Put(TString("a"));
+    stack.Put(TString("bc"));
+    stack.WriteToFile("test_stack.bin", true);
+    std::fstream file("test_stack.bin", std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(-1, std::ios::end);
+    file.put('x');
+    file.close();
+
+    TStack<TString> loaded(1);
+    loaded.Put(TString("kept"));
+    ASSERT_ANY_THROW(loaded.ReadFromFile("test_stack.bin"));
+    EXPECT_EQ(1, loaded.Size());
+    EXPECT_TRUE(loaded.Top() == "kept");
+}
+
+TEST(TStack, read_rejects_huge_capacity)
+{
+    TStack<int> stack(4);
+    stack.Put(1);
+    stack.WriteToFile("test_stack.bin", true);
+    TSequenceHeader header;
+    std::fstream file("test_stack.bin", std::ios::binary | std::ios::in | std::ios::out);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    header.capacity = 1ull << 40;
+    header.headerChecksum = header.OwnChecksum();
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+
+    TStack<int> loaded;
+    ASSERT_ANY_THROW(loaded.ReadFromFile("test_stack.bin"));
+    EXPECT_TRUE(loaded.IsEmpty());
+}
+
+TEST(TStack, read_rejects_huge_text_count)
+{
+    std::ofstream("test_stack.txt") << "100000000000000\n1\n2\n";
+    TStack<int> loaded(1);
+    loaded.Put(7);
+    ASSERT_ANY_THROW(loaded.ReadFromFile("test_stack.txt"));
+    EXPECT_EQ(1, loaded.Size());
+    EXPECT_EQ(7, loaded.Top());
+}
+
+TEST(TStack, can_put_range)
+{
+    TStack<int> stack(4);
+    int values[] = { 1, 2, 3 };
+    stack.Put(0);
+
+    stack.PutRange(values, values + 3);
+    EXPECT_TRUE(stack.IsFull());
+    EXPECT_EQ(3, stack.Top());
+    ASSERT_ANY_THROW(stack.PutRange(values, values + 1));
+}
+
+TEST(TStack, can_pop_and_peek_n)
+{
+    TStack<double> stack(5);
+    for (int i = 1; i <= 5; ++i)
+        stack.Put(i);
+
+    double out[5];
+    EXPECT_EQ(2, stack.PeekN(out, 2));
+    EXPECT_EQ(5, stack.Size());
+    EXPECT_EQ(3, stack.PopN(out, 3));
+    EXPECT_EQ(3, out[0]);
+    EXPECT_EQ(5, out[2]);
+    EXPECT_EQ(2, stack.Top());
+    EXPECT_EQ(2, stack.PopN(out, 10));
+    EXPECT_TRUE(stack.IsEmpty());
+}
+
+TEST(TStack, can_store_move_only_elements)
+{
+    TStack<std::unique_ptr<int>> stack(2);
+    stack.Put(std::unique_ptr<int>(new int(1)));
+    stack.Emplace(new int(2));
+
+    EXPECT_EQ(2, *stack.Top());
+    std::unique_ptr<int> top = stack.Get();
+    EXPECT_EQ(2, *top);
+    EXPECT_EQ(1, *stack.Get());
+}
+
+TEST(TStack, top_returns_reference)
+{
+    TStack<TString> stack(2);
+    TString& emplaced = stack.Emplace(2, 'a');
+    emplaced += "b";
+    stack.Top() += "c";
+
+    EXPECT_TRUE(stack[0] == "aabc");
+    stack.Emplace("x");
+    ASSERT_ANY_THROW(stack.Emplace("z"));
+}
+
+TEST(TStack, reserving_capacity_constructs_no_elements)
+{
+    TCounted::alive = 0;
+    {
+        TStack<TCounted> stack(1000);
+        EXPECT_EQ(0, TCounted::alive);
+        stack.Emplace(1);
+        stack.Emplace(2);
+        EXPECT_EQ(2, TCounted::alive);
+        stack.Get();
+        EXPECT_EQ(1, TCounted::alive);
+        TStack<TCounted> copy;
+        copy = stack;
+        EXPECT_EQ(1, TCounted::alive);
+        copy.Emplace(3);
+        EXPECT_EQ(3, TCounted::alive);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TStack, equality_uses_element_comparison)
+{
+    TStack<double> positive(1);
+    TStack<double> negative(1);
+    positive.Put(0.0);
+    negative.Put(-0.0);
+    TStack<TString> first(2);
+    TStack<TString> second(2);
+    first.Put("ab");
+    second.Put("ab");
+
+    EXPECT_TRUE(positive == negative);
+    EXPECT_TRUE(first == second);
+    second.Top() = "ac";
+    EXPECT_TRUE(first != second);
+}
+
+TEST(TStack, rollback_restores_depth_at_mark)
+{
+    TCounted::alive = 0;
+    {
+        TStack<TCounted> stack(10);
+        stack.Emplace(1);
+        TStackMark mark = stack.Mark();
+        stack.Emplace(2);
+        stack.Emplace(3);
+
+        stack.RollbackTo(mark);
+        EXPECT_EQ(1, stack.Size());
+        EXPECT_EQ(1, stack.Top().value);
+        EXPECT_EQ(1, TCounted::alive);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TStack, nested_marks_roll_back_independently)
+{
+    TStack<int> stack(10);
+    stack.Put(1);
+    TStackMark outer = stack.Mark();
+    stack.Put(2);
+    TStackMark inner = stack.Mark();
+    stack.Put(3);
+
+    stack.RollbackTo(inner);
+    EXPECT_EQ(2, stack.Top());
+    stack.Put(4);
+    stack.Commit(inner);
+    EXPECT_EQ(3, stack.Size());
+
+    stack.RollbackTo(outer);
+    EXPECT_EQ(1, stack.Top());
+    ASSERT_ANY_THROW(stack.RollbackTo(inner));
+}
+
+TEST(TStack, rollback_throws_after_popping_below_mark)
+{
+    TStack<int> stack(10);
+    stack.Put(1);
+    stack.Put(2);
+    stack.Put(3);
+    TStackMark mark = stack.Mark();
+    stack.Get();
+    stack.Put(99);
+
+    ASSERT_ANY_THROW(stack.RollbackTo(mark));
+    EXPECT_EQ(99, stack.Top());
+    stack.Commit(mark);
+    ASSERT_ANY_THROW(stack.Commit(mark));
+}
+
+TEST(TStack, pop_below_inner_mark_breaks_outer_marks_only_below_it)
+{
+    TStack<int> stack(10);
+    stack.Put(1);
+    TStackMark outer = stack.Mark();
+    stack.Put(2);
+    stack.Put(3);
+    TStackMark inner = stack.Mark();
+    stack.Get();
+    stack.Put(4);
+
+    ASSERT_ANY_THROW(stack.RollbackTo(inner));
+    stack.Commit(inner);
+    stack.RollbackTo(outer);
+    EXPECT_EQ(1, stack.Size());
+    EXPECT_EQ(1, stack.Top());
+
+    stack.Get();
+    stack.Put(5);
+    ASSERT_ANY_THROW(stack.RollbackTo(outer));
+    TStackMark fresh = stack.Mark();
+    stack.Put(6);
+    stack.RollbackTo(fresh);
+    EXPECT_EQ(5, stack.Top());
+}
+
+TEST(TStack, commit_releases_nested_marks)
+{
+    TStack<int> stack(10);
+    TStackMark outer = stack.Mark();
+    stack.Put(1);
+    TStackMark inner = stack.Mark();
+    stack.Put(2);
+
+    stack.Commit(outer);
+    ASSERT_ANY_THROW(stack.RollbackTo(inner));
+    ASSERT_ANY_THROW(stack.RollbackTo(outer));
+    TStackMark next = stack.Mark();
+    ASSERT_ANY_THROW(stack.Commit(outer));
+    stack.Put(3);
+    stack.RollbackTo(next);
+    EXPECT_EQ(2, stack.Size());
+}
+
+TEST(TStack, mark_taken_before_assignment_is_rejected)
+{
+    TStack<int> stack(10);
+    TStackMark stale = stack.Mark();
+    stack.Put(1);
+    TStack<int> other(10);
+    other.Put(7);
+    other.Put(8);
+    other.Put(9);
+
+    stack = other;
+    TStackMark fresh = stack.Mark();
+    stack.Put(10);
+    ASSERT_ANY_THROW(stack.RollbackTo(stale));
+    EXPECT_EQ(4, stack.Size());
+    stack.RollbackTo(fresh);
+    EXPECT_EQ(3, stack.Size());
+}
+
+TEST(TStack, rollback_does_not_touch_shared_copies)
+{
+    TStack<int> stack(4);
+    stack.Put(1);
+    TStackMark mark = stack.Mark();
+    stack.Put(2);
+    TStack<int> snapshot(stack);
+
+    stack.RollbackTo(mark);
+    EXPECT_EQ(1, stack.Size());
+    EXPECT_EQ(2, snapshot.Size());
+    EXPECT_EQ(2, snapshot.Top());
+}
+
+TEST(TStack, reductions_match_scalar_loop)
+{
+    TStack<int> stack(1000);
+    int expectedSum = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        int value = (i * 7919) % 1000 - 500;
+        stack.Put(value);
+        expectedSum += value;
+    }
+
+    EXPECT_EQ(-500, stack.Min());
+    EXPECT_EQ(499, stack.Max());
+    EXPECT_EQ(expectedSum, stack.Sum());
+    TMinMax<int> range = stack.MinMax();
+    EXPECT_EQ(-500, range.min);
+    EXPECT_EQ(499, range.max);
+    EXPECT_EQ(-500, stack[stack.ArgMin()]);
+}
+
+TEST(TStack, reductions_work_for_floating_and_other_types)
+{
+    TStack<double> numbers(37);
+    for (int i = 0; i < 37; ++i)
+        numbers.Put(i == 29 ? -0.5 : i * 0.25);
+    EXPECT_EQ(-0.5, numbers.Min());
+    EXPECT_EQ(29, numbers.ArgMin());
+    EXPECT_EQ(9.0, numbers.Max());
+
+    TStack<TString> words(3);
+    words.Put(TString("pear"));
+    words.Put(TString("apple"));
+    words.Put(TString("plum"));
+    TString min = words.Min();
+    EXPECT_TRUE(min == "apple");
+    EXPECT_EQ(1, words.ArgMin());
+}
+
+TEST(TStack, reductions_throw_on_empty_stack)
+{
+    TStack<int> stack(4);
+    ASSERT_ANY_THROW(stack.Min());
+    ASSERT_ANY_THROW(stack.Sum());
+    ASSERT_ANY_THROW(stack.ArgMin());
+}
+
+TEST(TStack, parallel_reductions_match_sequential)
+{
+    TThreadPool pool(2);
+    TStack<int64_t> stack(300000);
+    for (int64_t i = 0; i < 300000; ++i)
+        stack.Put((i * 104729) % 300000);
+
+    EXPECT_EQ(stack.Min(), stack.Min(pool));
+    EXPECT_EQ(stack.Max(), stack.Max(pool));
+    EXPECT_EQ(stack.Sum(), stack.Sum(pool));
+    EXPECT_EQ(stack.ArgMin(), stack.ArgMin(pool));
+    EXPECT_EQ(0, stack[stack.ArgMin(pool)]);
+    TMinMax<int64_t> range = stack.MinMax(pool);
+    EXPECT_EQ(0, range.min);
+    EXPECT_EQ(299999, range.max);
+}
+
 TEST(TMultyStack, can_create_with_positive_parameters)
 {
     ASSERT_NO_THROW(TMultyStack<int> stack(3, 5));
@@ -808,4 +1503,2044 @@ TEST(TMultyStack, maintains_lifo_order_within_each_stack)
     EXPECT_EQ(1, stack.Pop(0));
     EXPECT_EQ(4, stack.Pop(1));
     EXPECT_EQ(3, stack.Pop(1));
-}
\ No newline at end of file
+}
+
+TEST(TMultyStack, can_store_move_only_elements)
+{
+    TMultyStack<std::unique_ptr<int>> stack(2, 2);
+    stack.Emplace(1, new int(3));
+    stack.Push(0, std::unique_ptr<int>(new int(1)));
+    stack.Emplace(0, new int(2));
+    stack.Emplace(0, new int(4));
+
+    EXPECT_EQ(4, *stack.Top(0));
+    EXPECT_EQ(1, *stack(0, 0));
+    EXPECT_EQ(4, *stack.Pop(0));
+    EXPECT_EQ(3, *stack.Pop(1));
+}
+
+TEST(TMultyStack, top_returns_reference)
+{
+    TMultyStack<int> stack(2, 2);
+    stack.Push(1, 5);
+    stack.Top(1) = 7;
+    stack(1, 0) += 1;
+
+    EXPECT_EQ(8, stack.Pop(1));
+    ASSERT_ANY_THROW(stack.Top(1));
+}
+
+TEST(TMultyStack, reserving_capacity_constructs_no_elements)
+{
+    TCounted::alive = 0;
+    {
+        TMultyStack<TCounted> stack(3, 1000);
+        EXPECT_EQ(0, TCounted::alive);
+        stack.Emplace(0, 1);
+        stack.Emplace(2, 2);
+        stack.Pop(0);
+        EXPECT_EQ(1, TCounted::alive);
+        TMultyStack<TCounted> copy(stack);
+        EXPECT_EQ(2, TCounted::alive);
+        EXPECT_EQ(2, copy(2, 0).value);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TMultyStack, repack_relocates_only_live_elements)
+{
+    TCounted::alive = 0;
+    {
+        TMultyStack<TCounted> stack(3, 2);
+        stack.Emplace(0, 1);
+        stack.Emplace(1, 2);
+        stack.Emplace(2, 3);
+        stack.Emplace(2, 4);
+        stack.Emplace(2, 5);
+        stack.Emplace(0, 6);
+        EXPECT_EQ(6, TCounted::alive);
+        EXPECT_EQ(6, stack.Top(0).value);
+        EXPECT_EQ(1, stack(0, 0).value);
+        EXPECT_EQ(2, stack.Top(1).value);
+        EXPECT_EQ(5, stack.Top(2).value);
+        EXPECT_EQ(3, stack(2, 0).value);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TMultyStack, put_of_own_element_survives_repack)
+{
+    TMultyStack<std::string> stack(3, 2);
+    stack.Push(1, std::string(40, 'B'));
+    stack.Push(1, std::string(40, 'b'));
+    stack.Push(0, std::string(40, 'A'));
+    stack.Push(0, std::string(40, 'a'));
+    ASSERT_TRUE(stack.IsFull(0) && stack.IsFull(1));
+    stack.Push(0, stack.Top(1));
+
+    EXPECT_EQ(std::string(40, 'b'), stack.Pop(0));
+    EXPECT_EQ(std::string(40, 'a'), stack.Top(0));
+    EXPECT_EQ(std::string(40, 'b'), stack.Top(1));
+    EXPECT_EQ(std::string(40, 'B'), stack(1, 0));
+}
+
+TEST(TMultyStack, can_save_and_load_file)
+{
+    TMultyStack<double> stack(3, 4);
+    stack.Push(0, 1.5);
+    stack.Push(2, 2.5);
+    stack.Push(2, 3.5);
+    stack.SaveToFile("test_multystack.bin");
+
+    TMultyStack<double> loaded;
+    loaded.LoadFromFile("test_multystack.bin");
+    EXPECT_TRUE(stack == loaded);
+    EXPECT_EQ(3.5, loaded.Pop(2));
+    EXPECT_TRUE(stack != loaded);
+}
+
+TEST(TMultyStack, can_create_with_per_stack_capacities)
+{
+    TMultyStack<int> stack(std::vector<size_t>{ 4, 1, 3 });
+    EXPECT_EQ(8, stack.Capacity());
+    EXPECT_EQ(3, stack.Count());
+    EXPECT_EQ(4, stack.Capacity(0));
+    EXPECT_EQ(1, stack.Capacity(1));
+    EXPECT_EQ(3, stack.Capacity(2));
+
+    for (int i = 0; i < 4; ++i)
+        stack.Push(0, i);
+    EXPECT_TRUE(stack.IsFull(0));
+    EXPECT_EQ(1, stack.Capacity(1));
+}
+
+TEST(TMultyStack, can_create_with_weights)
+{
+    TMultyStack<int> stack(10, std::vector<double>{ 1, 3, 1 });
+    EXPECT_EQ(10, stack.Capacity());
+    EXPECT_EQ(2, stack.Capacity(0));
+    EXPECT_EQ(6, stack.Capacity(1));
+    EXPECT_EQ(2, stack.Capacity(2));
+}
+
+TEST(TMultyStack, throw_create_with_negative_weight)
+{
+    ASSERT_ANY_THROW(TMultyStack<int> stack(10, std::vector<double>{ 1, -1 }));
+    ASSERT_ANY_THROW(TMultyStack<int> stack(10, std::vector<double>{ 0, 0 }));
+}
+
+TEST(TMultyStack, throw_create_with_non_finite_weight)
+{
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    double inf = std::numeric_limits<double>::infinity();
+    ASSERT_ANY_THROW(TMultyStack<int> stack(10, std::vector<double>{ 1, nan }));
+    ASSERT_ANY_THROW(TMultyStack<int> stack(10, std::vector<double>{ inf, 1 }));
+    ASSERT_ANY_THROW(TMultyStack<int> stack(10, std::vector<double>{ 1e308, 1e308 }));
+}
+
+TEST(TMultyStack, adaptive_repack_follows_push_rate)
+{
+    TMultyStack<int> stack(4, 25);
+    EXPECT_FALSE(stack.IsAdaptive());
+    stack.SetAdaptive(true);
+    stack.Push(0, -1);
+    stack.Push(2, -2);
+    stack.Push(3, -3);
+    for (int i = 0; i < 26; ++i)
+        stack.Push(1, i);
+
+    EXPECT_LE(80, stack.Capacity(1));
+    EXPECT_LE(2, stack.Capacity(0));
+    EXPECT_EQ(-1, stack.Top(0));
+    EXPECT_EQ(-2, stack.Top(2));
+    EXPECT_EQ(-3, stack.Top(3));
+    for (int i = 25; i >= 0; --i)
+        EXPECT_EQ(i, stack.Pop(1));
+
+    TMultyStack<int> copy(stack);
+    EXPECT_TRUE(copy.IsAdaptive());
+}
+
+TEST(TMultyStack, adaptive_repack_keeps_elements_alive)
+{
+    TCounted::alive = 0;
+    {
+        TMultyStack<TCounted> stack(3, 2);
+        stack.SetAdaptive(true);
+        size_t targets[] = { 2, 2, 0, 2, 2, 0 };
+        for (int i = 0; i < 6; ++i)
+            stack.Emplace(targets[i], i);
+        EXPECT_EQ(6, TCounted::alive);
+        EXPECT_EQ(0, stack.Size(1));
+        EXPECT_EQ(2, stack.Size(0));
+        EXPECT_EQ(5, stack.Top(0).value);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TMultyStack, transfer_moves_top_block_in_order)
+{
+    TMultyStack<int> stack(3, 4);
+    for (int i = 0; i < 4; ++i)
+        stack.Push(0, i);
+    stack.Push(2, 10);
+
+    stack.Transfer(0, 2, 3);
+    EXPECT_EQ(1, stack.Size(0));
+    EXPECT_EQ(4, stack.Size(2));
+    EXPECT_EQ(10, stack(2, 0));
+    EXPECT_EQ(1, stack(2, 1));
+    EXPECT_EQ(3, stack.Top(2));
+    ASSERT_ANY_THROW(stack.Transfer(0, 1, 2));
+    ASSERT_ANY_THROW(stack.Transfer(0, 3, 1));
+}
+
+TEST(TMultyStack, transfer_repacks_once_when_target_is_full)
+{
+    TMultyStack<TString> stack(3, 2);
+    stack.Push(0, TString("a"));
+    stack.Push(0, TString("b"));
+    stack.Push(1, TString("c"));
+    stack.Push(1, TString("d"));
+
+    stack.Transfer(0, 1, 2);
+    EXPECT_TRUE(stack.IsEmpty(0));
+    EXPECT_EQ(4, stack.Size(1));
+    EXPECT_TRUE(stack(1, 2) == "a");
+    EXPECT_TRUE(stack.Top(1) == "b");
+}
+
+TEST(TMultyStack, transfer_works_when_buffer_is_full)
+{
+    TCounted::alive = 0;
+    {
+        TMultyStack<TCounted> stack(2, 3);
+        for (int i = 0; i < 3; ++i)
+        {
+            stack.Emplace(0, i);
+            stack.Emplace(1, 10 + i);
+        }
+        stack.Transfer(1, 0, 3);
+        EXPECT_EQ(6, TCounted::alive);
+        EXPECT_EQ(6, stack.Size(0));
+        EXPECT_EQ(10, stack(0, 3).value);
+        EXPECT_EQ(12, stack.Top(0).value);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TMultyStack, failed_transfer_puts_elements_back)
+{
+    TCounted::alive = 0;
+    {
+        TMultyStack<TCounted, TFailingAllocator<TCounted>> stack(2, 3);
+        for (int i = 0; i < 3; ++i)
+        {
+            stack.Emplace(0, i);
+            stack.Emplace(1, 10 + i);
+        }
+        TAllocBudget::left = 1;
+        ASSERT_ANY_THROW(stack.Transfer(1, 0, 3));
+        TAllocBudget::left = -1;
+
+        EXPECT_EQ(6, TCounted::alive);
+        EXPECT_EQ(3, stack.Size(0));
+        EXPECT_EQ(3, stack.Size(1));
+        EXPECT_EQ(10, stack(1, 0).value);
+        EXPECT_EQ(12, stack.Top(1).value);
+        stack.Transfer(1, 0, 3);
+        EXPECT_EQ(12, stack.Top(0).value);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TMultyStack, can_push_range)
+{
+    TMultyStack<int> stack(3, 2);
+    stack.Push(1, 7);
+    int values[] = { 1, 2, 3, 4 };
+    stack.PushRange(0, values, values + 4);
+
+    EXPECT_EQ(4, stack.Size(0));
+    EXPECT_EQ(4, stack.Top(0));
+    EXPECT_EQ(7, stack.Top(1));
+    ASSERT_ANY_THROW(stack.PushRange(2, values, values + 2));
+    std::vector<int> one{ 5 };
+    stack.PushRange(2, one.begin(), one.end());
+    EXPECT_EQ(5, stack.Top(2));
+}
+
+TEST(TMultyStack, reserve_makes_room_in_one_step)
+{
+    TMultyStack<int> stack(4, 2);
+    stack.Push(3, 1);
+    stack.Reserve(1, 6);
+    EXPECT_LE(6, stack.Capacity(1));
+    EXPECT_EQ(1, stack.Top(3));
+    ASSERT_ANY_THROW(stack.Reserve(1, 8));
+}
+
+TEST(TMultyStack, find_min_follows_push_and_pop)
+{
+    TMultyStack<int> stack(3, 4);
+    ASSERT_ANY_THROW(stack.FindMin());
+    stack.Push(0, 5);
+    stack.Push(1, 7);
+    stack.Push(2, 3);
+    stack.Push(0, 2);
+    stack.Push(1, 1);
+
+    EXPECT_EQ(1, stack.FindMin());
+    EXPECT_EQ(2, stack.Min(0));
+    EXPECT_EQ(1, stack.Min(1));
+    stack.Pop(1);
+    EXPECT_EQ(2, stack.FindMin());
+    EXPECT_EQ(7, stack.Min(1));
+    stack.Pop(0);
+    EXPECT_EQ(3, stack.FindMin());
+    EXPECT_EQ(5, stack.Min(0));
+    ASSERT_ANY_THROW(stack.Min(3));
+}
+
+TEST(TMultyStack, find_min_survives_repack_and_transfer)
+{
+    TMultyStack<int> stack(4, 3);
+    for (int i = 10; i > 4; --i)
+        stack.Push(1, i);
+    stack.Push(3, 8);
+
+    EXPECT_EQ(5, stack.FindMin());
+    EXPECT_EQ(5, stack.Min(1));
+    stack.Transfer(1, 3, 2);
+    EXPECT_EQ(7, stack.Min(1));
+    EXPECT_EQ(5, stack.Min(3));
+    int values[] = { 4, 9 };
+    stack.PushRange(0, values, values + 2);
+    EXPECT_EQ(4, stack.FindMin());
+}
+
+TEST(TMultyStack, find_min_sees_changes_through_references)
+{
+    TMultyStack<int> stack(2, 3);
+    stack.Push(0, 4);
+    stack.Push(0, 6);
+    stack.Push(1, 5);
+    EXPECT_EQ(4, stack.FindMin());
+
+    stack(0, 0) = 9;
+    EXPECT_EQ(5, stack.FindMin());
+    stack.Top(1) = 1;
+    EXPECT_EQ(1, stack.Min(1));
+    EXPECT_EQ(1, stack.FindMin());
+}
+
+TEST(TMultyStack, find_min_sees_changes_through_emplaced_reference)
+{
+    TMultyStack<int> stack(2, 3);
+    stack.Push(0, 5);
+    int& emplaced = stack.Emplace(0, 10);
+    emplaced = -3;
+    EXPECT_EQ(-3, stack.Min(0));
+    EXPECT_EQ(-3, stack.FindMin());
+}
+
+TEST(TMultyStack, find_min_works_after_copy_and_load)
+{
+    TMultyStack<double> stack(2, 2);
+    stack.Push(0, 2.5);
+    stack.Push(1, 1.5);
+    TMultyStack<double> copy(stack);
+    EXPECT_EQ(1.5, copy.FindMin());
+
+    stack.SaveToFile("test_multystack_min.bin");
+    TMultyStack<double> loaded;
+    loaded.LoadFromFile("test_multystack_min.bin");
+    EXPECT_EQ(1.5, loaded.FindMin());
+    EXPECT_EQ(2.5, loaded.Min(0));
+}
+
+TEST(TMultyStack, load_rejects_damaged_file)
+{
+    TMultyStack<int> stack(2, 3);
+    stack.Push(0, 1);
+    stack.Push(1, 2);
+    stack.SaveToFile("test_multystack_damaged.bin");
+
+    std::fstream file("test_multystack_damaged.bin", std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(-1, std::ios::end);
+    file.put('\x7f');
+    file.close();
+    TMultyStack<int> loaded(1, 2);
+    loaded.Push(0, 9);
+    ASSERT_ANY_THROW(loaded.LoadFromFile("test_multystack_damaged.bin"));
+    EXPECT_EQ(2, loaded.Capacity());
+    EXPECT_EQ(9, loaded.Top(0));
+
+    std::ofstream("test_multystack_damaged.bin", std::ios::binary) << "TMSTACK";
+    ASSERT_ANY_THROW(loaded.LoadFromFile("test_multystack_damaged.bin"));
+    TMultyStack<double> other;
+    stack.SaveToFile("test_multystack_damaged.bin");
+    ASSERT_ANY_THROW(other.LoadFromFile("test_multystack_damaged.bin"));
+}
+
+TEST(TMultyStack, sparse_file_keeps_only_stored_elements)
+{
+    TMultyStack<int> stack(std::vector<size_t>{ 1000, 1000, 1000 });
+    stack.Push(0, 1);
+    stack.Push(2, 2);
+    stack.Push(2, 3);
+    stack.SaveToFile("test_multystack_sparse.bin", true);
+    stack.SaveToFile("test_multystack_dense.bin");
+
+    std::ifstream sparse("test_multystack_sparse.bin", std::ios::binary | std::ios::ate);
+    std::ifstream dense("test_multystack_dense.bin", std::ios::binary | std::ios::ate);
+    EXPECT_GE(static_cast<long long>(dense.tellg()), 3000 * static_cast<long long>(sizeof(int)));
+    EXPECT_LT(static_cast<long long>(sparse.tellg()), 256);
+    sparse.close();
+    dense.close();
+
+    TMultyStack<int> loaded;
+    loaded.LoadFromFile("test_multystack_sparse.bin");
+    EXPECT_TRUE(stack == loaded);
+    EXPECT_EQ(3000, loaded.Capacity());
+    EXPECT_EQ(1000, loaded.Capacity(1));
+    EXPECT_EQ(3, loaded.Pop(2));
+    for (int i = 0; i < 999; ++i)
+        loaded.Push(0, i);
+    EXPECT_TRUE(loaded.IsFull(0));
+    ASSERT_ANY_THROW(TMappedMultyStack<int>("test_multystack_sparse.bin"));
+}
+
+TEST(TMultyStack, delta_holds_only_changed_slots)
+{
+    TMultyStack<int> stack(2, 1000);
+    for (int i = 0; i < 500; ++i)
+        stack.Push(0, i);
+    stack.SaveCheckpoint("test_multystack_base.bin");
+    stack.Push(1, 1);
+    stack(0, 10) = -7;
+    stack.SaveDelta("test_multystack_delta1.bin");
+
+    std::ifstream delta("test_multystack_delta1.bin", std::ios::binary | std::ios::ate);
+    EXPECT_LT(static_cast<long long>(delta.tellg()), 512);
+    delta.close();
+
+    TMultyStack<int> loaded;
+    loaded.LoadFromFile("test_multystack_base.bin");
+    EXPECT_EQ(10, loaded(0, 10));
+    EXPECT_TRUE(loaded.ApplyDelta("test_multystack_delta1.bin"));
+    EXPECT_TRUE(stack == loaded);
+    EXPECT_EQ(-7, loaded.FindMin());
+    EXPECT_FALSE(loaded.ApplyDelta("test_multystack_delta1.bin"));
+}
+
+TEST(TMultyStack, compactor_folds_deltas_into_base)
+{
+    TMultyStack<int> stack(3, 2);
+    stack.Push(0, 1);
+    stack.SaveCheckpoint("test_multystack_base.bin", true);
+    stack.Push(1, 2);
+    stack.SaveDelta("test_multystack_delta1.bin");
+    for (int i = 0; i < 4; ++i)
+        stack.Push(0, 10 + i);
+    stack.Pop(1);
+    stack.SaveDelta("test_multystack_delta2.bin");
+
+    CompactSnapshots<int>("test_multystack_base.bin", { "test_multystack_delta1.bin", "test_multystack_delta2.bin" });
+    TMultyStack<int> loaded;
+    loaded.LoadFromFile("test_multystack_base.bin");
+    EXPECT_TRUE(stack == loaded);
+
+    stack.Top(0) = 5;
+    stack.SaveDelta("test_multystack_delta3.bin");
+    CompactSnapshots<int>("test_multystack_base.bin", { "test_multystack_delta1.bin", "test_multystack_delta2.bin", "test_multystack_delta3.bin" });
+    loaded.LoadFromFile("test_multystack_base.bin");
+    EXPECT_TRUE(stack == loaded);
+}
+
+TEST(TMultyStack, apply_delta_rejects_foreign_or_missing_steps)
+{
+    TMultyStack<int> stack(2, 2);
+    ASSERT_ANY_THROW(stack.SaveDelta("test_multystack_delta1.bin"));
+    stack.SaveCheckpoint("test_multystack_base.bin");
+    stack.Push(0, 1);
+    stack.SaveDelta("test_multystack_delta1.bin");
+    stack.Push(0, 2);
+    stack.SaveDelta("test_multystack_delta2.bin");
+
+    TMultyStack<int> loaded;
+    loaded.LoadFromFile("test_multystack_base.bin");
+    ASSERT_ANY_THROW(loaded.ApplyDelta("test_multystack_delta2.bin"));
+    ASSERT_ANY_THROW(loaded.LoadFromFile("test_multystack_delta1.bin"));
+
+    TMultyStack<int> other(2, 2);
+    other.SaveCheckpoint("test_multystack_other.bin");
+    ASSERT_ANY_THROW(other.ApplyDelta("test_multystack_delta1.bin"));
+}
+
+TEST(TMultyStack, apply_delta_rejects_older_checkpoint)
+{
+    TMultyStack<int> stack(2, 4);
+    stack.Push(0, 1);
+    stack.Push(0, 2);
+    stack.SaveCheckpoint("test_multystack_base.bin");
+    stack.Pop(0);
+    stack.Push(0, 777);
+    stack.SaveCheckpoint("test_multystack_other.bin");
+    stack.Push(1, 200);
+    stack.SaveDelta("test_multystack_delta1.bin");
+
+    TMultyStack<int> old;
+    old.LoadFromFile("test_multystack_base.bin");
+    ASSERT_ANY_THROW(old.ApplyDelta("test_multystack_delta1.bin"));
+    EXPECT_EQ(2, old.Top(0));
+
+    TMultyStack<int> current;
+    current.LoadFromFile("test_multystack_other.bin");
+    EXPECT_TRUE(current.ApplyDelta("test_multystack_delta1.bin"));
+    EXPECT_TRUE(current == stack);
+    EXPECT_FALSE(current.ApplyDelta("test_multystack_delta1.bin"));
+}
+
+TEST(TMultyStack, failed_checkpoint_keeps_sequence)
+{
+    TMultyStack<int> stack(2, 4);
+    stack.Push(0, 1);
+    stack.SaveCheckpoint("test_multystack_base.bin");
+    stack.Push(1, 2);
+    ASSERT_ANY_THROW(stack.SaveCheckpoint("no_such_dir/test_multystack_other.bin"));
+    stack.SaveDelta("test_multystack_delta1.bin");
+
+    TMultyStack<int> loaded;
+    loaded.LoadFromFile("test_multystack_base.bin");
+    EXPECT_TRUE(loaded.ApplyDelta("test_multystack_delta1.bin"));
+    EXPECT_TRUE(loaded == stack);
+}
+
+TEST(TMappedMultyStack, can_map_saved_file)
+{
+    TMultyStack<double> stack(std::vector<size_t>{ 3, 1, 2 });
+    stack.Push(0, 4.5);
+    stack.Push(0, 1.5);
+    stack.Push(2, 2.5);
+    stack.SaveToFile("test_mapped_multystack.bin");
+
+    const TMappedMultyStack<double> mapped("test_mapped_multystack.bin");
+    EXPECT_FALSE(mapped.IsWritable());
+    EXPECT_TRUE(mapped.Verify());
+    EXPECT_EQ(6, mapped.Capacity());
+    EXPECT_EQ(3, mapped.Count());
+    EXPECT_EQ(2, mapped.Size(0));
+    EXPECT_TRUE(mapped.IsEmpty(1));
+    EXPECT_EQ(2, mapped.Capacity(2));
+    EXPECT_EQ(4.5, mapped(0, 0));
+    EXPECT_EQ(1.5, mapped.Top(0));
+    EXPECT_EQ(2.5, mapped.Min(2));
+    EXPECT_EQ(1.5, mapped.FindMin());
+}
+
+TEST(TMappedMultyStack, read_only_view_cannot_be_changed)
+{
+    TMultyStack<int> stack(2, 2);
+    stack.Push(0, 1);
+    stack.SaveToFile("test_mapped_multystack_ro.bin");
+
+    TMappedMultyStack<int> mapped("test_mapped_multystack_ro.bin");
+    ASSERT_ANY_THROW(mapped.Push(1, 2));
+    ASSERT_ANY_THROW(mapped.Pop(0));
+    ASSERT_ANY_THROW(mapped.Set(0, 0, 3));
+    EXPECT_EQ(1, mapped.Top(0));
+}
+
+TEST(TMappedMultyStack, copy_on_write_changes_stay_private)
+{
+    TMultyStack<int> stack(2, 2);
+    stack.Push(0, 1);
+    stack.Push(1, 5);
+    stack.SaveToFile("test_mapped_multystack_cow.bin");
+
+    {
+        TMappedMultyStack<int> mapped("test_mapped_multystack_cow.bin", true);
+        EXPECT_TRUE(mapped.IsWritable());
+        mapped.Push(0, 0);
+        ASSERT_ANY_THROW(mapped.Push(0, 7));
+        mapped.Set(1, 0, 3);
+        EXPECT_EQ(0, mapped.FindMin());
+        EXPECT_EQ(0, mapped.Pop(0));
+        EXPECT_EQ(3, mapped.Pop(1));
+        EXPECT_TRUE(mapped.IsEmpty(1));
+    }
+
+    TMultyStack<int> loaded;
+    loaded.LoadFromFile("test_mapped_multystack_cow.bin");
+    EXPECT_TRUE(stack == loaded);
+}
+
+TEST(TWorkStealingDeque, owner_pops_in_lifo_order)
+{
+    TWorkStealingDeque<int> deque(4);
+    deque.Push(1);
+    deque.Push(2);
+    deque.Push(3);
+
+    int elem = 0;
+    ASSERT_TRUE(deque.Pop(elem));
+    EXPECT_EQ(3, elem);
+    ASSERT_TRUE(deque.Pop(elem));
+    EXPECT_EQ(2, elem);
+}
+
+TEST(TWorkStealingDeque, thief_steals_in_fifo_order)
+{
+    TWorkStealingDeque<int> deque(4);
+    deque.Push(1);
+    deque.Push(2);
+    deque.Push(3);
+
+    int elem = 0;
+    ASSERT_TRUE(deque.Steal(elem));
+    EXPECT_EQ(1, elem);
+    ASSERT_TRUE(deque.Pop(elem));
+    EXPECT_EQ(3, elem);
+    ASSERT_TRUE(deque.Steal(elem));
+    EXPECT_EQ(2, elem);
+    EXPECT_FALSE(deque.Steal(elem));
+    EXPECT_FALSE(deque.Pop(elem));
+}
+
+TEST(TWorkStealingDeque, grows_when_full)
+{
+    TWorkStealingDeque<int> deque(2);
+    for (int i = 0; i < 100; ++i)
+        deque.Push(i);
+
+    EXPECT_EQ(100, deque.Size());
+    EXPECT_LE(100, deque.Capacity());
+    int elem = 0;
+    for (int i = 99; i >= 0; --i)
+    {
+        ASSERT_TRUE(deque.Pop(elem));
+        EXPECT_EQ(i, elem);
+    }
+    EXPECT_TRUE(deque.IsEmpty());
+}
+
+TEST(TWorkStealingDeque, concurrent_steal_takes_every_element_once)
+{
+    const int count = 20000;
+    TWorkStealingDeque<int> deque;
+    std::atomic<long long> sum(0);
+    std::atomic<int> taken(0);
+    std::atomic<bool> done(false);
+
+    std::thread thieves[3];
+    for (auto& thief : thieves)
+        thief = std::thread([&]()
+        {
+            int elem;
+            while (!done.load() || !deque.IsEmpty())
+                if (deque.Steal(elem))
+                {
+                    sum += elem;
+                    taken++;
+                }
+        });
+
+    int elem;
+    for (int i = 1; i <= count; ++i)
+    {
+        deque.Push(i);
+        if (i % 3 == 0 && deque.Pop(elem))
+        {
+            sum += elem;
+            taken++;
+        }
+    }
+    while (deque.Pop(elem))
+    {
+        sum += elem;
+        taken++;
+    }
+    done.store(true);
+    for (auto& thief : thieves)
+        thief.join();
+
+    EXPECT_EQ(count, taken.load());
+    EXPECT_EQ(1LL * count * (count + 1) / 2, sum.load());
+}
+
+TEST(TThreadPool, can_create_pool)
+{
+    ASSERT_NO_THROW(TThreadPool pool(2));
+    TThreadPool pool(3);
+    EXPECT_EQ(3, pool.ThreadCount());
+}
+
+TEST(TThreadPool, runs_all_submitted_tasks)
+{
+    TThreadPool pool(4);
+    std::atomic<int> counter(0);
+    for (int i = 0; i < 1000; ++i)
+        pool.Submit([&counter]() { counter++; });
+    pool.WaitAll();
+
+    EXPECT_EQ(1000, counter.load());
+    EXPECT_EQ(0, pool.Pending());
+}
+
+TEST(TThreadPool, tasks_can_submit_tasks)
+{
+    TThreadPool pool(4);
+    std::atomic<int> counter(0);
+    for (int i = 0; i < 10; ++i)
+        pool.Submit([&]()
+        {
+            for (int j = 0; j < 100; ++j)
+                pool.Submit([&counter]() { counter++; });
+        });
+    pool.WaitAll();
+
+    EXPECT_EQ(1000, counter.load());
+}
+
+TEST(TThreadPool, parallel_for_visits_every_index)
+{
+    TThreadPool pool(4);
+    const size_t count = 10000;
+    TStack<int> marks(count);
+    for (size_t i = 0; i < count; ++i)
+        marks.Put(0);
+
+    pool.ParallelFor(0, count, [&marks](size_t i) { marks.begin()[i] += 1; });
+
+    for (size_t i = 0; i < count; ++i)
+        EXPECT_EQ(1, marks[i]);
+}
+
+TEST(TThreadPool, parallel_for_can_be_nested)
+{
+    TThreadPool pool(3);
+    std::atomic<int> counter(0);
+    pool.ParallelFor(0, 10, [&](size_t)
+    {
+        pool.ParallelFor(0, 10, [&counter](size_t) { counter++; });
+    });
+
+    EXPECT_EQ(100, counter.load());
+}
+
+TEST(TThreadPool, wait_all_rethrows_task_error)
+{
+    TThreadPool pool(2);
+    pool.Submit([]() { ERROR("task_error"); });
+
+    ASSERT_ANY_THROW(pool.WaitAll());
+    ASSERT_NO_THROW(pool.WaitAll());
+}
+
+TEST(TThreadPool, wait_all_from_task_throws)
+{
+    TThreadPool pool(2);
+    std::atomic<bool> threw(false);
+    pool.Submit([&]()
+    {
+        try
+        {
+            pool.WaitAll();
+        }
+        catch (...)
+        {
+            threw = true;
+        }
+    });
+    pool.WaitAll();
+
+    EXPECT_TRUE(threw.load());
+}
+
+TEST(TThreadPool, parallel_for_rethrows_error)
+{
+    TThreadPool pool(2);
+
+    ASSERT_ANY_THROW(pool.ParallelFor(0, 100, [](size_t i) { if (i == 42) ERROR("index_error"); }));
+}
+
+TEST(TConcurrentMultyStack, can_create_with_positive_parameters)
+{
+    ASSERT_NO_THROW(TConcurrentMultyStack<int> stack(3, 4));
+    TConcurrentMultyStack<int> stack(3, 4);
+    EXPECT_EQ(12, stack.Capacity());
+    EXPECT_EQ(3, stack.Count());
+}
+
+TEST(TConcurrentMultyStack, can_push_and_pop)
+{
+    TConcurrentMultyStack<int> stack(2, 3);
+    stack.Push(0, 1);
+    stack.Push(0, 2);
+    stack.Push(1, 3);
+
+    EXPECT_EQ(2, stack.Size(0));
+    EXPECT_EQ(2, stack.Pop(0));
+    EXPECT_EQ(1, stack.Pop(0));
+    EXPECT_EQ(3, stack.Pop(1));
+    ASSERT_ANY_THROW(stack.Pop(1));
+    ASSERT_ANY_THROW(stack.Push(2, 1));
+}
+
+TEST(TConcurrentMultyStack, repack_moves_neighbours)
+{
+    TConcurrentMultyStack<int> stack(3, 2);
+    stack.Push(0, 1);
+    stack.Push(0, 2);
+    stack.Push(0, 3);
+    stack.Push(1, 4);
+
+    EXPECT_EQ(3, stack.Size(0));
+    EXPECT_EQ(3, stack(0, 2));
+    EXPECT_EQ(4, stack(1, 0));
+    EXPECT_EQ(1, stack.FindMin());
+}
+
+TEST(TConcurrentMultyStack, parallel_pushes_keep_every_stack_intact)
+{
+    const size_t threadCount = 4;
+    const int perThread = 2000;
+    TConcurrentMultyStack<int> stack(threadCount * 2, perThread / 2);
+
+    std::thread workers[threadCount];
+    for (size_t t = 0; t < threadCount; ++t)
+        workers[t] = std::thread([&stack, t]()
+        {
+            for (int i = 0; i < perThread; ++i)
+            {
+                stack.Push(t, i);
+                if (i % 4 == 3)
+                    stack.Pop(t);
+            }
+        });
+    for (auto& worker : workers)
+        worker.join();
+
+    for (size_t t = 0; t < threadCount; ++t)
+    {
+        int expected = perThread - 1;
+        EXPECT_EQ(perThread * 3 / 4, stack.Size(t));
+        while (!stack.IsEmpty(t))
+        {
+            if (expected % 4 == 3)
+                expected--;
+            EXPECT_EQ(expected, stack.Pop(t));
+            expected--;
+        }
+    }
+}
+
+TEST(TBroadcastRing, can_create_ring)
+{
+    ASSERT_NO_THROW(TBroadcastRing<int> ring(8, 2));
+    ASSERT_ANY_THROW(TBroadcastRing<int> ring(0, 2));
+    ASSERT_ANY_THROW(TBroadcastRing<int> ring(8, 0));
+
+    TBroadcastRing<int> ring(5, 3);
+    EXPECT_EQ(8, ring.Capacity());
+    EXPECT_EQ(3, ring.ConsumerCount());
+}
+
+TEST(TBroadcastRing, every_consumer_sees_every_event)
+{
+    TBroadcastRing<int> ring(8, 3);
+    ring.Put(1);
+    ring.Put(2);
+    ring.Put(3);
+
+    for (size_t consumer = 0; consumer < 3; ++consumer)
+    {
+        int sum = 0;
+        bool lastFlag = false;
+        EXPECT_EQ(3, ring.Available(consumer));
+        EXPECT_EQ(3, ring.TryProcess(consumer, [&](const int& elem, int64_t, bool endOfBatch)
+        {
+            sum += elem;
+            lastFlag = endOfBatch;
+        }));
+        EXPECT_EQ(6, sum);
+        EXPECT_TRUE(lastFlag);
+        EXPECT_EQ(0, ring.Available(consumer));
+    }
+}
+
+TEST(TBroadcastRing, can_read_batch)
+{
+    TBroadcastRing<int> ring(8, 1);
+    int64_t last = ring.Next(4);
+    for (int64_t sequence = last - 3; sequence <= last; ++sequence)
+        ring[sequence] = static_cast<int>(sequence) * 10;
+    ring.Publish(last - 3, last);
+
+    int out[4] = {};
+    EXPECT_EQ(3, ring.Read(0, out, 3));
+    EXPECT_EQ(0, out[0]);
+    EXPECT_EQ(20, out[2]);
+    EXPECT_EQ(1, ring.Read(0, out, 3));
+    EXPECT_EQ(30, out[0]);
+}
+
+TEST(TBroadcastRing, halt_releases_waiting_consumer)
+{
+    TBroadcastRing<int> ring(4, 1, TWaitStrategy::Block);
+    size_t processed = 1;
+    std::thread consumer([&]() { processed = ring.Process(0, [](const int&, int64_t, bool) {}); });
+    ring.Halt();
+    consumer.join();
+
+    EXPECT_EQ(0, processed);
+    ASSERT_ANY_THROW(ring.Put(1));
+}
+
+void RunBroadcastRing(TWaitStrategy strategy)
+{
+    const int producerCount = 2;
+    const int perProducer = 2000;
+    const size_t consumerCount = 3;
+    TBroadcastRing<int> ring(64, consumerCount, strategy);
+
+    long long sums[consumerCount] = {};
+    std::thread consumers[consumerCount];
+    for (size_t c = 0; c < consumerCount; ++c)
+        consumers[c] = std::thread([&, c]()
+        {
+            int seen = 0;
+            while (seen < producerCount * perProducer)
+                seen += static_cast<int>(ring.Process(c, [&](const int& elem, int64_t, bool) { sums[c] += elem; }));
+        });
+    std::thread producers[producerCount];
+    for (auto& producer : producers)
+        producer = std::thread([&]()
+        {
+            for (int i = 1; i <= perProducer; ++i)
+                ring.Put(i);
+        });
+    for (auto& producer : producers)
+        producer.join();
+    for (auto& consumer : consumers)
+        consumer.join();
+
+    for (size_t c = 0; c < consumerCount; ++c)
+        EXPECT_EQ(1LL * producerCount * perProducer * (perProducer + 1) / 2, sums[c]);
+}
+
+TEST(TBroadcastRing, multi_producer_fan_out_with_yield)
+{
+    RunBroadcastRing(TWaitStrategy::Yield);
+}
+
+TEST(TBroadcastRing, busy_spin_producer_wraps_after_consumers_advance)
+{
+    TBroadcastRing<int> ring(4, 2, TWaitStrategy::BusySpin);
+    long long sums[2] = {};
+    for (int i = 1; i <= 100; ++i)
+    {
+        ring.Put(i);
+        if (i % 4 == 0)
+            for (size_t c = 0; c < 2; ++c)
+                ring.TryProcess(c, [&](const int& elem, int64_t, bool) { sums[c] += elem; });
+    }
+
+    EXPECT_EQ(5050, sums[0]);
+    EXPECT_EQ(5050, sums[1]);
+}
+
+TEST(TBroadcastRing, multi_producer_fan_out_with_block)
+{
+    RunBroadcastRing(TWaitStrategy::Block);
+}
+
+TEST(TPoolAllocator, reuses_freed_blocks)
+{
+    TMemoryPool pool(1024);
+    TPoolAllocator<int> allocator(pool);
+
+    int* first = allocator.allocate(10);
+    size_t chunks = pool.ChunkCount();
+    allocator.deallocate(first, 10);
+    int* second = allocator.allocate(10);
+
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(chunks, pool.ChunkCount());
+    allocator.deallocate(second, 10);
+}
+
+TEST(TPoolAllocator, serves_large_and_aligned_requests)
+{
+    TMemoryPool pool;
+    TPoolAllocator<double> allocator(pool);
+    size_t large = TMemoryPool::MaxPooledBytes() / sizeof(double) + 1;
+
+    double* memory = allocator.allocate(large);
+    memory[large - 1] = 1.0;
+    allocator.deallocate(memory, large);
+    EXPECT_EQ(0, pool.ChunkCount());
+
+    double* small = allocator.allocate(3);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(small) % alignof(double));
+    allocator.deallocate(small, 3);
+}
+
+TEST(TPoolAllocator, containers_allocate_from_pool)
+{
+    TMemoryPool pool;
+    TPoolAllocator<int> allocator(pool);
+    {
+        TStack<int, TPoolAllocator<int>> stack(100, allocator);
+        TQueue<int, TPoolAllocator<int>> queue(100, allocator);
+        TMultyStack<int, TPoolAllocator<int>> multy(4, 25, allocator);
+        stack.Put(1);
+        queue.Put(2);
+        multy.Push(3, 3);
+        EXPECT_EQ(1, stack.Top());
+        EXPECT_EQ(2, queue.Head());
+        EXPECT_EQ(3, multy.Top(3));
+        EXPECT_TRUE(stack.GetAllocator() == allocator);
+    }
+    size_t chunks = pool.ChunkCount();
+    EXPECT_LT(0, chunks);
+    {
+        TStack<int, TPoolAllocator<int>> stack(100, allocator);
+        TMultyStack<int, TPoolAllocator<int>> multy(4, 25, allocator);
+    }
+    EXPECT_EQ(chunks, pool.ChunkCount());
+}
+
+TEST(TPoolAllocator, move_between_pools_moves_elements)
+{
+    TMemoryPool firstPool;
+    TMemoryPool secondPool;
+    TStack<TString, TPoolAllocator<TString>> source(4, TPoolAllocator<TString>(firstPool));
+    TStack<TString, TPoolAllocator<TString>> target(2, TPoolAllocator<TString>(secondPool));
+    source.Put("a");
+    source.Put("b");
+
+    target = std::move(source);
+    EXPECT_EQ(2, target.Size());
+    EXPECT_TRUE(target.Top() == "b");
+    EXPECT_TRUE(target.GetAllocator() == TPoolAllocator<TString>(secondPool));
+    EXPECT_TRUE(source.IsEmpty());
+}
+
+TEST(TPoolAllocator, containers_accept_memory_resource_allocators)
+{
+    char buffer[4096];
+    std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer));
+    std::pmr::polymorphic_allocator<int> allocator(&arena);
+
+    TQueue<int, std::pmr::polymorphic_allocator<int>> queue(16, allocator);
+    TMultyStack<int, std::pmr::polymorphic_allocator<int>> multy(2, 8, allocator);
+    queue.Put(5);
+    multy.Push(1, 6);
+
+    EXPECT_EQ(5, queue.Get());
+    EXPECT_EQ(6, multy.Pop(1));
+    EXPECT_TRUE(queue.GetAllocator().resource() == &arena);
+}
+
+TEST(TStaticStack, evaluates_at_compile_time)
+{
+    static_assert(BracketsBalanced("([()][])"), "");
+    static_assert(!BracketsBalanced("([)]"), "");
+    static_assert(TStaticStack<int, 4>().Capacity() == 4, "");
+    EXPECT_TRUE(BracketsBalanced("(())"));
+}
+
+TEST(TStaticStack, put_and_get_follow_lifo_order)
+{
+    TStaticStack<int, 3> stack;
+    stack.Put(1);
+    stack.Put(2);
+    stack.Put(3);
+
+    EXPECT_TRUE(stack.IsFull());
+    EXPECT_EQ(3, stack.Get());
+    EXPECT_EQ(2, stack.Top());
+    EXPECT_EQ(2, stack.Size());
+}
+
+TEST(TStaticStack, throws_when_full_or_empty)
+{
+    TStaticStack<int, 1> stack;
+    ASSERT_ANY_THROW(stack.Get());
+    stack.Put(1);
+    ASSERT_ANY_THROW(stack.Put(2));
+}
+
+TEST(TStaticStack, batch_operations_match_dynamic_stack)
+{
+    int values[] = {4, 2, 7, 1};
+    TStaticStack<int, 8> stack;
+    stack.PutRange(values, values + 4);
+
+    int peeked[2];
+    EXPECT_EQ(2, stack.PeekN(peeked, 2));
+    EXPECT_EQ(7, peeked[0]);
+    EXPECT_EQ(1, peeked[1]);
+    EXPECT_EQ(1, stack.Min());
+
+    int popped[8];
+    EXPECT_EQ(4, stack.PopN(popped, 8));
+    EXPECT_TRUE(stack.IsEmpty());
+}
+
+TEST(TStaticStack, can_write_and_read_file)
+{
+    TStaticStack<TString, 4> stack;
+    stack.Put("ab");
+    stack.Put("cd");
+    stack.WriteToFile("test_static_stack.txt");
+
+    TStaticStack<TString, 4> loaded;
+    loaded.ReadFromFile("test_static_stack.txt");
+    EXPECT_EQ(2, loaded.Size());
+    EXPECT_TRUE(loaded[0] == "ab");
+    EXPECT_TRUE(loaded.Top() == "cd");
+}
+
+TEST(TStaticQueue, evaluates_at_compile_time)
+{
+    static_assert(RotateQueue(0) == 123, "");
+    static_assert(RotateQueue(4) == 231, "");
+    EXPECT_EQ(312, RotateQueue(2));
+}
+
+TEST(TStaticQueue, wraps_around_fixed_storage)
+{
+    TStaticQueue<int, 3> queue;
+    queue.Put(1);
+    queue.Put(2);
+    EXPECT_EQ(1, queue.Get());
+    queue.Put(3);
+    queue.Put(4);
+
+    EXPECT_TRUE(queue.IsFull());
+    ASSERT_ANY_THROW(queue.Put(5));
+    int expected = 2;
+    for (int value : queue)
+        EXPECT_EQ(expected++, value);
+}
+
+TEST(TStaticQueue, get_n_advances_head)
+{
+    TStaticQueue<int, 4> queue;
+    int values[] = {1, 2, 3, 4};
+    queue.PutRange(values, values + 4);
+
+    int out[3];
+    EXPECT_EQ(3, queue.GetN(out, 3));
+    EXPECT_EQ(3, out[2]);
+    queue.Put(5);
+    EXPECT_EQ(4, queue.Head());
+    EXPECT_EQ(5, queue.Tail());
+}
+
+TEST(TSmallStack, stays_inline_up_to_capacity)
+{
+    TSmallStack<int, 4> stack;
+    for (int i = 0; i < 4; ++i)
+        stack.Put(i);
+
+    EXPECT_TRUE(stack.IsInline());
+    EXPECT_EQ(4, stack.Capacity());
+    EXPECT_EQ(3, stack.Top());
+}
+
+TEST(TSmallStack, spills_to_heap_and_keeps_order)
+{
+    TSmallStack<int, 4> stack;
+    for (int i = 0; i < 1000; ++i)
+        stack.Put(i);
+
+    EXPECT_FALSE(stack.IsInline());
+    EXPECT_EQ(1000, stack.Size());
+    for (int i = 999; i >= 0; --i)
+        EXPECT_EQ(i, stack.Get());
+}
+
+TEST(TSmallStack, put_of_own_element_survives_growth)
+{
+    TSmallStack<TString, 2> stack;
+    stack.Put("a");
+    stack.Put("b");
+    stack.Put(stack[0]);
+
+    EXPECT_EQ(3, stack.Size());
+    EXPECT_TRUE(stack.Top() == "a");
+}
+
+TEST(TSmallStack, shrink_to_fit_returns_to_inline_buffer)
+{
+    TSmallStack<int, 4> stack;
+    for (int i = 0; i < 10; ++i)
+        stack.Put(i);
+    int out[8];
+    stack.PopN(out, 8);
+
+    stack.ShrinkToFit();
+    EXPECT_TRUE(stack.IsInline());
+    EXPECT_EQ(1, stack.Top());
+}
+
+TEST(TSmallStack, copy_and_move_keep_elements_and_destroy_them)
+{
+    TCounted::alive = 0;
+    {
+        TSmallStack<TCounted, 2> inlineStack;
+        inlineStack.Put(TCounted(1));
+        TSmallStack<TCounted, 2> heapStack;
+        for (int i = 0; i < 5; ++i)
+            heapStack.Put(TCounted(i));
+
+        TSmallStack<TCounted, 2> copy(heapStack);
+        TSmallStack<TCounted, 2> moved(std::move(inlineStack));
+        copy = std::move(moved);
+
+        EXPECT_EQ(1, copy.Size());
+        EXPECT_EQ(1, copy.Top().value);
+        EXPECT_TRUE(moved.IsEmpty());
+        EXPECT_EQ(4, heapStack.Top().value);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TSmallStack, can_write_and_read_file)
+{
+    TSmallStack<int, 2> stack;
+    int values[] = {5, 6, 7};
+    stack.PutRange(values, values + 3);
+    stack.WriteToFile("test_small_stack.txt");
+
+    TSmallStack<int, 2> loaded;
+    loaded.ReadFromFile("test_small_stack.txt");
+    EXPECT_TRUE(stack == loaded);
+}
+
+TEST(TSegmentedStack, element_addresses_survive_growth)
+{
+    TSegmentedStack<int, 4> stack;
+    int* first = &stack.Emplace(42);
+    for (int i = 0; i < 1000; ++i)
+        stack.Put(i);
+
+    EXPECT_EQ(42, *first);
+    EXPECT_EQ(1001, stack.Size());
+    EXPECT_EQ(999, stack.Top());
+}
+
+TEST(TSegmentedStack, get_returns_elements_in_lifo_order)
+{
+    TSegmentedStack<int, 3> stack;
+    for (int i = 0; i < 10; ++i)
+        stack.Put(i);
+
+    for (int i = 9; i >= 0; --i)
+        EXPECT_EQ(i, stack.Get());
+    EXPECT_TRUE(stack.IsEmpty());
+    ASSERT_ANY_THROW(stack.Get());
+}
+
+TEST(TSegmentedStack, steady_state_reuses_blocks)
+{
+    TSegmentedStack<int, 4> stack;
+    for (int i = 0; i < 20; ++i)
+        stack.Put(i);
+    size_t allocated = stack.AllocatedBlocks();
+
+    for (int round = 0; round < 100; ++round)
+    {
+        int out[20];
+        stack.PopN(out, 20);
+        stack.PutRange(out, out + 20);
+    }
+    EXPECT_EQ(allocated, stack.AllocatedBlocks());
+
+    int out[20];
+    stack.PopN(out, 20);
+    EXPECT_EQ(allocated, stack.SpareBlocks());
+    stack.ShrinkToFit();
+    EXPECT_EQ(0, stack.AllocatedBlocks());
+}
+
+TEST(TSegmentedStack, peek_n_crosses_block_boundary)
+{
+    TSegmentedStack<int, 2> stack;
+    int values[] = {1, 2, 3, 4, 5};
+    stack.PutRange(values, values + 5);
+
+    int out[4];
+    EXPECT_EQ(4, stack.PeekN(out, 4));
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(i + 2, out[i]);
+    EXPECT_EQ(5, stack.Size());
+}
+
+TEST(TSegmentedStack, copy_and_move_keep_elements_and_destroy_them)
+{
+    TCounted::alive = 0;
+    {
+        TSegmentedStack<TCounted, 2> stack;
+        for (int i = 0; i < 5; ++i)
+            stack.Put(TCounted(i));
+
+        TSegmentedStack<TCounted, 2> copy(stack);
+        TSegmentedStack<TCounted, 2> moved(std::move(stack));
+        copy = moved;
+
+        EXPECT_TRUE(copy == moved);
+        EXPECT_TRUE(stack.IsEmpty());
+        EXPECT_EQ(4, copy.Top().value);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TSegmentedQueue, element_addresses_survive_growth)
+{
+    TSegmentedQueue<int, 4> queue;
+    int* first = &queue.Emplace(7);
+    for (int i = 0; i < 1000; ++i)
+        queue.Put(i);
+
+    EXPECT_EQ(7, *first);
+    EXPECT_EQ(first, &queue.Head());
+    EXPECT_EQ(999, queue.Tail());
+}
+
+TEST(TSegmentedQueue, get_returns_elements_in_fifo_order)
+{
+    TSegmentedQueue<int, 3> queue;
+    for (int i = 0; i < 10; ++i)
+        queue.Put(i);
+
+    int expected = 0;
+    for (int value : queue)
+        EXPECT_EQ(expected++, value);
+    for (int i = 0; i < 10; ++i)
+        EXPECT_EQ(i, queue.Get());
+    ASSERT_ANY_THROW(queue.Get());
+}
+
+TEST(TSegmentedQueue, steady_throughput_does_not_allocate)
+{
+    TSegmentedQueue<int, 4> queue;
+    for (int i = 0; i < 10; ++i)
+        queue.Put(i);
+    for (int i = 10; i < 20; ++i)
+    {
+        queue.Put(i);
+        queue.Get();
+    }
+    size_t allocated = queue.AllocatedBlocks();
+
+    for (int i = 20; i < 1000; ++i)
+    {
+        queue.Put(i);
+        EXPECT_EQ(i - 10, queue.Get());
+    }
+    EXPECT_EQ(allocated, queue.AllocatedBlocks());
+    EXPECT_EQ(10, queue.Size());
+}
+
+TEST(TSegmentedQueue, can_write_and_read_file)
+{
+    TSegmentedQueue<TString, 2> queue;
+    queue.Put("a");
+    queue.Put("bc");
+    queue.Put("def");
+    queue.WriteToFile("test_segmented_queue.txt");
+
+    TSegmentedQueue<TString, 2> loaded;
+    loaded.ReadFromFile("test_segmented_queue.txt");
+    EXPECT_TRUE(queue == loaded);
+    EXPECT_TRUE(loaded.Head() == "a");
+}
+
+TEST(TStack, copy_shares_buffer_until_first_mutation)
+{
+    TCounted::alive = 0;
+    {
+        TStack<TCounted> stack(4);
+        stack.Emplace(1);
+        stack.Emplace(2);
+        TStack<TCounted> snapshot(stack);
+
+        EXPECT_TRUE(stack.IsShared());
+        EXPECT_EQ(2, TCounted::alive);
+        EXPECT_EQ(&stack.cbegin()[0], &snapshot.cbegin()[0]);
+
+        stack.Get();
+        EXPECT_FALSE(stack.IsShared());
+        EXPECT_FALSE(snapshot.IsShared());
+        EXPECT_EQ(3, TCounted::alive);
+        EXPECT_EQ(2, snapshot.Size());
+        EXPECT_EQ(2, snapshot.Top().value);
+        EXPECT_EQ(1, stack.Top().value);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TStack, writes_through_reference_do_not_leak_into_copies)
+{
+    TStack<int> stack(4);
+    stack.Put(1);
+    TStack<int> copy(stack);
+
+    copy.Top() = 5;
+    copy[0]++;
+    EXPECT_EQ(1, stack.Top());
+    EXPECT_EQ(6, copy.Top());
+}
+
+TEST(TStack, reference_taken_before_copy_does_not_leak_into_copy)
+{
+    TStack<int> stack(4);
+    stack.Put(1);
+    stack.Put(2);
+    int& top = stack.Top();
+    TStack<int> copy(stack);
+
+    EXPECT_FALSE(copy.IsShared());
+    top = 7;
+    EXPECT_EQ(7, stack.Top());
+    EXPECT_EQ(2, copy.Top());
+}
+
+TEST(TQueue, copy_shares_buffer_until_first_mutation)
+{
+    TQueue<TString> queue(3);
+    queue.Put("a");
+    queue.Put("b");
+    TQueue<TString> snapshot(queue);
+    EXPECT_TRUE(snapshot.IsShared());
+
+    queue.Get();
+    queue.Put("c");
+    EXPECT_FALSE(snapshot.IsShared());
+    EXPECT_TRUE(snapshot.Head() == "a");
+    EXPECT_TRUE(queue.Head() == "b");
+    EXPECT_EQ(2, snapshot.Size());
+}
+
+TEST(TQueue, iterator_taken_before_copy_does_not_leak_into_copy)
+{
+    TQueue<int> queue(4);
+    queue.Put(1);
+    queue.Put(2);
+    TQueue<int>::iterator it = queue.begin();
+    TQueue<int> copy(queue);
+
+    EXPECT_FALSE(copy.IsShared());
+    *it = 7;
+    EXPECT_EQ(7, queue.Head());
+    EXPECT_EQ(1, copy.Head());
+}
+
+TEST(TQueue, snapshots_can_be_released_on_other_threads)
+{
+    TQueue<int> queue(64);
+    for (int i = 0; i < 64; ++i)
+        queue.Put(i);
+
+    std::vector<std::thread> readers;
+    std::atomic<int> sums(0);
+    for (int t = 0; t < 4; ++t)
+    {
+        TQueue<int> snapshot(queue);
+        readers.emplace_back([snapshot, &sums]() mutable {
+            int sum = 0;
+            for (auto it = snapshot.cbegin(); it != snapshot.cend(); ++it)
+                sum += *it;
+            sums += sum;
+        });
+    }
+    for (int i = 0; i < 64; ++i)
+        queue[i] = 0;
+    for (auto& reader : readers)
+        reader.join();
+
+    EXPECT_EQ(4 * 2016, sums.load());
+    EXPECT_EQ(0, queue.Min());
+}
+
+TEST(TPersistentStack, put_returns_new_version_and_keeps_old_one)
+{
+    TPersistentStack<int> empty;
+    TPersistentStack<int> one = empty.Put(1);
+    TPersistentStack<int> two = one.Put(2);
+
+    EXPECT_TRUE(empty.IsEmpty());
+    EXPECT_EQ(1, one.Size());
+    EXPECT_EQ(1, one.Top());
+    EXPECT_EQ(2, two.Size());
+    EXPECT_EQ(2, two.Top());
+}
+
+TEST(TPersistentStack, get_shares_tail_with_original)
+{
+    TPersistentStack<int> stack;
+    for (int i = 0; i < 5; ++i)
+        stack = stack.Put(i);
+    TPersistentStack<int> popped = stack.Get();
+    TPersistentStack<int> branch = popped.Put(10);
+
+    EXPECT_EQ(4, stack.Top());
+    EXPECT_EQ(3, popped.Top());
+    EXPECT_EQ(10, branch.Top());
+    EXPECT_TRUE(branch.Get() == popped);
+    ASSERT_ANY_THROW(TPersistentStack<int>().Get());
+}
+
+TEST(TPersistentStack, releases_nodes_when_last_version_dies)
+{
+    TCounted::alive = 0;
+    {
+        TPersistentStack<TCounted> stack;
+        for (int i = 0; i < 100000; ++i)
+            stack = stack.Emplace(i);
+        TPersistentStack<TCounted> older = stack.Get().Get();
+        stack = TPersistentStack<TCounted>();
+        EXPECT_EQ(99998, TCounted::alive);
+        EXPECT_EQ(99997, older.Top().value);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TPersistentStack, can_write_and_read_file)
+{
+    TPersistentStack<TString> stack;
+    stack = stack.Put("a").Put("bc");
+    stack.WriteToFile("test_persistent_stack.txt");
+
+    TPersistentStack<TString> loaded;
+    loaded.ReadFromFile("test_persistent_stack.txt");
+    EXPECT_TRUE(stack == loaded);
+    EXPECT_EQ(2, loaded.Size());
+}
+
+TEST(TPersistentQueue, get_returns_elements_in_fifo_order)
+{
+    TPersistentQueue<int> queue;
+    for (int i = 0; i < 100; ++i)
+        queue = queue.Put(i);
+
+    EXPECT_EQ(100, queue.Size());
+    for (int i = 0; i < 100; ++i)
+    {
+        EXPECT_EQ(i, queue.Head());
+        queue = queue.Get();
+    }
+    EXPECT_TRUE(queue.IsEmpty());
+    ASSERT_ANY_THROW(queue.Get());
+}
+
+TEST(TPersistentQueue, old_versions_stay_valid_after_branching)
+{
+    TPersistentQueue<int> base;
+    for (int i = 0; i < 10; ++i)
+        base = base.Put(i);
+    TPersistentQueue<int> left = base.Get().Put(100);
+    TPersistentQueue<int> right = base.Get().Get().Put(200);
+
+    EXPECT_EQ(0, base.Head());
+    EXPECT_EQ(10, base.Size());
+    EXPECT_EQ(1, left.Head());
+    EXPECT_EQ(2, right.Head());
+
+    for (int i = 1; i < 10; ++i)
+        left = left.Get();
+    EXPECT_EQ(100, left.Head());
+    EXPECT_EQ(1, base.Get().Head());
+}
+
+TEST(TPersistentQueue, interleaved_operations_match_ephemeral_queue)
+{
+    TPersistentQueue<int> persistent;
+    TQueue<int> ephemeral(1000);
+    for (int i = 0; i < 1000; ++i)
+    {
+        persistent = persistent.Put(i);
+        ephemeral.Put(i);
+        if (i % 3 == 0)
+        {
+            EXPECT_EQ(ephemeral.Get(), persistent.Head());
+            persistent = persistent.Get();
+        }
+    }
+    EXPECT_EQ(ephemeral.Size(), persistent.Size());
+    EXPECT_EQ(ephemeral.Head(), persistent.Head());
+}
+
+TEST(TPersistentQueue, releases_cells_when_last_version_dies)
+{
+    TCounted::alive = 0;
+    {
+        std::vector<TPersistentQueue<TCounted>> versions;
+        TPersistentQueue<TCounted> queue;
+        for (int i = 0; i < 200; ++i)
+        {
+            queue = queue.Put(TCounted(i));
+            if (i % 2)
+                queue = queue.Get();
+            versions.push_back(queue);
+        }
+        EXPECT_EQ(100, queue.Size());
+        EXPECT_EQ(100, queue.Head().value);
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TPersistentQueue, can_write_and_read_file)
+{
+    TPersistentQueue<int> queue;
+    for (int i = 0; i < 7; ++i)
+        queue = queue.Put(i * i);
+    queue = queue.Get();
+    queue.WriteToFile("test_persistent_queue.txt");
+
+    TPersistentQueue<int> loaded;
+    loaded.ReadFromFile("test_persistent_queue.txt");
+    EXPECT_TRUE(queue == loaded);
+    EXPECT_EQ(1, loaded.Min());
+}
+
+TEST(TDeque, push_and_pop_at_both_ends)
+{
+    TDeque<int> deque(4);
+    deque.PushBack(2);
+    deque.PushFront(1);
+    deque.PushBack(3);
+    deque.PushFront(0);
+
+    EXPECT_EQ(4, deque.Size());
+    EXPECT_EQ(0, deque.Front());
+    EXPECT_EQ(3, deque.Back());
+    EXPECT_EQ(3, deque.PopBack());
+    EXPECT_EQ(0, deque.PopFront());
+    EXPECT_EQ(1, deque.PopFront());
+    EXPECT_EQ(2, deque.PopBack());
+    ASSERT_ANY_THROW(deque.PopFront());
+}
+
+TEST(TDeque, grows_and_keeps_logical_order)
+{
+    TDeque<int> deque;
+    for (int i = 0; i < 100; ++i)
+    {
+        deque.PushBack(i);
+        deque.PushFront(-i - 1);
+    }
+
+    EXPECT_EQ(200, deque.Size());
+    EXPECT_GE(deque.Capacity(), 200);
+    for (int i = 0; i < 200; ++i)
+        EXPECT_EQ(i - 100, deque[i]);
+    int expected = -100;
+    for (int value : deque)
+        EXPECT_EQ(expected++, value);
+}
+
+TEST(TDeque, push_of_own_element_survives_growth)
+{
+    TDeque<TString> deque(2);
+    deque.PushBack("a");
+    deque.PushBack("b");
+    deque.PushFront(deque[1]);
+
+    EXPECT_EQ(3, deque.Size());
+    EXPECT_TRUE(deque.Front() == "b");
+    EXPECT_TRUE(deque.Back() == "b");
+}
+
+TEST(TDeque, copy_and_move_keep_elements_and_destroy_them)
+{
+    TCounted::alive = 0;
+    {
+        TDeque<TCounted> deque(2);
+        for (int i = 0; i < 5; ++i)
+            deque.EmplaceFront(i);
+        TDeque<TCounted> copy(deque);
+        TDeque<TCounted> moved(std::move(deque));
+
+        EXPECT_EQ(10, TCounted::alive);
+        EXPECT_TRUE(copy == moved);
+        EXPECT_EQ(4, moved.Front().value);
+        EXPECT_TRUE(deque.IsEmpty());
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TDeque, can_write_and_read_file)
+{
+    TDeque<int> deque(3);
+    deque.PushBack(2);
+    deque.PushFront(1);
+    deque.PushBack(3);
+    deque.WriteToFile("test_deque.txt");
+
+    TDeque<int> loaded;
+    loaded.ReadFromFile("test_deque.txt");
+    EXPECT_TRUE(deque == loaded);
+    EXPECT_EQ(1, loaded.Min());
+}
+
+TEST(TDeque, stream_operators_round_trip)
+{
+    TDeque<int> deque;
+    std::stringstream input("3 7 8 9");
+    input >> deque;
+
+    std::stringstream output;
+    output << deque;
+    EXPECT_EQ("[7, 8, 9]", output.str());
+}
+
+TEST(TPriorityQueue, get_returns_elements_in_order)
+{
+    TPriorityQueue<int> queue(8);
+    int values[] = { 5, 1, 7, 3, 8, 2, 6, 4 };
+    for (int v : values)
+        queue.Put(v);
+
+    EXPECT_TRUE(queue.IsFull());
+    EXPECT_EQ(1, queue.Head());
+    for (int i = 1; i <= 8; ++i)
+        EXPECT_EQ(i, queue.Get());
+    EXPECT_TRUE(queue.IsEmpty());
+    ASSERT_ANY_THROW(queue.Get());
+    ASSERT_ANY_THROW(queue.Head());
+}
+
+TEST(TPriorityQueue, throws_when_put_into_full_queue)
+{
+    TPriorityQueue<int> queue(1);
+    queue.Put(1);
+    ASSERT_ANY_THROW(queue.Put(2));
+}
+
+TEST(TPriorityQueue, respects_compare_and_arity)
+{
+    TPriorityQueue<int, std::greater<int>, 2> binary(100);
+    TPriorityQueue<int, std::greater<int>, 8> wide(100);
+    for (int i = 0; i < 100; ++i)
+    {
+        binary.Put((i * 37) % 100);
+        wide.Put((i * 37) % 100);
+    }
+    for (int i = 99; i >= 0; --i)
+    {
+        EXPECT_EQ(i, binary.Get());
+        EXPECT_EQ(i, wide.Get());
+    }
+}
+
+TEST(TPriorityQueue, can_heapify_range)
+{
+    int values[] = { 9, 4, 6, 1, 8, 2 };
+    TPriorityQueue<int> queue(values, values + 6, 10);
+
+    EXPECT_EQ(6, queue.Size());
+    EXPECT_FALSE(queue.IsFull());
+    int expected[] = { 1, 2, 4, 6, 8, 9 };
+    for (int v : expected)
+        EXPECT_EQ(v, queue.Get());
+}
+
+TEST(TPriorityQueue, decrease_key_moves_element_to_head)
+{
+    TPriorityQueue<int> queue(4);
+    queue.Put(10);
+    queue.Put(20);
+    TPriorityQueue<int>::THandle handle = queue.Put(30);
+    queue.Put(40);
+
+    queue.DecreaseKey(handle, 5);
+    EXPECT_EQ(5, queue.Value(handle));
+    EXPECT_EQ(5, queue.Head());
+    ASSERT_ANY_THROW(queue.DecreaseKey(handle, 50));
+
+    EXPECT_EQ(5, queue.Get());
+    EXPECT_FALSE(queue.Contains(handle));
+    ASSERT_ANY_THROW(queue.DecreaseKey(handle, 1));
+    EXPECT_EQ(10, queue.Get());
+}
+
+TEST(TPriorityQueue, stale_handle_does_not_reach_element_reusing_its_id)
+{
+    TPriorityQueue<int> queue(2);
+    TPriorityQueue<int>::THandle stale = queue.Put(10);
+    queue.Put(20);
+    EXPECT_EQ(10, queue.Get());
+    TPriorityQueue<int>::THandle fresh = queue.Put(30);
+
+    EXPECT_EQ(stale.id, fresh.id);
+    EXPECT_FALSE(queue.Contains(stale));
+    EXPECT_TRUE(queue.Contains(fresh));
+    ASSERT_ANY_THROW(queue.Value(stale));
+    ASSERT_ANY_THROW(queue.DecreaseKey(stale, 1));
+    EXPECT_EQ(20, queue.Get());
+    EXPECT_EQ(30, queue.Get());
+}
+
+TEST(TPriorityQueue, handles_follow_elements_through_reordering)
+{
+    TPriorityQueue<int, std::less<int>, 3> queue(50);
+    TPriorityQueue<int, std::less<int>, 3>::THandle handles[50];
+    for (int i = 0; i < 50; ++i)
+        handles[i] = queue.Put(100 + i);
+    for (int i = 49; i >= 0; i -= 2)
+        queue.DecreaseKey(handles[i], i);
+
+    for (int i = 0; i < 50; ++i)
+        EXPECT_EQ(i % 2 ? i : 100 + i, queue.Value(handles[i]));
+    for (int i = 1; i < 50; i += 2)
+        EXPECT_EQ(i, queue.Get());
+    EXPECT_EQ(100, queue.Get());
+}
+
+TEST(TPriorityQueue, copy_and_move_keep_elements_alive)
+{
+    TCounted::alive = 0;
+    {
+        TPriorityQueue<TCounted> queue(4);
+        for (int i = 4; i > 0; --i)
+            queue.Emplace(i);
+        TPriorityQueue<TCounted> copy(queue);
+        TPriorityQueue<TCounted> moved(std::move(queue));
+
+        EXPECT_EQ(8, TCounted::alive);
+        EXPECT_EQ(1, copy.Get().value);
+        EXPECT_EQ(1, moved.Head().value);
+        EXPECT_TRUE(queue.IsEmpty());
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TPriorityQueue, can_write_and_read_file)
+{
+    TPriorityQueue<int> queue(3);
+    queue.Put(3);
+    queue.Put(1);
+    queue.Put(2);
+    queue.WriteToFile("test_priority_queue.txt");
+
+    TPriorityQueue<int> loaded;
+    loaded.ReadFromFile("test_priority_queue.txt");
+    EXPECT_EQ(3, loaded.Size());
+    EXPECT_EQ(1, loaded.Get());
+    EXPECT_EQ(2, loaded.Get());
+    EXPECT_EQ(3, loaded.Get());
+}
+
+TEST(TPriorityQueue, stream_operators_round_trip)
+{
+    TPriorityQueue<int> queue;
+    std::stringstream input("3 9 8 7");
+    input >> queue;
+
+    std::stringstream output;
+    output << queue;
+    EXPECT_EQ("[7, 8, 9]", output.str());
+}
+
+TEST(TPriorityQueue, damaged_stream_leaves_queue_unchanged)
+{
+    TPriorityQueue<int> queue(2);
+    queue.Put(5);
+    std::stringstream truncated("100000000000000 1 2");
+    ASSERT_ANY_THROW(truncated >> queue);
+    std::stringstream garbage("2 1 x");
+    ASSERT_ANY_THROW(garbage >> queue);
+    EXPECT_EQ(1, queue.Size());
+    EXPECT_EQ(5, queue.Head());
+}
+
+TEST(TPriorityQueue, handles_stay_stale_after_reload)
+{
+    TPriorityQueue<int> queue(2);
+    TPriorityQueue<int>::THandle first = queue.Put(4);
+    TPriorityQueue<int>::THandle second = queue.Put(6);
+    EXPECT_EQ(4, queue.Get());
+
+    std::stringstream input("2 8 9");
+    input >> queue;
+    EXPECT_FALSE(queue.Contains(first));
+    EXPECT_FALSE(queue.Contains(second));
+    EXPECT_EQ(8, queue.Get());
+    TPriorityQueue<int>::THandle fresh = queue.Put(7);
+    EXPECT_TRUE(queue.Contains(fresh));
+}
+
+TEST(TMultyQueue, can_create_with_positive_parameters)
+{
+    ASSERT_NO_THROW(TMultyQueue<int> queue(3, 4));
+    TMultyQueue<int> queue(3, 4);
+    EXPECT_EQ(12, queue.Capacity());
+    EXPECT_EQ(3, queue.Count());
+}
+
+TEST(TMultyQueue, keeps_fifo_order_within_each_queue)
+{
+    TMultyQueue<int> queue(3, 4);
+    for (int i = 0; i < 4; ++i)
+    {
+        queue.Put(0, i);
+        queue.Put(2, 10 + i);
+    }
+
+    EXPECT_TRUE(queue.IsEmpty(1));
+    EXPECT_EQ(0, queue.Head(0));
+    EXPECT_EQ(13, queue.Tail(2));
+    for (int i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(i, queue.Get(0));
+        EXPECT_EQ(10 + i, queue.Get(2));
+    }
+    ASSERT_ANY_THROW(queue.Get(1));
+    ASSERT_ANY_THROW(queue.Size(3));
+}
+
+TEST(TMultyQueue, wraps_inside_its_segment)
+{
+    TMultyQueue<int> queue(2, 3);
+    for (int i = 0; i < 10; ++i)
+    {
+        queue.Put(1, i);
+        if (queue.Size(1) == 3)
+        {
+            EXPECT_EQ(i - 2, queue.Get(1));
+        }
+    }
+    EXPECT_TRUE(queue.IsEmpty(0));
+    EXPECT_EQ(8, queue(1, 0));
+    EXPECT_EQ(9, queue(1, 1));
+}
+
+TEST(TMultyQueue, repack_borrows_free_space_from_other_queues)
+{
+    TMultyQueue<int> queue(3, 3);
+    queue.Put(0, 100);
+    queue.Put(0, 101);
+    queue.Get(0);
+    queue.Put(0, 102);
+    queue.Put(0, 103);
+    queue.Put(2, 200);
+
+    for (int i = 0; i < 5; ++i)
+        queue.Put(1, i);
+
+    EXPECT_EQ(5, queue.Size(1));
+    EXPECT_EQ(101, queue.Get(0));
+    EXPECT_EQ(102, queue.Get(0));
+    EXPECT_EQ(103, queue.Get(0));
+    EXPECT_EQ(200, queue.Head(2));
+    for (int i = 0; i < 5; ++i)
+        EXPECT_EQ(i, queue.Get(1));
+}
+
+TEST(TMultyQueue, fills_whole_buffer_through_one_queue)
+{
+    TMultyQueue<int> queue(4, 2);
+    for (int i = 0; i < 8; ++i)
+        queue.Put(2, i);
+
+    EXPECT_TRUE(queue.IsFull(2));
+    ASSERT_ANY_THROW(queue.Put(0, 1));
+    for (int i = 0; i < 8; ++i)
+        EXPECT_EQ(i, queue(2, i));
+}
+
+TEST(TMultyQueue, put_of_own_element_survives_repack)
+{
+    TMultyQueue<TString> queue(2, 1);
+    queue.Put(0, TString("abc"));
+    queue.Put(0, queue.Head(0));
+
+    EXPECT_EQ(2, queue.Size(0));
+    EXPECT_TRUE(queue.Tail(0) == "abc");
+}
+
+TEST(TMultyQueue, copy_and_move_keep_elements_alive)
+{
+    TCounted::alive = 0;
+    {
+        TMultyQueue<TCounted> queue(2, 2);
+        for (int i = 0; i < 4; ++i)
+            queue.Emplace(i % 2, i);
+        queue.Get(0);
+        queue.Emplace(0, 4);
+        TMultyQueue<TCounted> copy(queue);
+        TMultyQueue<TCounted> moved(std::move(queue));
+
+        EXPECT_EQ(8, TCounted::alive);
+        EXPECT_TRUE(copy == moved);
+        EXPECT_EQ(2, moved.Head(0).value);
+        EXPECT_EQ(0, queue.Count());
+    }
+    EXPECT_EQ(0, TCounted::alive);
+}
+
+TEST(TMultyQueue, can_save_and_load_file)
+{
+    TMultyQueue<double> queue(3, 2);
+    queue.Put(0, 1.5);
+    queue.Put(0, 2.5);
+    queue.Get(0);
+    queue.Put(0, 3.5);
+    queue.Put(2, 4.5);
+    queue.SaveToFile("test_multyqueue.bin");
+
+    TMultyQueue<double> loaded;
+    loaded.LoadFromFile("test_multyqueue.bin");
+    EXPECT_TRUE(queue == loaded);
+    EXPECT_EQ(2.5, loaded.Get(0));
+    EXPECT_EQ(3.5, loaded.Get(0));
+    EXPECT_TRUE(queue != loaded);
+}
+
+TEST(TMultyQueue, load_rejects_damaged_index_and_keeps_queue)
+{
+    TMultyQueue<int> queue(2, 3);
+    queue.Put(0, 1);
+    queue.Put(1, 2);
+    queue.SaveToFile("test_multyqueue_damaged.bin");
+    TMultyQueue<int> loaded(1, 2);
+    loaded.Put(0, 9);
+
+    std::fstream file("test_multyqueue_damaged.bin", std::ios::binary | std::ios::in | std::ios::out);
+    size_t begin = 1000000;
+    file.seekp(2 * sizeof(size_t));
+    file.write(reinterpret_cast<const char*>(&begin), sizeof(begin));
+    file.close();
+    ASSERT_ANY_THROW(loaded.LoadFromFile("test_multyqueue_damaged.bin"));
+
+    queue.SaveToFile("test_multyqueue_damaged.bin");
+    file.open("test_multyqueue_damaged.bin", std::ios::binary | std::ios::in | std::ios::out);
+    size_t size = 4;
+    file.seekp(4 * sizeof(size_t));
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.close();
+    ASSERT_ANY_THROW(loaded.LoadFromFile("test_multyqueue_damaged.bin"));
+
+    std::ofstream("test_multyqueue_damaged.bin", std::ios::binary) << "TMQ";
+    ASSERT_ANY_THROW(loaded.LoadFromFile("test_multyqueue_damaged.bin"));
+    EXPECT_EQ(2, loaded.Capacity());
+    EXPECT_EQ(9, loaded.Get(0));
+}
+
+TEST(TMultyQueue, stream_operators_round_trip)
+{
+    TMultyQueue<int> queue;
+    std::stringstream input("2 3 2 1 2 1 3");
+    input >> queue;
+
+    std::stringstream output;
+    output << queue;
+    EXPECT_EQ("{[1,2],[3]}\n", output.str());
+    EXPECT_EQ(1, queue.FindMin());
+}